@@ -50,6 +50,11 @@ LOCAL_SRC_FILES := \
 	$(LOCAL_PATH)/src/etc/table.cpp \
 	$(LOCAL_PATH)/src/MtoolProc.cpp \
 	$(LOCAL_PATH)/src/MToolClient.cpp \
+	$(LOCAL_PATH)/src/MtoolRpc.cpp \
+	$(LOCAL_PATH)/src/TrsCache.cpp \
+	$(LOCAL_PATH)/src/TrsPrefetch.cpp \
+	$(LOCAL_PATH)/src/TrsDict.cpp \
+	$(LOCAL_PATH)/src/RubyProfiler.cpp \
 	$(LOCAL_PATH)/src/audio/audio.cpp \
 	$(LOCAL_PATH)/src/audio/audiostream.cpp \
 	$(LOCAL_PATH)/src/audio/fluid-fun.cpp \
@@ -65,6 +70,7 @@ LOCAL_SRC_FILES := \
 	$(LOCAL_PATH)/src/display/sprite.cpp \
 	$(LOCAL_PATH)/src/display/plane.cpp \
 	$(LOCAL_PATH)/src/display/font.cpp \
+	$(LOCAL_PATH)/src/display/textatlas.cpp \
 	$(LOCAL_PATH)/src/display/tilemap.cpp \
 	$(LOCAL_PATH)/src/display/tilemapvx.cpp \
 	$(LOCAL_PATH)/src/display/autotiles.cpp \
@@ -78,6 +84,7 @@ LOCAL_SRC_FILES := \
 	$(LOCAL_PATH)/src/display/gl/scene.cpp \
 	$(LOCAL_PATH)/src/display/gl/shader.cpp \
 	$(LOCAL_PATH)/src/display/gl/texpool.cpp \
+	$(LOCAL_PATH)/src/display/gl/spritebatch.cpp \
 	$(LOCAL_PATH)/src/display/gl/tileatlas.cpp \
 	$(LOCAL_PATH)/src/display/gl/tileatlasvx.cpp \
 	$(LOCAL_PATH)/src/display/gl/tilequad.cpp \
@@ -88,6 +95,9 @@ LOCAL_SRC_FILES := \
 	$(LOCAL_PATH)/src/input/keybindings.cpp \
 	$(LOCAL_PATH)/src/filesystem/filesystem.cpp \
 	$(LOCAL_PATH)/src/filesystem/filesystemImpl.cpp \
+	$(LOCAL_PATH)/src/filesystem/assetprefetch.cpp \
+	$(LOCAL_PATH)/src/filesystem/pathcache.cpp \
+	$(LOCAL_PATH)/src/filesystem/scriptpack.cpp \
 	$(LOCAL_PATH)/src/system/systemImpl.cpp \
 	$(LOCAL_PATH)/src/util/iniconfig.cpp \
 	$(LOCAL_PATH)/src/net/net.cpp \
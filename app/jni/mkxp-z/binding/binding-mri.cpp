@@ -21,6 +21,7 @@
 
 #include "audio/audio.h"
 #include "filesystem/filesystem.h"
+#include "filesystem/scriptpack.h"
 #include "display/graphics.h"
 #include "display/font.h"
 #include "system/system.h"
@@ -39,6 +40,7 @@
 
 #include "sharedstate.h"
 #include "eventthread.h"
+#include "RubyProfiler.h"
 
 #include <vector>
 #include "util/rapidcsv.h"
@@ -57,6 +59,7 @@ extern "C" {
 
 #include <assert.h>
 #include <string>
+#include <chrono>
 #include <zlib.h>
 
 #include <SDL_cpuinfo.h>
@@ -204,6 +207,12 @@ json5pp::value rb2json(VALUE v);
 
 RB_METHOD(mkxpParseCSV);
 
+RB_METHOD(mkxpProfileStart);
+
+RB_METHOD(mkxpProfileStop);
+
+RB_METHOD(mkxpIsProfiling);
+
 static void mriBindingInit() {
     tableBindingInit();
     etcBindingInit();
@@ -487,6 +496,10 @@ static void mriBindingInit() {
 
     _rb_define_module_function(mod, "parse_csv", mkxpParseCSV);
 
+    _rb_define_module_function(mod, "profile_start", mkxpProfileStart);
+    _rb_define_module_function(mod, "profile_stop", mkxpProfileStop);
+    _rb_define_module_function(mod, "profiling?", mkxpIsProfiling);
+
     _rb_define_method(rb_cString, "to_utf8", mkxpStringToUTF8);
     _rb_define_method(rb_cString, "to_utf8!", mkxpStringToUTF8Bang);
 
@@ -990,6 +1003,44 @@ RB_METHOD_GUARD(mkxpParseCSV){
         }
 RB_METHOD_GUARD_END
 
+/* Samples the Ruby stack every 'interval_ms' (default 1) until
+ * profile_stop, which writes '<path>.folded' for flamegraph.pl
+ * and '<path>.sections.txt' with the time spent per script.
+ * 'path' defaults to 'profile' in the data directory */
+RB_METHOD(mkxpProfileStart) {
+    RB_UNUSED_PARAM;
+
+    double intervalMs = 1;
+    rb_get_args(argc, argv, "|f", &intervalMs RB_ARG_END);
+
+    return rb_bool_new(rubyProfiler.start((long)(intervalMs * 1000)));
+}
+
+RB_METHOD_GUARD(mkxpProfileStop) {
+    RB_UNUSED_PARAM;
+
+    const char *pathArg = 0;
+    rb_get_args(argc, argv, "|z", &pathArg RB_ARG_END);
+
+    if (!rubyProfiler.isRunning())
+        return Qnil;
+
+    std::string path = pathArg ? pathArg : RubyProfiler::defaultOutBase();
+
+    std::string error;
+    if (!rubyProfiler.stop(path, error))
+        throw Exception(Exception::MKXPError, "Failed to write profile: %s", error.c_str());
+
+    return rb_utf8_str_new_cstr((path + ".folded").c_str());
+}
+RB_METHOD_GUARD_END
+
+RB_METHOD(mkxpIsProfiling) {
+    RB_UNUSED_PARAM;
+
+    return rb_bool_new(rubyProfiler.isRunning());
+}
+
 json5pp::value loadUserSettings() {
     json5pp::value ret;
     VALUE cpath = rb_utf8_str_new_cstr(shState->config().userConfPath.c_str());
@@ -1108,6 +1159,112 @@ static VALUE evalString(VALUE string, VALUE filename, int *state) {
     return rb_protect((VALUE(*)(VALUE)) evalHelper, (VALUE) &arg, state);
 }
 
+#if RAPI_FULL >= 230
+#define SCRIPT_BYTECODE
+
+/* Compiled scripts carried across launches. Only set while
+ * runRMXPScripts starts the game, so scripts loaded later on
+ * don't bloat the cache */
+struct ScriptBytecode {
+    ScriptBytecode() : compiled(0), loaded(0), compileMs(0), loadMs(0) {}
+
+    ScriptPack::BytecodeCache cache;
+
+    int compiled;
+    int loaded;
+    double compileMs;
+    double loadMs;
+};
+
+static ScriptBytecode *scriptBytecode = 0;
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+static VALUE iseqClass() {
+    return rb_path2class("RubyVM::InstructionSequence");
+}
+
+/* args: source, filename, out binary */
+static VALUE iseqCompileHelper(VALUE *args) {
+    VALUE iseq = rb_funcall(iseqClass(), rb_intern("compile"), 4,
+                            args[0], args[1], args[1], INT2FIX(1));
+    args[2] = rb_funcall(iseq, rb_intern("to_binary"), 0);
+    return iseq;
+}
+
+static VALUE iseqLoadHelper(VALUE binary) {
+    return rb_funcall(iseqClass(), rb_intern("load_from_binary"), 1, binary);
+}
+
+static VALUE iseqEvalHelper(VALUE iseq) {
+    return rb_funcall(iseq, rb_intern("eval"), 0);
+}
+
+static uint64_t scriptHash(VALUE string, VALUE filename) {
+    return ScriptPack::BytecodeCache::hash(RSTRING_PTR(filename), RSTRING_LEN(filename),
+                                           RSTRING_PTR(string), RSTRING_LEN(string));
+}
+
+/* Returns the compiled script, either loaded from the cache or
+ * compiled and added to it. Returns nil if it doesn't compile,
+ * leaving it to a plain eval to raise the error */
+static VALUE scriptIseq(ScriptBytecode &bc, VALUE string, VALUE filename) {
+    uint64_t hash = scriptHash(string, filename);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int state;
+
+    if (const ScriptPack::Section *blob = bc.cache.find(hash)) {
+        VALUE iseq = rb_protect(iseqLoadHelper, rb_str_new(blob->data, blob->size), &state);
+
+        if (!state) {
+            bc.loaded++;
+            bc.loadMs += msSince(start);
+            return iseq;
+        }
+
+        /* Damaged entry, recompile it */
+        rb_set_errinfo(Qnil);
+        start = std::chrono::steady_clock::now();
+    }
+
+    VALUE args[] = {string, filename, Qnil};
+    VALUE iseq = rb_protect((VALUE(*)(VALUE)) iseqCompileHelper, (VALUE) args, &state);
+
+    if (state) {
+        rb_set_errinfo(Qnil);
+        return Qnil;
+    }
+
+    bc.cache.insert(hash, RSTRING_PTR(args[2]), RSTRING_LEN(args[2]));
+    bc.compiled++;
+    bc.compileMs += msSince(start);
+
+    return iseq;
+}
+
+static VALUE evalIseq(VALUE iseq, int *state) {
+    return rb_protect(iseqEvalHelper, iseq, state);
+}
+#endif
+
+/* Like evalString, but goes through the bytecode cache while
+ * the game is starting up */
+static VALUE evalCompiled(VALUE string, VALUE filename, int *state) {
+#ifdef SCRIPT_BYTECODE
+    if (scriptBytecode) {
+        VALUE iseq = scriptIseq(*scriptBytecode, string, filename);
+
+        if (!NIL_P(iseq))
+            return evalIseq(iseq, state);
+    }
+#endif
+
+    return evalString(string, filename, state);
+}
+
 static void runCustomScript(const std::string &filename) {
     std::string scriptData;
 
@@ -1116,8 +1273,8 @@ static void runCustomScript(const std::string &filename) {
         return;
     }
     int state;
-    evalString(newStringUTF8(scriptData.c_str(), scriptData.size()),
-               newStringUTF8(filename.c_str(), filename.size()), &state);
+    evalCompiled(newStringUTF8(scriptData.c_str(), scriptData.size()),
+                 newStringUTF8(filename.c_str(), filename.size()), &state);
     if(state){
         // 获取详细的错误信息
 #if RAPI_FULL > 187
@@ -1264,6 +1421,20 @@ bool evalScript(VALUE string, const char *filename) {
 
 
 #define SCRIPT_SECTION_FMT (rgssVer >= 3 ? "{%04ld}" : "Section%03ld")
+
+/* Ruby visible filename of script section 'i' */
+static VALUE sectionFilename(const Config &conf, long i, const char *scriptName) {
+    char buf[512];
+    int len;
+
+    if (conf.useScriptNames)
+        len = snprintf(buf, sizeof(buf), "%03ld:%s", i, scriptName);
+    else
+        len = snprintf(buf, sizeof(buf), SCRIPT_SECTION_FMT, i);
+
+    return newStringUTF8(buf, std::min(len, (int)sizeof(buf) - 1));
+}
+
 #include <MtoolProc.h>
 static void runRMXPScripts(BacktraceData &btData) {
     const Config &conf = shState->rtData().config;
@@ -1304,56 +1475,70 @@ static void runRMXPScripts(BacktraceData &btData) {
 
     long scriptCount = RARRAY_LEN(scriptArray);
 
-    std::string decodeBuffer;
-    decodeBuffer.resize(0x1000);
-
 #ifdef __ANDROID__
     // 通知加载状态：开始解压脚本数据
     MtoolProc::notifyLoadingStatus(3);
 #endif
 
+    /* Collect the compressed sections up front; no Ruby code runs
+     * while the workers read from them */
+    std::vector<long> sectionIndices;
+    std::vector<ScriptPack::Section> sections;
+
     for (long i = 0; i < scriptCount; ++i) {
         VALUE script = rb_ary_entry(scriptArray, i);
 
         if (!RB_TYPE_P(script, RUBY_T_ARRAY))
             continue;
 
-        VALUE scriptName = rb_ary_entry(script, 1);
         VALUE scriptString = rb_ary_entry(script, 2);
 
-        int result = Z_OK;
-        unsigned long bufferLen;
+        if (!RB_TYPE_P(scriptString, RUBY_T_STRING))
+            continue;
 
-        while (true) {
-            unsigned char *bufferPtr = reinterpret_cast<unsigned char *>(
-                    const_cast<char *>(decodeBuffer.c_str()));
-            const unsigned char *sourcePtr =
-                    reinterpret_cast<const unsigned char *>(RSTRING_PTR(scriptString));
+        ScriptPack::Section section = { RSTRING_PTR(scriptString),
+                                        (size_t)RSTRING_LEN(scriptString) };
+        sections.push_back(section);
+        sectionIndices.push_back(i);
+    }
 
-            bufferLen = decodeBuffer.length();
+    ScriptPack::Key packKey = ScriptPack::keyOf(sections);
+    std::string cacheFile = conf.customDataPath + "/scriptcache.bin";
 
-            result = uncompress(bufferPtr, &bufferLen, sourcePtr,
-                                RSTRING_LEN(scriptString));
+    ScriptPack::CacheView cached;
+    std::vector<std::string> decoded;
+    long decodeError = -1;
 
-            bufferPtr[bufferLen] = '\0';
+    if (!conf.scriptCache || !ScriptPack::load(cacheFile, packKey, cached)) {
+        decodeError = ScriptPack::inflateAll(sections, decoded);
 
-            if (result != Z_BUF_ERROR)
-                break;
+        if (decodeError < 0 && conf.scriptCache &&
+            !ScriptPack::save(cacheFile, packKey, decoded))
+            Debug() << "Failed to write script cache" << cacheFile;
+    }
 
-            decodeBuffer.resize(decodeBuffer.size() * 2);
-        }
+    size_t storeCount = (decodeError < 0) ? sections.size() : (size_t)decodeError;
 
-        if (result != Z_OK) {
-            static char buffer[256];
-            snprintf(buffer, sizeof(buffer), "Error decoding script %ld: '%s'", i,
-                     RSTRING_PTR(scriptName));
+    for (size_t j = 0; j < storeCount; ++j) {
+        VALUE script = rb_ary_entry(scriptArray, sectionIndices[j]);
 
-            showMsg(buffer);
+        /* Sections have always been cut at the first NUL */
+        const char *text = cached.texts.empty() ? decoded[j].c_str() : cached.texts[j].data;
+        size_t size = cached.texts.empty() ? decoded[j].size() : cached.texts[j].size;
+        const char *nul = (const char *)memchr(text, '\0', size);
 
-            break;
-        }
+        rb_ary_store(script, 3, rb_utf8_str_new(text, nul ? nul - text : size));
+    }
+
+    if (decodeError >= 0) {
+        long i = sectionIndices[decodeError];
+        VALUE scriptName = rb_ary_entry(rb_ary_entry(scriptArray, i), 1);
 
-        rb_ary_store(script, 3, rb_utf8_str_new_cstr(decodeBuffer.c_str()));
+        static char buffer[256];
+        snprintf(buffer, sizeof(buffer), "Error decoding script %ld: '%s'", i,
+                 RSTRING_PTR(scriptName));
+
+        showMsg(buffer);
     }
 
 #ifdef __ANDROID__
@@ -1361,6 +1546,17 @@ static void runRMXPScripts(BacktraceData &btData) {
     MtoolProc::notifyLoadingStatus(4);
 #endif
 
+#ifdef SCRIPT_BYTECODE
+    ScriptBytecode bytecode;
+    std::string bytecodeFile = conf.customDataPath + "/bytecode.bin";
+    std::string bytecodeTag = std::string(ruby_description) + " " + RUBY_PLATFORM;
+
+    if (conf.bytecodeCache) {
+        bytecode.cache.load(bytecodeFile, bytecodeTag);
+        scriptBytecode = &bytecode;
+    }
+#endif
+
     /* Execute preloaded scripts */
     for (std::vector<std::string>::const_iterator i = conf.preloadScripts.begin();
          i != conf.preloadScripts.end(); ++i) {
@@ -1373,8 +1569,50 @@ static void runRMXPScripts(BacktraceData &btData) {
 #else
     VALUE exc = rb_errinfo();
 #endif
-    if (exc != Qnil)
+    if (exc != Qnil) {
+#ifdef SCRIPT_BYTECODE
+        scriptBytecode = 0;
+#endif
         return;
+    }
+
+#ifdef SCRIPT_BYTECODE
+    /* Compile all sections before the first one runs, as the last
+     * one usually doesn't return until the game quits. Sections
+     * edited in the meantime are caught by their hash */
+    VALUE sectionIseqs = rb_ary_new();
+    std::vector<uint64_t> sectionHashes(scriptCount);
+
+    if (scriptBytecode) {
+        for (long i = 0; i < scriptCount; ++i) {
+            VALUE script = rb_ary_entry(scriptArray, i);
+
+            if (!RB_TYPE_P(script, RUBY_T_ARRAY))
+                continue;
+
+            VALUE scriptDecoded = rb_ary_entry(script, 3);
+
+            if (!RB_TYPE_P(scriptDecoded, RUBY_T_STRING))
+                continue;
+
+            VALUE string =
+                    newStringUTF8(RSTRING_PTR(scriptDecoded), RSTRING_LEN(scriptDecoded));
+            VALUE fname = sectionFilename(conf, i, RSTRING_PTR(rb_ary_entry(script, 1)));
+
+            sectionHashes[i] = scriptHash(string, fname);
+            rb_ary_store(sectionIseqs, i, scriptIseq(bytecode, string, fname));
+        }
+
+        scriptBytecode = 0;
+
+        Debug() << "Script bytecode:" << bytecode.compiled << "compiled in"
+                << bytecode.compileMs << "ms," << bytecode.loaded << "loaded in"
+                << bytecode.loadMs << "ms";
+
+        if (bytecode.cache.dirty() && !bytecode.cache.save(bytecodeFile, bytecodeTag))
+            Debug() << "Failed to write bytecode cache" << bytecodeFile;
+    }
+#endif
 
 #ifdef __ANDROID__
     // 通知加载状态：正在执行脚本
@@ -1390,18 +1628,10 @@ static void runRMXPScripts(BacktraceData &btData) {
             VALUE string =
                     newStringUTF8(RSTRING_PTR(scriptDecoded), RSTRING_LEN(scriptDecoded));
 
-            VALUE fname;
             const char *scriptName = RSTRING_PTR(rb_ary_entry(script, 1));
-            char buf[512];
-            int len;
-
-            if (conf.useScriptNames)
-                len = snprintf(buf, sizeof(buf), "%03ld:%s", i, scriptName);
-            else
-                len = snprintf(buf, sizeof(buf), SCRIPT_SECTION_FMT, i);
-
-            fname = newStringUTF8(buf, len);
-            btData.scriptNames.insert(buf, scriptName);
+            VALUE fname = sectionFilename(conf, i, scriptName);
+            btData.scriptNames.insert(RSTRING_PTR(fname), scriptName);
+            rubyProfiler.setScriptName(RSTRING_PTR(fname), scriptName);
 
 
             // if the script name starts with |s|, only execute
@@ -1429,7 +1659,14 @@ static void runRMXPScripts(BacktraceData &btData) {
              */
 
             int state;
-            evalString(string, fname, &state);
+#ifdef SCRIPT_BYTECODE
+            VALUE iseq = rb_ary_entry(sectionIseqs, i);
+
+            if (!NIL_P(iseq) && sectionHashes[i] == scriptHash(string, fname))
+                evalIseq(iseq, &state);
+            else
+#endif
+                evalString(string, fname, &state);
             if (state)
                 break;
         }
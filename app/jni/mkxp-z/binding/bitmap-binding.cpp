@@ -468,6 +468,17 @@ RB_METHOD_GUARD(bitmapGetRawData) {
 }
 RB_METHOD_GUARD_END
 
+RB_METHOD_GUARD(bitmapPrefetchPixels) {
+    RB_UNUSED_PARAM;
+    
+    Bitmap *b = getPrivateData<Bitmap>(self);
+    
+    GFX_GUARD_EXC(b->prefetchPixels(););
+    
+    return Qnil;
+}
+RB_METHOD_GUARD_END
+
 RB_METHOD_GUARD(bitmapSetRawData) {
     RB_UNUSED_PARAM;
     
@@ -854,6 +865,7 @@ void bitmapBindingInit() {
     
     _rb_define_method(klass, "raw_data", bitmapGetRawData);
     _rb_define_method(klass, "raw_data=", bitmapSetRawData);
+    _rb_define_method(klass, "prefetch_pixels", bitmapPrefetchPixels);
     _rb_define_method(klass, "to_file", bitmapSaveToFile);
     
     _rb_define_method(klass, "gradient_fill_rect", bitmapGradientFillRect);
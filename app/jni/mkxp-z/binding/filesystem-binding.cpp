@@ -25,6 +25,8 @@
 
 #include "filesystem.h"
 #include "sharedstate.h"
+#include "assetprefetch.h"
+#include "MtoolProc.h"
 #include "src/util/util.h"
 
 #if RAPI_FULL > 187
@@ -38,6 +40,10 @@
 #include <ruby/thread.h>
 #endif
 
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
 static void fileIntFreeInstance(void *inst) {
     SDL_RWops *ops = static_cast<SDL_RWops *>(inst);
     
@@ -163,6 +169,18 @@ VALUE
 kernelLoadDataInt(const char *filename, bool rubyExc, bool raw) {
     //rb_gc_start();
     
+    /* Read ahead by System.prefetch */
+    std::string staged;
+    if (shState->assetPrefetch().takeData(filename, staged)) {
+        VALUE data = staged.empty() ? Qnil : rb_str_new(staged.data(), staged.size());
+        
+        if (raw)
+            return data;
+        
+        VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+        return rb_funcall2(marsh, rb_intern("load"), 1, &data);
+    }
+    
     VALUE port = fileIntForPath(filename, rubyExc);
     VALUE result;
     if (!raw) {
@@ -180,6 +198,294 @@ kernelLoadDataInt(const char *filename, bool rubyExc, bool raw) {
     return result;
 }
 
+/* Files read through load_data, kept so that loading them again
+ * skips the archive. The raw bytes are held as frozen strings in
+ * a Ruby hash (so the GC sees them), together with the parsed
+ * object if dataCacheParsed is set. That object is never handed
+ * out itself; callers get a copy, so games that modify what they
+ * loaded can't affect later loads */
+struct DataCacheEntry {
+    int64_t size;
+    int64_t mtime;
+    unsigned int generation;
+    uint64_t lastUse;
+    /* Charged against the budget: the raw bytes,
+     * plus an estimate for the parsed object */
+    size_t bytes;
+};
+
+struct DataCacheStats {
+    uint64_t hits;
+    uint64_t parsedHits;
+    uint64_t misses;
+    uint64_t evictions;
+    double loadMs;
+};
+
+static std::unordered_map<std::string, DataCacheEntry> dataCacheEntries;
+/* Maps: filename, To: [raw String, parsed object or nil] */
+static VALUE dataCacheStore = Qnil;
+static size_t dataCacheBytes = 0;
+static size_t dataCacheBudget = 0;
+static uint64_t dataCacheUses = 0;
+static DataCacheStats dataCacheStats = DataCacheStats();
+
+static void dataCacheErase(const std::string &key) {
+    rb_hash_delete(dataCacheStore, rb_str_new(key.c_str(), key.size()));
+    
+    std::unordered_map<std::string, DataCacheEntry>::iterator it = dataCacheEntries.find(key);
+    
+    if (it != dataCacheEntries.end()) {
+        dataCacheBytes -= it->second.bytes;
+        dataCacheEntries.erase(it);
+    }
+}
+
+static void dataCacheClear() {
+    if (NIL_P(dataCacheStore))
+        return;
+    
+    /* rb_hash_clear isn't exported by 1.8 / 1.9 */
+    rb_funcall(dataCacheStore, rb_intern("clear"), 0);
+    dataCacheEntries.clear();
+    dataCacheBytes = 0;
+}
+
+/* 'keep' is never evicted, for growing an entry in place */
+static void dataCacheMakeRoom(size_t bytes, const std::string *keep = 0) {
+    while (dataCacheBytes + bytes > dataCacheBudget) {
+        std::unordered_map<std::string, DataCacheEntry>::iterator oldest = dataCacheEntries.end();
+        
+        for (auto it = dataCacheEntries.begin(); it != dataCacheEntries.end(); ++it)
+            if ((!keep || it->first != *keep) &&
+                (oldest == dataCacheEntries.end() || it->second.lastUse < oldest->second.lastUse))
+                oldest = it;
+        
+        if (oldest == dataCacheEntries.end())
+            break;
+        
+        dataCacheErase(std::string(oldest->first));
+        dataCacheStats.evictions++;
+    }
+}
+
+#if RAPI_FULL >= 270
+#define DATA_CACHE_PARSED
+
+static const size_t dataCacheParsedFactor = 4;
+
+/* Copies everything Marshal.load can produce from RGSS data:
+ * plain objects, arrays, hashes and strings are rebuilt, and
+ * data objects (Table, Color, ...) are dup'd. Anything else
+ * raises, and the file's parsed result isn't cached */
+static VALUE deepCopy(VALUE obj, VALUE memo);
+
+struct DeepCopyArgs {
+    VALUE copy;
+    VALUE memo;
+};
+
+static int deepCopyIvar(ID id, VALUE val, st_data_t arg) {
+    DeepCopyArgs *args = (DeepCopyArgs *)arg;
+    rb_ivar_set(args->copy, id, deepCopy(val, args->memo));
+    
+    return ST_CONTINUE;
+}
+
+static int deepCopyPair(VALUE key, VALUE val, VALUE arg) {
+    DeepCopyArgs *args = (DeepCopyArgs *)arg;
+    rb_hash_aset(args->copy, deepCopy(key, args->memo), deepCopy(val, args->memo));
+    
+    return ST_CONTINUE;
+}
+
+static VALUE deepCopy(VALUE obj, VALUE memo) {
+    if (SPECIAL_CONST_P(obj))
+        return obj;
+    
+    switch (BUILTIN_TYPE(obj)) {
+    case T_SYMBOL:
+    case T_FLOAT:
+    case T_BIGNUM:
+    case T_CLASS:
+    case T_MODULE:
+        return obj;
+    default:
+        break;
+    }
+    
+    VALUE copy = rb_hash_lookup2(memo, obj, Qundef);
+    
+    if (copy != Qundef)
+        return copy;
+    
+    VALUE klass = rb_obj_class(obj);
+    DeepCopyArgs args = {Qnil, memo};
+    
+    switch (BUILTIN_TYPE(obj)) {
+    case T_STRING:
+        if (klass != rb_cString)
+            break;
+        
+        copy = rb_str_dup(obj);
+        rb_hash_aset(memo, obj, copy);
+        return copy;
+        
+    case T_ARRAY:
+        if (klass != rb_cArray)
+            break;
+        
+        copy = rb_ary_new_capa(RARRAY_LEN(obj));
+        rb_hash_aset(memo, obj, copy);
+        
+        for (long i = 0; i < RARRAY_LEN(obj); ++i)
+            rb_ary_push(copy, deepCopy(rb_ary_entry(obj, i), memo));
+        
+        return copy;
+        
+    case T_HASH:
+        if (klass != rb_cHash ||
+            !NIL_P(rb_funcall(obj, rb_intern("default"), 0)) ||
+            !NIL_P(rb_funcall(obj, rb_intern("default_proc"), 0)))
+            break;
+        
+        copy = rb_hash_new();
+        rb_hash_aset(memo, obj, copy);
+        
+        args.copy = copy;
+        rb_hash_foreach(obj, deepCopyPair, (VALUE)&args);
+        return copy;
+        
+    case T_OBJECT:
+        copy = rb_obj_alloc(klass);
+        rb_hash_aset(memo, obj, copy);
+        
+        args.copy = copy;
+        rb_ivar_foreach(obj, deepCopyIvar, (st_data_t)&args);
+        return copy;
+        
+    case T_DATA:
+        copy = rb_obj_dup(obj);
+        rb_hash_aset(memo, obj, copy);
+        return copy;
+        
+    default:
+        break;
+    }
+    
+    rb_raise(rb_eTypeError, "can't copy %s", rb_obj_classname(obj));
+    
+    return Qnil;
+}
+
+static VALUE deepCopyRoot(VALUE obj) {
+    VALUE memo = rb_hash_new();
+    rb_funcall(memo, rb_intern("compare_by_identity"), 0);
+    
+    return deepCopy(obj, memo);
+}
+#endif
+
+static VALUE dataCacheLoad(const char *filename, bool raw) {
+    int64_t size, mtime;
+    
+    if (!shState->fileSystem().stat(filename, size, mtime))
+        return kernelLoadDataInt(filename, true, raw);
+    
+    std::string key(filename);
+    unsigned int generation = shState->fileSystem().generation();
+    VALUE keyStr = rb_str_new(key.c_str(), key.size());
+    VALUE entry = Qnil;
+    
+    std::unordered_map<std::string, DataCacheEntry>::iterator it = dataCacheEntries.find(key);
+    
+    if (it != dataCacheEntries.end()) {
+        DataCacheEntry &e = it->second;
+        
+        if (e.size == size && e.mtime == mtime && e.generation == generation) {
+            e.lastUse = ++dataCacheUses;
+            entry = rb_hash_aref(dataCacheStore, keyStr);
+        } else {
+            dataCacheErase(key);
+        }
+    }
+    
+    if (NIL_P(entry)) {
+        dataCacheStats.misses++;
+        
+        VALUE data = kernelLoadDataInt(filename, true, true);
+        
+        if (NIL_P(data) || (size_t)RSTRING_LEN(data) > dataCacheBudget) {
+            if (raw)
+                return data;
+            
+            VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+            return rb_funcall2(marsh, rb_intern("load"), 1, &data);
+        }
+        
+        dataCacheMakeRoom(RSTRING_LEN(data));
+        
+        rb_obj_freeze(data);
+        entry = rb_ary_new3(2, data, Qnil);
+        rb_hash_aset(dataCacheStore, keyStr, entry);
+        dataCacheBytes += RSTRING_LEN(data);
+        
+        DataCacheEntry e = {size, mtime, generation, ++dataCacheUses, (size_t)RSTRING_LEN(data)};
+        dataCacheEntries[key] = e;
+    } else {
+        dataCacheStats.hits++;
+    }
+    
+    VALUE data = rb_ary_entry(entry, 0);
+    
+    if (raw)
+        return rb_str_dup(data);
+    
+#ifdef DATA_CACHE_PARSED
+    if (shState->config().dataCacheParsed) {
+        VALUE parsed = rb_ary_entry(entry, 1);
+        
+        if (!NIL_P(parsed)) {
+            dataCacheStats.parsedHits++;
+            return deepCopyRoot(parsed);
+        }
+    }
+#endif
+    
+    VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
+    VALUE result = rb_funcall2(marsh, rb_intern("load"), 1, &data);
+    
+#ifdef DATA_CACHE_PARSED
+    if (shState->config().dataCacheParsed && !NIL_P(result)) {
+        /* Hand out a copy right away, which also
+         * tells whether this object can be copied */
+        int state;
+        VALUE copy = rb_protect(deepCopyRoot, result, &state);
+        
+        if (!state) {
+            /* Unpacked objects take several times the space of
+             * their marshaled form; charge an estimate of that */
+            size_t parsedBytes = (size_t)RSTRING_LEN(data) * dataCacheParsedFactor;
+            it = dataCacheEntries.find(key);
+            
+            if (it != dataCacheEntries.end() && it->second.bytes + parsedBytes <= dataCacheBudget) {
+                dataCacheMakeRoom(parsedBytes, &key);
+                dataCacheEntries[key].bytes += parsedBytes;
+                dataCacheBytes += parsedBytes;
+                
+                rb_ary_store(entry, 1, result);
+            }
+            
+            return copy;
+        }
+        
+        rb_set_errinfo(Qnil);
+    }
+#endif
+    
+    return result;
+}
+
 RB_METHOD_GUARD(kernelLoadData) {
     RB_UNUSED_PARAM;
     
@@ -190,7 +496,21 @@ RB_METHOD_GUARD(kernelLoadData) {
     
     bool rawv;
     rb_bool_arg(raw, &rawv);
-    return kernelLoadDataInt(RSTRING_PTR(filename), true, rawv);
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    VALUE result;
+    
+    if (dataCacheBudget > 0)
+        result = dataCacheLoad(RSTRING_PTR(filename), rawv);
+    else
+        result = kernelLoadDataInt(RSTRING_PTR(filename), true, rawv);
+    
+    dataCacheStats.loadMs += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    
+    MtoolProc::pump(MtoolProc::PumpLoadData);
+    
+    return result;
 }
 RB_METHOD_GUARD_END
 
@@ -202,6 +522,11 @@ RB_METHOD(kernelSaveData) {
     
     rb_get_args(argc, argv, "oS", &obj, &filename RB_ARG_END);
     
+    /* The file may be one we have cached, and its
+     * mtime only has a resolution of seconds */
+    dataCacheClear();
+    shState->assetPrefetch().clear();
+    
     VALUE file = rb_file_open_str(filename, "wb");
     
     VALUE marsh = rb_const_get(rb_cObject, rb_intern("Marshal"));
@@ -213,6 +538,67 @@ RB_METHOD(kernelSaveData) {
     
     return Qnil;
 }
+
+RB_METHOD(systemDataCacheStats) {
+    RB_UNUSED_PARAM;
+    
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("hits")), ULL2NUM(dataCacheStats.hits));
+    rb_hash_aset(hash, ID2SYM(rb_intern("parsed_hits")), ULL2NUM(dataCacheStats.parsedHits));
+    rb_hash_aset(hash, ID2SYM(rb_intern("misses")), ULL2NUM(dataCacheStats.misses));
+    rb_hash_aset(hash, ID2SYM(rb_intern("evictions")), ULL2NUM(dataCacheStats.evictions));
+    rb_hash_aset(hash, ID2SYM(rb_intern("cached_bytes")), ULL2NUM(dataCacheBytes));
+    rb_hash_aset(hash, ID2SYM(rb_intern("budget_bytes")), ULL2NUM(dataCacheBudget));
+    rb_hash_aset(hash, ID2SYM(rb_intern("cached_count")), UINT2NUM(dataCacheEntries.size()));
+    rb_hash_aset(hash, ID2SYM(rb_intern("load_ms")), rb_float_new(dataCacheStats.loadMs));
+    return hash;
+}
+
+/* Queues files to be read and decoded in the background, for
+ * example the tilesets, characters and data of the map a
+ * transfer is about to load. Takes a path or an array of them
+ * and returns how many were queued */
+RB_METHOD(systemPrefetch) {
+    RB_UNUSED_PARAM;
+    
+    VALUE paths;
+    rb_get_args(argc, argv, "o", &paths RB_ARG_END);
+    
+    if (!RB_TYPE_P(paths, RUBY_T_ARRAY))
+        paths = rb_ary_new3(1, paths);
+    
+    int queued = 0;
+    
+    for (long i = 0; i < RARRAY_LEN(paths); i++) {
+        VALUE path = rb_ary_entry(paths, i);
+        
+        if (shState->assetPrefetch().request(StringValueCStr(path)))
+            queued++;
+    }
+    
+    return INT2NUM(queued);
+}
+
+RB_METHOD(systemPrefetchStats) {
+    RB_UNUSED_PARAM;
+    
+    AssetPrefetch::Stats stats = shState->assetPrefetch().getStats();
+    
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("queued")), ULL2NUM(stats.queued));
+    rb_hash_aset(hash, ID2SYM(rb_intern("dropped")), ULL2NUM(stats.dropped));
+    rb_hash_aset(hash, ID2SYM(rb_intern("hits")), ULL2NUM(stats.hits));
+    rb_hash_aset(hash, ID2SYM(rb_intern("waits")), ULL2NUM(stats.waits));
+    rb_hash_aset(hash, ID2SYM(rb_intern("failed")), ULL2NUM(stats.failed));
+    rb_hash_aset(hash, ID2SYM(rb_intern("skipped")), ULL2NUM(stats.skipped));
+    rb_hash_aset(hash, ID2SYM(rb_intern("evictions")), ULL2NUM(stats.evictions));
+    rb_hash_aset(hash, ID2SYM(rb_intern("pending")), ULL2NUM(stats.pending));
+    rb_hash_aset(hash, ID2SYM(rb_intern("staged_count")), ULL2NUM(stats.stagedCount));
+    rb_hash_aset(hash, ID2SYM(rb_intern("staged_bytes")), ULL2NUM(stats.stagedBytes));
+    rb_hash_aset(hash, ID2SYM(rb_intern("budget_bytes")), ULL2NUM(stats.budgetBytes));
+    return hash;
+}
+
 #if RAPI_FULL > 187
 #if RAPI_FULL < 270
 static VALUE stringForceUTF8(VALUE arg)
@@ -286,6 +672,14 @@ void fileIntBindingInit() {
     _rb_define_module_function(rb_mKernel, "load_data", kernelLoadData);
     _rb_define_module_function(rb_mKernel, "save_data", kernelSaveData);
     
+    dataCacheBudget = (size_t)shState->config().dataCacheSize * 1000000;
+    dataCacheStore = rb_hash_new();
+    rb_gc_register_address(&dataCacheStore);
+    
+    _rb_define_module_function(rb_define_module("System"), "data_cache_stats", systemDataCacheStats);
+    _rb_define_module_function(rb_define_module("System"), "prefetch", systemPrefetch);
+    _rb_define_module_function(rb_define_module("System"), "prefetch_stats", systemPrefetchStats);
+    
 #if RAPI_FULL > 187
     /* We overload the built-in 'Marshal::load()' function to silently
      * insert our utf8proc that ensures all read strings will be
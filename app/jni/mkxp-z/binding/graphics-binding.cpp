@@ -22,6 +22,7 @@
 #include "config.h"
 #include "graphics.h"
 #include "sharedstate.h"
+#include "texpool.h"
 #include "binding-util.h"
 #include "binding-types.h"
 #include "exception.h"
@@ -59,6 +60,41 @@ RB_METHOD(graphicsAverageFrameRate)
     return ret;
 }
 
+RB_METHOD(graphicsDrawCalls)
+{
+    RB_UNUSED_PARAM;
+    GFX_LOCK;
+    VALUE ret = rb_fix_new(shState->graphics().drawCalls());
+    GFX_UNLOCK;
+    return ret;
+}
+
+RB_METHOD(graphicsBatchBreaks)
+{
+    RB_UNUSED_PARAM;
+    GFX_LOCK;
+    VALUE ret = rb_fix_new(shState->graphics().batchBreaks());
+    GFX_UNLOCK;
+    return ret;
+}
+
+RB_METHOD(graphicsTexturePoolStats)
+{
+    RB_UNUSED_PARAM;
+    GFX_LOCK;
+    TexPool::Stats st = shState->texPool().getStats();
+    GFX_UNLOCK;
+    
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, ID2SYM(rb_intern("hits")), ULL2NUM(st.hits));
+    rb_hash_aset(hash, ID2SYM(rb_intern("misses")), ULL2NUM(st.misses));
+    rb_hash_aset(hash, ID2SYM(rb_intern("evictions")), ULL2NUM(st.evictions));
+    rb_hash_aset(hash, ID2SYM(rb_intern("cached_bytes")), ULL2NUM(st.cachedBytes));
+    rb_hash_aset(hash, ID2SYM(rb_intern("budget_bytes")), ULL2NUM(st.budgetBytes));
+    rb_hash_aset(hash, ID2SYM(rb_intern("cached_count")), UINT2NUM(st.cachedCount));
+    return hash;
+}
+
 RB_METHOD_GUARD(graphicsFreeze)
 {
     RB_UNUSED_PARAM;
@@ -72,6 +108,8 @@ RB_METHOD_GUARD(graphicsFreeze)
     shState->graphics().freeze();
 #endif
     
+    MtoolProc::pump(MtoolProc::PumpGraphics);
+    
     return Qnil;
 }
 RB_METHOD_GUARD_END
@@ -107,6 +145,8 @@ RB_METHOD_GUARD(graphicsTransition)
     GFX_GUARD_EXC( shState->graphics().transition(duration, filename, vague); )
 #endif
     
+    MtoolProc::pump(MtoolProc::PumpGraphics);
+    
     return Qnil;
 }
 RB_METHOD_GUARD_END
@@ -431,6 +471,9 @@ void graphicsBindingInit()
     INIT_GRA_PROP_BIND( FrameRate,  "frame_rate"  );
     INIT_GRA_PROP_BIND( FrameCount, "frame_count" );
     _rb_define_module_function(module, "average_frame_rate", graphicsAverageFrameRate);
+    _rb_define_module_function(module, "draw_calls", graphicsDrawCalls);
+    _rb_define_module_function(module, "batch_breaks", graphicsBatchBreaks);
+    _rb_define_module_function(module, "texture_pool_stats", graphicsTexturePoolStats);
 
     _rb_define_module_function(module, "width", graphicsWidth);
     _rb_define_module_function(module, "height", graphicsHeight);
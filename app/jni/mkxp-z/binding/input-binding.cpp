@@ -29,6 +29,7 @@
 #include "util/exception.h"
 #include "input/input.h"
 #include "sharedstate.h"
+#include "MtoolProc.h"
 #include "src/util/util.h"
 
 RB_METHOD(inputDelta) {
@@ -42,6 +43,8 @@ RB_METHOD_GUARD(inputUpdate) {
     
     shState->input().update();
     
+    MtoolProc::pump(MtoolProc::PumpInput);
+    
     return Qnil;
 }
 RB_METHOD_GUARD_END
@@ -20,9 +20,12 @@
 */
 
 #include "binding-util.h"
+#include "binding-types.h"
 #include "serializable-binding.h"
 #include "table.h"
 #include <algorithm>
+#include <string.h>
+#include <vector>
 
 static int num2TableSize(VALUE v) {
   int i = NUM2INT(v);
@@ -154,6 +157,125 @@ RB_METHOD_GUARD(tableSetAt) {
 }
 RB_METHOD_GUARD_END
 
+RB_METHOD_GUARD(tableFill) {
+  Table *t = getPrivateData<Table>(self);
+
+  int x = 0, y = 0, z = 0;
+  int w = t->xSize(), h = t->ySize(), d = t->zSize();
+
+  switch (argc) {
+  case 1:
+    break;
+  /* x, y, w, h across all layers */
+  case 5:
+    x = NUM2INT(argv[1]);
+    y = NUM2INT(argv[2]);
+    w = NUM2INT(argv[3]);
+    h = NUM2INT(argv[4]);
+    break;
+  case 7:
+    x = NUM2INT(argv[1]);
+    y = NUM2INT(argv[2]);
+    z = NUM2INT(argv[3]);
+    w = NUM2INT(argv[4]);
+    h = NUM2INT(argv[5]);
+    d = NUM2INT(argv[6]);
+    break;
+  default:
+    throw Exception(Exception::ArgumentError, "wrong number of arguments");
+  }
+
+  t->fill(NUM2INT(argv[0]), x, y, z, w, h, d);
+
+  return self;
+}
+RB_METHOD_GUARD_END
+
+RB_METHOD_GUARD(tableCopyRect) {
+  Table *t = getPrivateData<Table>(self);
+
+  if (argc != 7 && argc != 10)
+    throw Exception(Exception::ArgumentError, "wrong number of arguments");
+
+  Table *src = getPrivateDataCheck<Table>(argv[0], TableType);
+
+  int sx, sy, sz = 0, w, h, d, dx, dy, dz = 0;
+
+  if (argc == 7) {
+    /* src, x, y, w, h, dest_x, dest_y across all layers */
+    sx = NUM2INT(argv[1]);
+    sy = NUM2INT(argv[2]);
+    w = NUM2INT(argv[3]);
+    h = NUM2INT(argv[4]);
+    d = src->zSize();
+    dx = NUM2INT(argv[5]);
+    dy = NUM2INT(argv[6]);
+  } else {
+    sx = NUM2INT(argv[1]);
+    sy = NUM2INT(argv[2]);
+    sz = NUM2INT(argv[3]);
+    w = NUM2INT(argv[4]);
+    h = NUM2INT(argv[5]);
+    d = NUM2INT(argv[6]);
+    dx = NUM2INT(argv[7]);
+    dy = NUM2INT(argv[8]);
+    dz = NUM2INT(argv[9]);
+  }
+
+  t->copyRect(*src, sx, sy, sz, w, h, d, dx, dy, dz);
+
+  return self;
+}
+RB_METHOD_GUARD_END
+
+/* set_many(x, y, z, w, data): 'data' holds packed 16 bit
+ * values in native byte order (as in Table#_dump), written
+ * to layer z in rows of w cells starting at x/y */
+RB_METHOD_GUARD(tableSetMany) {
+  Table *t = getPrivateData<Table>(self);
+
+  VALUE xv, yv, zv, wv, str;
+  rb_scan_args(argc, argv, "5", &xv, &yv, &zv, &wv, &str);
+  SafeStringValue(str);
+
+  int w = NUM2INT(wv);
+
+  if (w <= 0)
+    throw Exception(Exception::ArgumentError, "row width must be positive");
+
+  size_t count = RSTRING_LEN(str) / sizeof(int16_t);
+  std::vector<int16_t> values(count);
+  memcpy(dataPtr(values), RSTRING_PTR(str), count * sizeof(int16_t));
+
+  t->setMany(dataPtr(values), count, NUM2INT(xv), NUM2INT(yv), NUM2INT(zv), w);
+
+  return self;
+}
+RB_METHOD_GUARD_END
+
+static VALUE tableBatchYield(VALUE self) { return rb_yield(self); }
+
+static VALUE tableBatchEnd(VALUE self) {
+  getPrivateData<Table>(self)->endBatch();
+  return Qnil;
+}
+
+/* Changes made in the block reach tilemaps
+ * as a single notification at its end */
+RB_METHOD(tableBatch) {
+  RB_UNUSED_PARAM;
+
+  Table *t = getPrivateData<Table>(self);
+  t->beginBatch();
+
+#if RAPI_FULL < 270
+  return rb_ensure((VALUE(*)(ANYARGS))tableBatchYield, self,
+                   (VALUE(*)(ANYARGS))tableBatchEnd, self);
+#else
+  return rb_ensure(tableBatchYield, self, tableBatchEnd, self);
+#endif
+}
+
 MARSH_LOAD_FUN(Table)
 INITCOPY_FUN(Table)
 
@@ -184,4 +306,8 @@ void tableBindingInit() {
   _rb_define_method(klass, "zsize", tableZSize);
   _rb_define_method(klass, "[]", tableGetAt);
   _rb_define_method(klass, "[]=", tableSetAt);
+  _rb_define_method(klass, "fill", tableFill);
+  _rb_define_method(klass, "copy_rect", tableCopyRect);
+  _rb_define_method(klass, "set_many", tableSetMany);
+  _rb_define_method(klass, "batch", tableBatch);
 }
@@ -1,6 +1,7 @@
 #include "MToolClient.h"
 
 #include <cstring>
+#include <cerrno>
 #include <thread>
 #include <queue>
 #include <condition_variable>
@@ -25,6 +26,7 @@
     }
 #else
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include <arpa/inet.h>
     #include <netinet/in.h>
     #include <netinet/tcp.h>
@@ -40,11 +42,20 @@
     inline void cleanup_socket_system() { }
 #endif
 
+// 帧头: 4 字节长度 + 4 字节类型 (小端序)
+enum FrameType : uint32_t {
+    FrameText   = 1,
+    FrameBinary = 2,
+    // 4 字节元数据长度 + CBOR 元数据 + 原始字节负载
+    FramePacked = 3,
+    FrameClose  = 255
+};
+
 class MToolClientImpl {
 public:
     MToolClientImpl(const std::string& host, int port, const std::string& path) 
         : m_host(host), m_port(port), m_path(path), m_socket(SOCKET_INVALID), 
-          m_connected(false), m_shouldRun(false) {
+          m_connected(false), m_connecting(false), m_shouldRun(false) {
         init_socket_system();
     }
 
@@ -58,6 +69,19 @@ public:
         m_connecting = true;
         std::lock_guard<std::mutex> lock(m_mutex);
 
+        // 重连: 回收上一次连接留下的接收线程和套接字
+        if (m_receiveThread.joinable()) {
+            if (m_receiveThread.get_id() == std::this_thread::get_id()) {
+                m_receiveThread.detach();
+            } else {
+                m_receiveThread.join();
+            }
+        }
+        if (m_socket != SOCKET_INVALID) {
+            CLOSE_SOCKET(m_socket);
+            m_socket = SOCKET_INVALID;
+        }
+
         // 创建套接字
         m_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
         if (m_socket == SOCKET_INVALID) {
@@ -161,11 +185,21 @@ public:
     }
 
     bool SendTextMessage(const std::string& message) {
-        return SendData(message.data(), message.size(), 1); // 类型1为文本消息
+        return SendData(message.data(), message.size(), FrameText);
     }
 
     bool SendBinary(const std::vector<uint8_t>& data) {
-        return SendData(data.data(), data.size(), 2); // 类型2为二进制消息
+        return SendData(data.data(), data.size(), FrameBinary);
+    }
+
+    bool SendPacked(const std::vector<uint8_t>& meta, const void* payload, size_t payloadSize) {
+        uint32_t metaLen = (uint32_t)meta.size();
+        Chunk chunks[3] = {
+            { &metaLen, sizeof(metaLen) },
+            { meta.data(), meta.size() },
+            { payload, payloadSize }
+        };
+        return SendChunks(chunks, payloadSize > 0 ? 3 : 2, FramePacked);
     }
 
     void Close() {
@@ -180,7 +214,7 @@ public:
             uint8_t header[8] = {0};
             // 设置长度为0
             // 设置类型为255
-            *((uint32_t*)&header[4]) = 255;
+            *((uint32_t*)&header[4]) = FrameClose;
             
             send(m_socket, (const char*)header, sizeof(header), 0);
 
@@ -216,6 +250,10 @@ public:
         m_binaryMessageCallback = std::move(callback);
     }
 
+    void SetPackedMessageCallback(MToolClient::PackedMessageCallback callback) {
+        m_packedMessageCallback = std::move(callback);
+    }
+
     void SetErrorCallback(MToolClient::ErrorCallback callback) {
         m_errorCallback = std::move(callback);
     }
@@ -229,35 +267,117 @@ public:
     }
 
 private:
+    struct Chunk {
+        const void* data;
+        size_t size;
+    };
+
     bool SendData(const void* data, size_t size, uint32_t type) {
+        Chunk chunk = { data, size };
+        return SendChunks(&chunk, size > 0 ? 1 : 0, type);
+    }
+
+    // 帧头和各段负载合并为一次 writev 式的系统调用, 不再拼接缓冲区
+    bool SendChunks(const Chunk* chunks, int count, uint32_t type) {
         if (!m_connected || m_socket == SOCKET_INVALID) {
             //ReportError("客户端未连接");
             return false;
         }
 
-        std::lock_guard<std::mutex> lock(m_sendMutex);
+        size_t size = 0;
+        for (int i = 0; i < count; i++) {
+            size += chunks[i].size;
+        }
+        if (size > UINT32_MAX) {
+            ReportError("消息过大");
+            return false;
+        }
 
         // 构建消息头
         uint8_t header[8] = {0};
         *((uint32_t*)&header[0]) = (uint32_t)size; // 小端序
         *((uint32_t*)&header[4]) = type;           // 小端序
 
-        // 发送消息头
-        if (send(m_socket, (const char*)header, sizeof(header), 0) == SOCKET_ERROR_VAL) {
-            ReportError("发送消息头失败");
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+
+        if (!SendAll(header, chunks, count)) {
+            ReportError("发送消息失败: " + std::to_string(GET_SOCKET_ERROR));
             return false;
         }
 
-        // 发送消息体
-        if (size > 0) {
-            if (send(m_socket, (const char*)data, (int)size, 0) == SOCKET_ERROR_VAL) {
-                ReportError("发送消息体失败");
+        return true;
+    }
+
+#ifdef _WIN32
+    bool SendAll(const uint8_t* header, const Chunk* chunks, int count) {
+        if (!SendExact(header, 8)) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!SendExact(chunks[i].data, chunks[i].size)) {
                 return false;
             }
         }
+        return true;
+    }
 
+    bool SendExact(const void* data, size_t size) {
+        const char* buf = static_cast<const char*>(data);
+        while (size > 0) {
+            int result = send(m_socket, buf, (int)size, 0);
+            if (result == SOCKET_ERROR_VAL) {
+                return false;
+            }
+            buf += result;
+            size -= result;
+        }
         return true;
     }
+#else
+    bool SendAll(const uint8_t* header, const Chunk* chunks, int count) {
+        struct iovec iov[4];
+        int iovcnt = 0;
+        iov[iovcnt].iov_base = (void*)header;
+        iov[iovcnt].iov_len = 8;
+        iovcnt++;
+        for (int i = 0; i < count && iovcnt < 4; i++) {
+            if (chunks[i].size == 0) {
+                continue;
+            }
+            iov[iovcnt].iov_base = (void*)chunks[i].data;
+            iov[iovcnt].iov_len = chunks[i].size;
+            iovcnt++;
+        }
+
+        // sendmsg 等同于 writev, 但可以带 MSG_NOSIGNAL 避免对端关闭时触发 SIGPIPE
+        struct iovec* cur = iov;
+        while (iovcnt > 0) {
+            struct msghdr msg = {};
+            msg.msg_iov = cur;
+            msg.msg_iovlen = iovcnt;
+            ssize_t result = sendmsg(m_socket, &msg, MSG_NOSIGNAL);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+
+            // 处理部分写入
+            size_t written = (size_t)result;
+            while (iovcnt > 0 && written >= cur->iov_len) {
+                written -= cur->iov_len;
+                cur++;
+                iovcnt--;
+            }
+            if (iovcnt > 0) {
+                cur->iov_base = (char*)cur->iov_base + written;
+                cur->iov_len -= written;
+            }
+        }
+        return true;
+    }
+#endif
 
     void ReceiveThread() {
         while (m_shouldRun && m_connected) {
@@ -272,10 +392,17 @@ private:
             uint32_t type = *((uint32_t*)&headerBuffer[4]);   // 小端序
 
             // 处理关闭消息
-            if (type == 255) {
+            if (type == FrameClose) {
                 break;
             }
 
+            if (type == FramePacked) {
+                if (!ReceivePacked(length)) {
+                    break;
+                }
+                continue;
+            }
+
             // 读取消息内容
             if (length > 0) {
                 std::vector<uint8_t> dataBuffer(length);
@@ -284,11 +411,11 @@ private:
                 }
 
                 // 处理消息
-                if (type == 2 && m_binaryMessageCallback) {
+                if (type == FrameBinary && m_binaryMessageCallback) {
                     // 二进制消息
                     m_binaryMessageCallback(dataBuffer);
                 }
-                else if (type == 1 && m_messageCallback) {
+                else if (type == FrameText && m_messageCallback) {
                     // 文本消息
                     std::string message(dataBuffer.begin(), dataBuffer.end());
                     m_messageCallback(message);
@@ -306,6 +433,29 @@ private:
         }
     }
 
+    // 元数据和负载分别直接读入各自的缓冲区, 负载不再经过额外拷贝
+    bool ReceivePacked(uint32_t length) {
+        uint32_t metaLen = 0;
+        if (length < sizeof(metaLen) || !ReadExact(&metaLen, sizeof(metaLen))) {
+            return false;
+        }
+        if (metaLen > length - sizeof(metaLen)) {
+            ReportError("打包消息元数据长度无效");
+            return false;
+        }
+
+        std::vector<uint8_t> meta(metaLen);
+        std::string payload(length - sizeof(metaLen) - metaLen, '\0');
+        if (!ReadExact(meta.data(), meta.size()) || !ReadExact(&payload[0], payload.size())) {
+            return false;
+        }
+
+        if (m_packedMessageCallback) {
+            m_packedMessageCallback(meta, payload);
+        }
+        return true;
+    }
+
     bool ReadExact(void* buffer, size_t size) {
         size_t bytesRead = 0;
         char* buf = static_cast<char*>(buffer);
@@ -352,6 +502,7 @@ private:
 
     MToolClient::MessageCallback m_messageCallback;
     MToolClient::BinaryMessageCallback m_binaryMessageCallback;
+    MToolClient::PackedMessageCallback m_packedMessageCallback;
     MToolClient::ErrorCallback m_errorCallback;
     MToolClient::StateCallback m_closedCallback;
     MToolClient::StateCallback m_connectedCallback;
@@ -382,6 +533,10 @@ bool MToolClient::SendBinary(const std::vector<uint8_t>& data) {
     return m_impl->SendBinary(data);
 }
 
+bool MToolClient::SendPacked(const std::vector<uint8_t>& meta, const void* payload, size_t payloadSize) {
+    return m_impl->SendPacked(meta, payload, payloadSize);
+}
+
 void MToolClient::Close() {
     m_impl->Close();
 }
@@ -402,6 +557,10 @@ void MToolClient::SetBinaryMessageCallback(BinaryMessageCallback callback) {
     m_impl->SetBinaryMessageCallback(std::move(callback));
 }
 
+void MToolClient::SetPackedMessageCallback(PackedMessageCallback callback) {
+    m_impl->SetPackedMessageCallback(std::move(callback));
+}
+
 void MToolClient::SetErrorCallback(ErrorCallback callback) {
     m_impl->SetErrorCallback(std::move(callback));
 }
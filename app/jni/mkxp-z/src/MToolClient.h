@@ -7,6 +7,8 @@
 #include <memory>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <chrono>
 
 #ifdef __ANDROID__
 #include <jni.h>
@@ -20,9 +22,13 @@ struct RGSSEvalStruct
     std::unique_lock<std::mutex> lck = std::unique_lock<std::mutex>(mux);
     char*  script;
     vptr  ret;
+    std::string retStr;
     bool   retUTF8Str;
     bool   evalDone;
     bool   free;
+    // 允许在队列中等待的时长, 超出后可在 Graphics.update 以外的安全点执行
+    long   budgetMs;
+    std::chrono::steady_clock::time_point queued;
 };
 // 前向声明
 class MToolClientImpl;
@@ -32,6 +38,8 @@ public:
     // 回调函数类型定义
     using MessageCallback = std::function<void(const std::string&)>;
     using BinaryMessageCallback = std::function<void(const std::vector<uint8_t>&)>;
+    // 打包消息: CBOR 元数据 + 原始负载, 回调可直接 move 走两者
+    using PackedMessageCallback = std::function<void(std::vector<uint8_t>& meta, std::string& payload)>;
     using ErrorCallback = std::function<void(const std::string&)>;
     using StateCallback = std::function<void()>;
 
@@ -49,6 +57,8 @@ public:
     // 发送方法 - 避免与Windows API SendMessage冲突
     bool SendTextMessage(const std::string& message);
     bool SendBinary(const std::vector<uint8_t>& data);
+    // 负载直接从调用方缓冲区写出, 不做拷贝
+    bool SendPacked(const std::vector<uint8_t>& meta, const void* payload = nullptr, size_t payloadSize = 0);
 
     // 关闭连接
     void Close();
@@ -60,6 +70,7 @@ public:
     // 设置回调
     void SetMessageCallback(MessageCallback callback);
     void SetBinaryMessageCallback(BinaryMessageCallback callback);
+    void SetPackedMessageCallback(PackedMessageCallback callback);
     void SetErrorCallback(ErrorCallback callback);
     void SetClosedCallback(StateCallback callback);
     void SetConnectedCallback(StateCallback callback);
@@ -9,6 +9,13 @@
 #include <unistd.h>
 #include "android/log.h"
 #include "concurrent_queue.h"
+#include "TrsCache.h"
+#include "TrsPrefetch.h"
+#include "TrsDict.h"
+#include "MtoolRpc.h"
+#include "RubyProfiler.h"
+#include "sharedstate.h"
+#include "config.h"
 
 
 #include <ruby.h>
@@ -17,6 +24,9 @@
 #ifdef MKXPZ_RUBY_193
 #include <ruby/encoding.h>
 #endif
+#ifndef MKXPZ_LEGACY_RUBY
+#include <ruby/debug.h>
+#endif
 
 // Ruby版本兼容性函数
 #ifdef MKXPZ_RUBY_187
@@ -51,6 +61,11 @@ void debugout(const char *fmt, ...) {
 
 int MtoolServerport = 0;
 
+TrsCache trsCache;
+TrsPrefetcher trsPrefetcher(trsCache);
+// 通过 std::atomic_load/atomic_store 访问, 可在网络线程中替换
+std::shared_ptr<TrsDict> trsDict;
+
 MtoolProc::MtoolProc() {
     this->trsLoaded = false;
     this->m_initialized = false;
@@ -60,9 +75,13 @@ void MtoolProc::staticCall() {
     if (instance == nullptr) {
         instance = new MtoolProc();
     }
-    instance->onEventLoop();
+    if (!instance->m_initialized) {
+        instance->init();
+    }
+    instance->onEventLoop(PumpFrame);
 }
 VALUE rb_mri_fixString(VALUE self, VALUE arg, VALUE len);
+VALUE rb_mri_prefetchTrs(VALUE self, VALUE arg);
 VALUE rb_MRI_doEvals(VALUE self, VALUE arg) {
     return 0;
 }
@@ -86,10 +105,33 @@ void MtoolProc::init() {
     rb_define_global_function("callMtoolServer", RUBY_METHOD_FUNC(callMtoolServer), 2);
     rb_define_global_function("fixString", RUBY_METHOD_FUNC(rb_mri_fixString), 2);
     rb_define_global_function("doMToolEvals", RUBY_METHOD_FUNC(rb_MRI_doEvals), 0);
+    rb_define_global_function("prefetchTrs", RUBY_METHOD_FUNC(rb_mri_prefetchTrs), 1);
+
+    trsCache.setCapacity((size_t) shState->config().mtool.trsCacheSize);
+    trsAsync = shState->config().mtool.trsAsync;
+    trsPrefetcher.setMaxBatch((size_t) shState->config().mtool.trsBatchSize);
+    trsPrefetcher.start();
+
+    m_evalBudgetMs = shState->config().mtool.evalBudgetMs;
+    m_pumpSliceMs = shState->config().mtool.pumpSliceMs;
+    m_pumpIntervalMs = shState->config().mtool.pumpIntervalMs;
+    m_lastPump = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (m_pumpIntervalMs > 0) {
+        std::thread(&MtoolProc::pumpTimerLoop, this).detach();
+    }
+
+    m_packed = shState->config().mtool.packedMessages;
 
     m_host = "127.0.0.1"; // 默认主机地址
     m_port = MtoolServerport; // 默认端口号
     m_client = new MToolClient(m_host, m_port, "/");
+    m_rpc = new MtoolRpc([this](const json &request) {
+        return sendRequest(request);
+    });
+    m_reconnectMs = shState->config().mtool.reconnectMs;
+    m_taskPool = new WorkerPool<json>(shState->config().mtool.workerThreads,
+                                      shState->config().mtool.taskQueueSize,
+                                      [this](json &j) { runTask(j); });
 
     // 设置回调函数
     m_client->SetMessageCallback([this](const std::string &message) {
@@ -100,6 +142,10 @@ void MtoolProc::init() {
         handleBinaryMessage(data);
     });
 
+    m_client->SetPackedMessageCallback([this](std::vector<uint8_t> &meta, std::string &payload) {
+        handlePackedMessage(meta, payload);
+    });
+
     m_client->SetErrorCallback([this](const std::string &error) {
         handleError(error);
     });
@@ -194,80 +240,52 @@ extern "C" int RGSSEval(const char *script) {
     // state为0表示正确执行
     return state;
 }
-std::vector<char *> cacheOriV = std::vector<char *>();
-std::vector<char *> cacheDstV = std::vector<char *>();
 
-char* __cdecl fixString(char* str, int size)
+static void writeBackString(char *str, int size, const char *out, size_t outLen) {
+    if (size <= 0) {
+        return;
+    }
+    int copyLen = std::min(size - 1, (int) outLen);
+    memcpy(str, out, copyLen);
+    memset(str + copyLen, 0, size - copyLen);
+}
+
+static void writeBackString(char *str, int size, const std::string &out) {
+    writeBackString(str, size, out.data(), out.size());
+}
+
+std::string fixString(char* str, int size)
 {
     try {
         if (!MtoolProc::instance->trsLoaded) {
             return str;
         }
         std::string traget = std::string(str);
-        if (distance(traget.begin(), traget.end()) < 2) {
-            return str;
+        if (traget.size() < 2) {
+            return traget;
         }
 
-        for (int i = 0; i < cacheOriV.size(); i++) {
-            if (traget.compare(cacheDstV[i]) == 0) {
-                return cacheDstV[i];
-            }
-            if (traget.compare(cacheOriV[i]) == 0) {
-                int len = strlen(cacheDstV[i]);
-                memcpy(str, cacheDstV[i], len);
-                if (size - len > 0) {
-                    memset(str + len, 0, size - len);
-                }
-                return cacheDstV[i];
+        std::string cached;
+        if (trsCache.lookup(traget, cached)) {
+            if (cached != traget) {
+                writeBackString(str, size, cached);
             }
+            return cached;
         }
 
-        const char* outStr = str;
-        std::string retStr;
-        try {
-            json::array_t args;
-            args.push_back(traget);
-            json ret = MtoolProc::instance->doTask("trs", args, 3000);
-            retStr = ret["ret"].get<std::string>();
-            outStr = retStr.c_str();
-        }
-        catch (std::exception e) {
-            return str;
+        // 非阻塞模式: 先显示原文, 译文由后台线程在帧末批量取回
+        if (MtoolProc::instance->trsAsync) {
+            trsPrefetcher.enqueue(traget);
+            return traget;
         }
 
-        int len = strlen(outStr);
-        char* cacheStr = (char*)malloc(len + 1);
-        memcpy((void*)cacheStr, outStr, len + 1);
-        cacheStr[len] = 0;
-
-
-        // 若缓存已达到 1000 条，移除最早的一条
-        if (cacheOriV.size() >= 1000) {
-            // 释放最前面一条对应的内存
-            free(cacheOriV.front());
-            cacheOriV.erase(cacheOriV.begin());
-            free(cacheDstV.front());
-            cacheDstV.erase(cacheDstV.begin());
+        std::string retStr;
+        if (!trsPrefetcher.translateNow(traget, retStr, 3000)) {
+            return traget;
         }
 
-        int nlen = strlen(cacheStr);
-        cacheDstV.push_back(cacheStr);
-        int tlen = traget.length();
-        char* cacheOri = (char*)malloc(tlen + 1);
-        memcpy(cacheOri, traget.c_str(), tlen);
-        cacheOri[tlen] = 0;
-        cacheOriV.push_back(cacheOri);
-        //zeroMemory
-        for(int i = 0; i < size; i++) {
-            str[i] = 0;
-        }
-        int copyLen = (((size) < (nlen)) ? (size) : (nlen));
-        if (copyLen > 0) {
-            memcpy(str, cacheStr, copyLen);
-            str[copyLen] = 0;
-        }
-        //str[nlen + 1] = 0;
-        return cacheStr;
+        writeBackString(str, size, retStr);
+        return retStr;
     }
     catch (std::exception& err) {
         return str;
@@ -293,176 +311,362 @@ VALUE rb_mri_fixString(VALUE self, VALUE arg, VALUE len) {
 
     // 调用fixString修正字符串，获取长度参数
     int length = NUM2INT(len);  // 使用NUM2INT代替rb_fix2int以支持更广泛的整数类型
-    char* out = fixString(str, length);
 
-    // 使用修正后的字符串创建新的Ruby字符串
-    VALUE result = rb_str_new_cstr(out);
+    // 词典命中时直接返回, 不经过缓存和网络
+    std::shared_ptr<TrsDict> dict = std::atomic_load(&trsDict);
+    if (dict && MtoolProc::instance->trsLoaded) {
+        size_t srcLen = strlen(str);
+        const char *dst;
+        size_t dstLen;
+        if (dict->lookup(str, srcLen, dst, dstLen)) {
+            writeBackString(str, length, dst, dstLen);
+            return rb_str_new(dst, dstLen);
+        }
+        if (dict->isTranslation(str, srcLen)) {
+            return rb_str_new(str, srcLen);
+        }
+    }
 
-    // 注意：这里不需要手动释放out指针，因为fixString内部已经缓存了字符串
+    std::string out = fixString(str, length);
+
+    // 使用修正后的字符串创建新的Ruby字符串
+    VALUE result = rb_str_new(out.data(), out.size());
 
     return result;
 }
 
+VALUE rb_mri_prefetchTrs(VALUE self, VALUE arg) {
+    if (!MtoolProc::instance->trsLoaded) {
+        return Qnil;
+    }
+    if (TYPE(arg) == T_STRING) {
+        arg = rb_ary_new3(1, arg);
+    }
+    Check_Type(arg, T_ARRAY);
+
+    std::shared_ptr<TrsDict> dict = std::atomic_load(&trsDict);
+    std::string cached;
+    const char *dst;
+    size_t dstLen;
+    for (long i = 0; i < RARRAY_LEN(arg); i++) {
+        VALUE item = rb_ary_entry(arg, i);
+        if (TYPE(item) != T_STRING || RSTRING_LEN(item) < 2) {
+            continue;
+        }
+        if (dict && dict->lookup(RSTRING_PTR(item), RSTRING_LEN(item), dst, dstLen)) {
+            continue;
+        }
+        std::string src(RSTRING_PTR(item), RSTRING_LEN(item));
+        if (!trsCache.lookup(src, cached)) {
+            trsPrefetcher.enqueue(src);
+        }
+    }
+    trsPrefetcher.flush();
+    return Qnil;
+}
+
 concurrent_queue<RGSSEvalStruct *> tq;
+// 已入队但尚未执行的 eval 数量, 供定时线程判断是否需要唤醒
+std::atomic<int> pendingEvals(0);
+
+static void runEval(RGSSEvalStruct *evalStruct) {
+    //debugout("eval script: %s\n", evalStruct->script);
+    vptr ret;
+    std::string retStr;
+    try {
+        if (evalStruct->retUTF8Str) {
+            retStr = RGSSGetStringUTF8(evalStruct->script);
+            ret = 0;
+        } else {
+            ret = RGSSEval(evalStruct->script);
+        }
+    }
+    catch (...) {
+        if (evalStruct->retUTF8Str) {
+            retStr = "Err";
+        } else {
+            ret = 99;
+        }
+    }
+    // 持锁通知, 避免等待方尚未进入 wait 时丢失唤醒
+    std::lock_guard<std::mutex> lock(evalStruct->mux);
+    evalStruct->ret = ret;
+    evalStruct->retStr = std::move(retStr);
+    evalStruct->evalDone = true;
+    evalStruct->cv.notify_all();
+}
+
+void MtoolProc::onEventLoop(PumpPoint point) {
+    // 重入保护: eval 的脚本内部可能再次调用 Input.update 等
+    if (m_pumping) {
+        return;
+    }
+    m_pumping = true;
 
-void MtoolProc::onEventLoop() {
-    if (!this->m_initialized) {
-        this->init();
+    if (point == PumpFrame) {
+        // 本帧积累的未命中字符串合并为一次请求
+        trsPrefetcher.flush();
     }
+
     RGSSEvalStruct *evalStruct;
     while (tq.try_pop(evalStruct)) {
-        //debugout("eval script: %s\n", evalStruct->script);
-        try {
-            if (evalStruct->retUTF8Str) {
-                evalStruct->ret = (vptr) (RGSSGetStringUTF8(evalStruct->script));
-            } else {
-                evalStruct->ret = RGSSEval(evalStruct->script);
+        m_ready.push_back(evalStruct);
+    }
+
+    // Graphics.update 处照旧全部执行; 其它安全点只执行已超出
+    // 延迟预算的命令, 并限制单次占用的时间, 以免影响帧率
+    auto now = std::chrono::steady_clock::now();
+    auto sliceEnd = now + std::chrono::milliseconds(m_pumpSliceMs);
+    for (auto it = m_ready.begin(); it != m_ready.end();) {
+        evalStruct = *it;
+        if (point != PumpFrame) {
+            if (now - evalStruct->queued < std::chrono::milliseconds(evalStruct->budgetMs)) {
+                ++it;
+                continue;
             }
-        }
-        catch (...) {
-            if (evalStruct->retUTF8Str) {
-                evalStruct->ret = (vptr) "Err";
-            } else {
-                evalStruct->ret = 99;
+            if (std::chrono::steady_clock::now() >= sliceEnd) {
+                break;
             }
         }
-        evalStruct->evalDone = true;
-        evalStruct->cv.notify_all();
-        if (evalStruct->free) {
-            //free(evalStruct->script);
+        it = m_ready.erase(it);
+        pendingEvals--;
+        runEval(evalStruct);
+    }
+
+    m_lastPump = now.time_since_epoch().count();
+    m_pumping = false;
+}
+
+void MtoolProc::pump(PumpPoint point) {
+    // 首次初始化仍由 Graphics.update 触发
+    if (instance == nullptr || !instance->m_initialized) {
+        return;
+    }
+    instance->onEventLoop(point);
+}
+
+#ifndef MKXPZ_LEGACY_RUBY
+static void pumpTimerJob(void *) {
+    MtoolProc::pump(MtoolProc::PumpTimer);
+}
+#endif
+
+void MtoolProc::pumpTimerLoop() {
+    auto interval = std::chrono::milliseconds(m_pumpIntervalMs);
+    while (true) {
+        std::this_thread::sleep_for(interval);
+        if (pendingEvals <= 0) {
+            continue;
+        }
+        auto last = std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(m_lastPump.load()));
+        if (std::chrono::steady_clock::now() - last < interval) {
+            continue;
         }
+#ifndef MKXPZ_LEGACY_RUBY
+        // 在 Ruby 线程下一次检查中断时执行 (持有 GVL)
+        rb_postponed_job_register_one(0, pumpTimerJob, nullptr);
+#endif
     }
 }
 
 bool keyDownStatus[65535];
 using json = nlohmann::json;
-long taskId = 0;
-std::map<long, MTOOL_WsTask *> wsTasks;
 
-json MtoolProc::doTask(std::string cmd, json args, long timeoutMS) {
-    if (!m_client->IsConnected()) {
-        throw std::exception();
-    }
-    taskId++;
-    long id = taskId;
-    MTOOL_WsTask task{id};
-    if (timeoutMS >= 0) {
-        wsTasks.emplace(id, &task);
-    }
-    json sendJson;
-    sendJson["id"] = id;
-    sendJson["cmd"] = cmd;
-    sendJson["args"] = args;
-    std::string dump = sendJson.dump(-1, (char) 32, false, json::error_handler_t::replace);
-    bool sendOK = this->m_client->SendTextMessage(dump);
-    if (timeoutMS == -1) {
-        return NULL;
+bool MtoolProc::isConnected() const {
+    return m_client != nullptr && m_client->IsConnected();
+}
+
+bool MtoolProc::sendRequest(const json &request) {
+    if (m_packed) {
+        return this->m_client->SendPacked(json::to_cbor(request));
     }
-    if (!sendOK) {
+    std::string dump = request.dump(-1, (char) 32, false, json::error_handler_t::replace);
+    return this->m_client->SendTextMessage(dump);
+}
+
+std::future<json> MtoolProc::doTaskAsync(const std::string &cmd, json args, long timeoutMS, long *id) {
+    if (!isConnected()) {
         throw std::exception();
     }
-    if (timeoutMS == 0) {
-        task.cv.wait(task.lck);
-    } else {
-        if (timeoutMS >= 0) {
-            std::cv_status cvs = task.cv.wait_for(task.lck, std::chrono::milliseconds(timeoutMS));
-            if (cvs == std::cv_status::timeout) {
-                wsTasks.erase(id);
-                throw std::exception();
-            }
-        } else {
-            return NULL;
-        }
-    }
-    wsTasks.erase(id);
-    if (task.ret.contains("err")) {
-        if (timeoutMS == -1) { return NULL; }
-        throw std::exception();
+    return m_rpc->callFuture(cmd, std::move(args), timeoutMS, true, id);
+}
+
+bool MtoolProc::cancelTask(long id) {
+    return m_rpc != nullptr && m_rpc->cancel(id);
+}
 
+json MtoolProc::doTask(std::string cmd, json args, long timeoutMS) {
+    if (!isConnected()) {
+        throw std::exception();
+    }
+    if (timeoutMS < 0) {
+        m_rpc->notify(cmd, std::move(args));
+        return NULL;
     }
-    return task.ret;
+    // 超时, 断线或服务端返回 err 时 get() 抛出异常
+    return m_rpc->callFuture(cmd, std::move(args), timeoutMS).get();
 }
 
 
 void MtoolProc::handleTextMessage(const std::string &message) {
     // 处理文本消息
     //debugout("Received text message: %s\n", message.c_str());
-    json j = json::parse(message.c_str());
-    long id = j["id"].get<long>();
-    if (j.contains("id") && j.contains("ret")) {
-        if (wsTasks.count(id) != 0) {
-            MTOOL_WsTask *wsTask = wsTasks[id];
-            wsTask->ret = j;
-            wsTask->cv.notify_one();
-        }
+    json j = json::parse(message, nullptr, false);
+    if (!j.is_object()) {
         return;
     }
-    std::thread([j = std::move(j), this]() {  // 值捕获 j，而不是引用捕获
-/*        bool logTask = true;
-        if (j.contains("cmd")) {
-            if (j["cmd"].get<std::string>() == "whoareyou") {
-                logTask = false;
-            }
-            if (j["cmd"].get<std::string>() == "cwd") {
-                logTask = false;
+    dispatchMessage(std::move(j));
+}
+
+void MtoolProc::handlePackedMessage(std::vector<uint8_t> &meta, std::string &payload) {
+    json j = json::from_cbor(meta, true, false);
+    if (!j.is_object()) {
+        debugout("Invalid packed message (%zu bytes)\n", meta.size());
+        return;
+    }
+    // 负载代替命令的第一个参数或返回值, 不经过 JSON 转义
+    if (j.contains("cmd")) {
+        if (!payload.empty()) {
+            if (!j.contains("args") || !j["args"].is_array()) {
+                j["args"] = json::array();
             }
+            j["args"].insert(j["args"].begin(), json(std::move(payload)));
         }
-        if (logTask) {
-            debugout("Task: %s\n", j.dump().c_str());
-        }*/
-        std::string ret = processTask(j);
+    } else if (!j.contains("ret")) {
+        j["ret"] = std::move(payload);
+    }
+    j["packed"] = true;
+    dispatchMessage(std::move(j));
+}
+
+void MtoolProc::dispatchMessage(json j) {
+    if (!j.contains("id")) {
+        return;
+    }
+    if (j.contains("ret")) {
+        m_rpc->complete(j);
+        return;
+    }
+    bool packed = j.value("packed", false);
+    if (j.contains("cmd") && j["cmd"] == "taskPoolStats") {
+        // 不经过线程池, 线程池占满时也能查询
+        sendTaskReturn(j["id"], taskPoolStats(), packed);
+        return;
+    }
+    json jid = j["id"];
+    // 队列已满时立即拒绝: 接收线程同时负责投递 RPC 回复,
+    // 阻塞它会让等待回复的 Ruby 线程 (以及占着线程池的 eval) 一起卡住
+    if (!m_taskPool->push(std::move(j), 0)) {
         json jret;
-        jret["id"] = j["id"];
-        jret["ret"] = ret;
-        std::string dump = jret.dump(-1, (char) 32, false, json::error_handler_t::replace);
-/*        if (logTask) {
-            debugout("Task Return: %s\n", dump.c_str());
-        }*/
-        this->m_client->SendTextMessage(dump);
-    }).detach();
+        jret["id"] = jid;
+        jret["ret"] = "Err: busy";
+        jret["err"] = "busy";
+        if (packed) {
+            this->m_client->SendPacked(json::to_cbor(jret));
+        } else {
+            this->m_client->SendTextMessage(jret.dump(-1, (char) 32, false, json::error_handler_t::replace));
+        }
+    }
+}
+
+void MtoolProc::runTask(json &j) {
+/*    bool logTask = true;
+    if (j.contains("cmd")) {
+        if (j["cmd"].get<std::string>() == "whoareyou") {
+            logTask = false;
+        }
+        if (j["cmd"].get<std::string>() == "cwd") {
+            logTask = false;
+        }
+    }
+    if (logTask) {
+        debugout("Task: %s\n", j.dump().c_str());
+    }*/
+    std::string ret;
+    try {
+        ret = processTask(j);
+    }
+    catch (std::exception &e) {
+        ret = std::string("Err: ") + e.what();
+    }
+    sendTaskReturn(j["id"], ret, j.value("packed", false));
+}
+
+void MtoolProc::sendTaskReturn(const json &id, const std::string &ret, bool packed) {
+    json jret;
+    if (packed) {
+        // 以请求相同的格式回复, 返回值作为原始负载写出
+        jret["id"] = id;
+        this->m_client->SendPacked(json::to_cbor(jret), ret.data(), ret.size());
+        return;
+    }
+    jret["id"] = id;
+    jret["ret"] = ret;
+    std::string dump = jret.dump(-1, (char) 32, false, json::error_handler_t::replace);
+/*    debugout("Task Return: %s\n", dump.c_str());*/
+    this->m_client->SendTextMessage(dump);
+}
+
+std::string MtoolProc::taskPoolStats() {
+    WorkerPool<json>::Stats st = m_taskPool->getStats();
+    json jst;
+    jst["threads"] = st.threads;
+    jst["capacity"] = st.capacity;
+    jst["queueDepth"] = st.queueDepth;
+    jst["maxQueueDepth"] = st.maxQueueDepth;
+    jst["busy"] = st.busy;
+    jst["completed"] = st.completed;
+    jst["rejected"] = st.rejected;
+    jst["avgWaitUs"] = st.completed ? st.totalWaitUs / st.completed : 0;
+    jst["maxWaitUs"] = st.maxWaitUs;
+    jst["avgRunUs"] = st.completed ? st.totalRunUs / st.completed : 0;
+    jst["maxRunUs"] = st.maxRunUs;
+    return jst.dump();
 }
 
 
 
 
-RGSSEvalStruct *genEvalStructArg(char *script, bool returnUTF8Str) {
+RGSSEvalStruct *genEvalStructArg(char *script, bool returnUTF8Str, long budgetMs) {
     RGSSEvalStruct *retS = new RGSSEvalStruct();
     retS->script = script;
     retS->ret = 0;
     retS->retUTF8Str = returnUTF8Str;
     retS->evalDone = false;
     retS->free = true;
+    retS->budgetMs = budgetMs;
+    retS->queued = std::chrono::steady_clock::now();
     return retS;
 }
 
-RGSSEvalStruct *genEvalUTF8Struct(char *script) {
-    return genEvalStructArg(script, true);
-}
-
-RGSSEvalStruct *genEvalStruct(char *script) {
-    return genEvalStructArg(script, false);
+static void waitEval(RGSSEvalStruct *retS) {
+    pendingEvals++;
+    tq.push(retS);
+    retS->cv.wait(retS->lck, [retS]() { return retS->evalDone; });
 }
 
-int RGSSEvalLoop(char *script) {
-    RGSSEvalStruct *retS = genEvalStruct(script);
-    tq.push(retS);
-    retS->cv.wait(retS->lck);
-    return retS->ret;
+int RGSSEvalLoop(char *script, long budgetMs) {
+    RGSSEvalStruct *retS = genEvalStructArg(script, false, budgetMs);
+    waitEval(retS);
+    int ret = (int) retS->ret;
+    delete retS;
+    return ret;
 }
 
-int RGSSEvalLoopNofree(char *script) {
-    RGSSEvalStruct *retS = genEvalStruct(script);
-    retS->free = false;
-    tq.push(retS);
-    retS->cv.wait(retS->lck);
-    return retS->ret;
+std::string RGSSEvalUTF8Loop(char *script, long budgetMs) {
+    RGSSEvalStruct *retS = genEvalStructArg(script, true, budgetMs);
+    waitEval(retS);
+    std::string ret = std::move(retS->retStr);
+    delete retS;
+    return ret;
 }
 
-char *RGSSEvalUTF8Loop(char *script) {
-    RGSSEvalStruct *retS = genEvalUTF8Struct(script);
-    tq.push(retS);
-    retS->cv.wait(retS->lck);
-    return (char *) retS->ret;
+long MtoolProc::evalBudget(const json &data) const {
+    if (data.contains("budget") && data["budget"].is_number()) {
+        return std::max(0L, data["budget"].get<long>());
+    }
+    return m_evalBudgetMs;
 }
 
 std::string MtoolProc::processTask(json data) {
@@ -473,16 +677,17 @@ std::string MtoolProc::processTask(json data) {
             arg0 = data["args"][0];
         }
         if (command.compare("eval") == 0) {
-            return RGSSEvalUTF8Loop((char *) arg0.c_str());
+            return RGSSEvalUTF8Loop((char *) arg0.c_str(), evalBudget(data));
         }
 
         if (command.compare("evalI") == 0) {
-            return std::to_string(RGSSEvalLoop((char *) arg0.c_str()));
+            return std::to_string(RGSSEvalLoop((char *) arg0.c_str(), evalBudget(data)));
         }
 
         if (command.compare("evalIBin") == 0) {
             std::string script;
-            if (arg0.c_str()[0] == 0x5b) {
+            // 打包消息的负载即为原始脚本, 无需解码
+            if (!data.value("packed", false) && arg0.c_str()[0] == 0x5b) {
                 json::array_t ca = json::parse(arg0);
                 for (int i = 0; i < ca.size(); i++) {
                     script.push_back((ca[i].get<char>()) ^ 123);
@@ -490,7 +695,7 @@ std::string MtoolProc::processTask(json data) {
             } else {
                 script = arg0;
             }
-            return std::to_string(RGSSEvalLoop((char *) script.c_str()));
+            return std::to_string(RGSSEvalLoop((char *) script.c_str(), evalBudget(data)));
         }
 
         if (command.compare("whoareyou") == 0) {
@@ -508,22 +713,128 @@ std::string MtoolProc::processTask(json data) {
 
         if (command.compare("applyTrs") == 0) {
             trsLoaded = false;
-            cacheDstV.clear();
-            cacheOriV.clear();
+            trsCache.clear();
+            trsPrefetcher.clear();
             trsLoaded = true;
             return "0";
         }
         if (command.compare("unloadTrs") == 0) {
             trsLoaded = false;
-            cacheDstV.clear();
-            cacheOriV.clear();
+            trsCache.clear();
+            trsPrefetcher.clear();
+            std::atomic_store(&trsDict, std::shared_ptr<TrsDict>());
             return "0";
         }
+        if (command.compare("loadTrsDict") == 0) {
+            // args[0]: 由服务端写出的词典文件路径
+            std::string error;
+            std::shared_ptr<TrsDict> dict = TrsDict::openFile(arg0, error);
+            if (!dict) {
+                return "Err: " + error;
+            }
+            installTrsDict(dict);
+            return std::to_string(dict->size());
+        }
+        if (command.compare("applyTrsDict") == 0) {
+            // args[0]: {"原文": "译文", ...}
+            TrsDict::Pairs pairs;
+            if (data["args"].size() > 0 && data["args"][0].is_object()) {
+                const json &obj = data["args"][0];
+                pairs.reserve(obj.size());
+                for (auto it = obj.begin(); it != obj.end(); ++it) {
+                    if (it.value().is_string()) {
+                        pairs.emplace_back(it.key(), it.value().get<std::string>());
+                    }
+                }
+            }
+            std::vector<uint8_t> buf;
+            TrsDict::build(pairs, buf);
+            std::string error;
+            std::shared_ptr<TrsDict> dict = TrsDict::fromBuffer(std::move(buf), error);
+            if (!dict) {
+                return "Err: " + error;
+            }
+            installTrsDict(dict);
+            return std::to_string(dict->size());
+        }
         if (command.compare("clearCache") == 0) {
-            cacheDstV.clear();
-            cacheOriV.clear();
+            trsCache.clear();
+            trsPrefetcher.clear();
             return "0";
         }
+        if (command.compare("rpcStats") == 0) {
+            MtoolRpc::Stats st = m_rpc->stats();
+            json jst;
+            jst["inFlight"] = st.inFlight;
+            jst["sent"] = st.sent;
+            jst["completed"] = st.completed;
+            jst["failed"] = st.failed;
+            jst["timedOut"] = st.timedOut;
+            jst["cancelled"] = st.cancelled;
+            jst["replayed"] = st.replayed;
+            return jst.dump();
+        }
+        if (command.compare("trsCacheStats") == 0) {
+            TrsCache::Stats st = trsCache.stats();
+            json jst;
+            jst["hits"] = st.hits;
+            jst["reverseHits"] = st.reverseHits;
+            jst["misses"] = st.misses;
+            jst["evictions"] = st.evictions;
+            jst["size"] = st.size;
+            jst["capacity"] = st.capacity;
+            std::shared_ptr<TrsDict> dict = std::atomic_load(&trsDict);
+            jst["dictEntries"] = dict ? dict->size() : 0;
+            jst["dictBytes"] = dict ? dict->byteSize() : 0;
+            return jst.dump();
+        }
+        if (command.compare("trsCacheSize") == 0) {
+            if (data["args"].size() > 0 && data["args"][0].is_number_integer()) {
+                long cap = data["args"][0].get<long>();
+                if (cap > 0) {
+                    trsCache.setCapacity((size_t) cap);
+                }
+            }
+            return std::to_string(trsCache.capacity());
+        }
+        if (command.compare("profileStart") == 0) {
+            // args[0]: 采样间隔 (毫秒), 默认 1
+            double intervalMs = 1;
+            if (data["args"].size() > 0 && data["args"][0].is_number()) {
+                intervalMs = data["args"][0].get<double>();
+            }
+            return rubyProfiler.start((long) (intervalMs * 1000)) ? "0" : "Err: already running";
+        }
+        if (command.compare("profileStop") == 0) {
+            // args[0]: 输出文件路径前缀, 默认为数据目录下的 profile
+            std::string path = arg0.empty() ? RubyProfiler::defaultOutBase() : arg0;
+            std::string error;
+            if (!rubyProfiler.stop(path, error)) {
+                return "Err: " + error;
+            }
+            json jret;
+            jret["folded"] = path + ".folded";
+            jret["sections"] = path + ".sections.txt";
+            return jret.dump(-1, (char) 32, false, json::error_handler_t::replace);
+        }
+        if (command.compare("profileStats") == 0) {
+            // 可在采样途中查询
+            RubyProfiler::Summary s = rubyProfiler.summary(20);
+            json jst;
+            jst["running"] = s.running;
+            jst["samples"] = s.samples;
+            jst["sampledMs"] = s.sampledMs;
+            jst["sections"] = json::array();
+            for (const RubyProfiler::SectionTime &t : s.sections) {
+                json js;
+                js["name"] = t.name;
+                js["selfMs"] = t.selfMs;
+                js["totalMs"] = t.totalMs;
+                jst["sections"].push_back(js);
+            }
+            // 脚本名不一定是合法的 UTF-8
+            return jst.dump(-1, (char) 32, false, json::error_handler_t::replace);
+        }
 
     }
     return "unknown command";
@@ -532,29 +843,68 @@ std::string MtoolProc::processTask(json data) {
 void MtoolProc::handleBinaryMessage(const std::vector<uint8_t> &data) {
     // 处理二进制消息
     //debugout("Received binary message of size: %zu\n", data.size());
+    if (TrsDict::isDictData(data.data(), data.size())) {
+        std::string error;
+        std::vector<uint8_t> copy(data);
+        std::shared_ptr<TrsDict> dict = TrsDict::fromBuffer(std::move(copy), error);
+        if (!dict) {
+            debugout("Invalid translation dictionary: %s\n", error.c_str());
+            return;
+        }
+        installTrsDict(dict);
+    }
+}
+
+void MtoolProc::installTrsDict(std::shared_ptr<TrsDict> dict) {
+    std::atomic_store(&trsDict, dict);
+    // 缓存中可能残留旧词典之前逐条取回的译文
+    trsCache.clear();
+    trsPrefetcher.clear();
+    debugout("Translation dictionary loaded: %u entries, %zu bytes\n",
+             dict->size(), dict->byteSize());
 }
 
 void MtoolProc::handleError(const std::string &error) {
     // 处理错误
     debugout("Error: %s\n", error.c_str());
-    //if (!m_client->IsConnected()) {
-    //    debugout("MTool client is not connected, attempting to reconnect...\n");
-    //    m_client->ConnectAsync();
-    //}
+    // 首次 ConnectAsync 失败时只会触发这里, 不会触发 handleClosed
+    if (!m_client->IsConnected()) {
+        startReconnect();
+    }
 }
 
 void MtoolProc::handleConnected() {
     // 处理连接成功事件
     debugout("Connected to MTool server at %s:%d\n", m_host.c_str(), m_port);
+    // 重发断线期间未完成的请求
+    m_rpc->setConnected(true);
 }
 
 void MtoolProc::handleClosed() {
     // 处理连接关闭事件
     debugout("Connection to MTool server closed.\n");
-    //if (!m_client->IsConnected()) {
-        //debugout("MTool client is not connected, attempting to reconnect...\n");
-        //m_client->ConnectAsync();
-    //}
+    m_rpc->setConnected(false);
+    startReconnect();
+}
+
+void MtoolProc::startReconnect() {
+    if (m_reconnectMs > 0 && !m_reconnecting.exchange(true)) {
+        std::thread(&MtoolProc::reconnectLoop, this).detach();
+    }
+}
+
+void MtoolProc::reconnectLoop() {
+    // 指数退避, 最长 30 秒重试一次
+    long delay = m_reconnectMs;
+    while (!m_client->IsConnected()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+        debugout("MTool client is not connected, attempting to reconnect...\n");
+        if (m_client->Connect()) {
+            break;
+        }
+        delay = std::min(delay * 2, 30000L);
+    }
+    m_reconnecting = false;
 }
 
 #ifdef __ANDROID__
@@ -9,6 +9,9 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
+#include <deque>
+#include <future>
 #include "MToolClient.h"
 
 #ifdef __ANDROID__
@@ -21,22 +24,30 @@
 #endif
 
 #include "json.hpp"
+#include "util/workerpool.h"
 extern int MtoolServerport;
 
-struct MTOOL_WsTask
-{
-    long taskid;
-    std::condition_variable cv;
-    std::mutex mux;
-    std::unique_lock<std::mutex> lck = std::unique_lock<std::mutex>(mux);
-    nlohmann::json ret;
-};
+class TrsDict;
+
+class MtoolRpc;
+
 class MtoolProc {
 public:
     MtoolProc();
     static MtoolProc* instance;
     static void staticCall();
 
+    // 可以安全执行 Ruby 代码的时机
+    enum PumpPoint {
+        PumpFrame,      // Graphics.update
+        PumpInput,      // Input.update
+        PumpLoadData,   // load_data
+        PumpGraphics,   // Graphics.freeze / transition 返回后
+        PumpTimer       // 定时器 (rb_postponed_job)
+    };
+    // 仅限 Ruby 线程调用. 初始化之前调用无效.
+    static void pump(PumpPoint point);
+
 #ifdef __ANDROID__
     // JNI 方法：通知 Java 层加载状态
     static void notifyLoadingStatus(int statusCode);
@@ -48,22 +59,58 @@ public:
 #endif
 
     bool trsLoaded;
+    bool trsAsync = false;
 
+    // timeoutMS: 0 不限时, 小于 0 不等待回复
     nlohmann::json doTask(std::string cmd, nlohmann::json args, long timeoutMS = 0);
+    // 不阻塞调用方; 多个请求可同时在途. id 非空时写入请求 id, 供 cancelTask 使用
+    std::future<nlohmann::json> doTaskAsync(const std::string &cmd, nlohmann::json args, long timeoutMS,
+                                            long *id = nullptr);
+    // 放弃在途请求, 其 future 抛出 Cancelled. 请求已结束时返回 false
+    bool cancelTask(long id);
+    bool isConnected() const;
 private:
     bool m_initialized = false;
     std::string m_host;
     int m_port;
-    MToolClient* m_client;
+    MToolClient* m_client = nullptr;
+    MtoolRpc* m_rpc = nullptr;
+    // 向服务端发送请求时使用 CBOR 打包消息
+    bool m_packed = false;
+    long m_reconnectMs = 0;
+    std::atomic<bool> m_reconnecting{false};
+    // 处理服务端下发的命令, 替代每条消息一个线程
+    WorkerPool<nlohmann::json>* m_taskPool = nullptr;
 
     void init();
-    void onEventLoop();
+    void onEventLoop(PumpPoint point);
+    void pumpTimerLoop();
+    long evalBudget(const nlohmann::json& data) const;
+
+    // 以下仅由 Ruby 线程访问
+    bool m_pumping = false;
+    std::deque<RGSSEvalStruct*> m_ready;
+
+    long m_evalBudgetMs = 100;
+    long m_pumpSliceMs = 4;
+    long m_pumpIntervalMs = 50;
+    std::atomic<long long> m_lastPump;
     void handleTextMessage(const std::string& message);
     void handleBinaryMessage(const std::vector<uint8_t>& data);
+    void handlePackedMessage(std::vector<uint8_t>& meta, std::string& payload);
+    void dispatchMessage(nlohmann::json j);
+    void installTrsDict(std::shared_ptr<TrsDict> dict);
     void handleError(const std::string& error);
     void handleConnected();
     void handleClosed();
+    // 已在重连时不重复启动
+    void startReconnect();
+    void reconnectLoop();
+    bool sendRequest(const nlohmann::json& request);
 
+    void runTask(nlohmann::json& j);
+    void sendTaskReturn(const nlohmann::json& id, const std::string& ret, bool packed = false);
+    std::string taskPoolStats();
     std::string processTask(nlohmann::json j);
 };
 extern MtoolProc *mtoolProc;
@@ -0,0 +1,295 @@
+//
+// Multiplexed request/response layer for the MTool link.
+//
+
+#include "MtoolRpc.h"
+
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+// 时间轮: 10ms 一格, 512 格一圈; 更长的超时记录剩余圈数
+static const std::chrono::milliseconds kTick(10);
+static const size_t kWheelSlots = 512;
+
+MtoolRpc::MtoolRpc(Sender sender)
+    : m_sender(std::move(sender)),
+      m_nextId(0),
+      m_connected(false),
+      m_running(true),
+      m_wheel(kWheelSlots),
+      m_cursor(0),
+      m_timerCount(0),
+      m_lastTick(std::chrono::steady_clock::now()),
+      m_stats() {
+    m_thread = std::thread(&MtoolRpc::timerLoop, this);
+}
+
+MtoolRpc::~MtoolRpc() {
+    std::vector<long> ids;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        for (auto &it : m_pending) {
+            ids.push_back(it.first);
+        }
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    for (long id : ids) {
+        finish(id, Cancelled);
+    }
+}
+
+json MtoolRpc::makeRequest(long id, const std::string &cmd, json &args) {
+    json request;
+    request["id"] = id;
+    request["cmd"] = cmd;
+    request["args"] = std::move(args);
+    return request;
+}
+
+long MtoolRpc::call(const std::string &cmd, json args, long timeoutMS,
+                    Callback callback, bool replay) {
+    long id = ++m_nextId;
+    json request = makeRequest(id, cmd, args);
+    bool connected;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        connected = m_connected;
+        if (!connected && !replay) {
+            m_stats.failed++;
+        } else {
+            Pending &p = m_pending[id];
+            // 只有可重放的请求需要保留原文
+            if (replay) {
+                p.request = request;
+            }
+            p.callback = std::move(callback);
+            p.replay = replay;
+            if (timeoutMS > 0) {
+                schedule(id, timeoutMS);
+            }
+        }
+    }
+
+    if (!connected) {
+        // 可重放的请求等待重连后发送
+        if (!replay) {
+            json empty;
+            callback(Disconnected, empty);
+        }
+        return id;
+    }
+
+    // 在锁外发送, 回复可能在 m_sender 返回之前到达
+    if (m_sender(request)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.sent++;
+    } else if (!replay) {
+        finish(id, Disconnected);
+    }
+    return id;
+}
+
+std::future<json> MtoolRpc::callFuture(const std::string &cmd, json args,
+                                       long timeoutMS, bool replay, long *id) {
+    std::shared_ptr<std::promise<json>> promise = std::make_shared<std::promise<json>>();
+    std::future<json> future = promise->get_future();
+    long requestId = call(cmd, std::move(args), timeoutMS, [promise](Status status, json &reply) {
+        if (status == Ok) {
+            promise->set_value(std::move(reply));
+        } else {
+            promise->set_exception(std::make_exception_ptr(Error(status)));
+        }
+    }, replay);
+    if (id) {
+        *id = requestId;
+    }
+    return future;
+}
+
+bool MtoolRpc::notify(const std::string &cmd, json args) {
+    json request = makeRequest(++m_nextId, cmd, args);
+    if (!m_sender(request)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.sent++;
+    return true;
+}
+
+bool MtoolRpc::cancel(long id) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.find(id) == m_pending.end()) {
+            return false;
+        }
+    }
+    finish(id, Cancelled);
+    return true;
+}
+
+bool MtoolRpc::complete(json &reply) {
+    if (!reply.contains("id") || !reply["id"].is_number_integer()) {
+        return false;
+    }
+    long id = reply["id"].get<long>();
+    Status status = reply.contains("err") ? Failed : Ok;
+    Callback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pending.find(id);
+        if (it == m_pending.end()) {
+            return false;
+        }
+        callback = std::move(it->second.callback);
+        m_pending.erase(it);
+        if (status == Ok) {
+            m_stats.completed++;
+        } else {
+            m_stats.failed++;
+        }
+    }
+    if (callback) {
+        callback(status, reply);
+    }
+    return true;
+}
+
+void MtoolRpc::setConnected(bool connected) {
+    std::vector<long> dropped;
+    std::vector<json> replay;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_connected == connected) {
+            return;
+        }
+        m_connected = connected;
+        for (auto &it : m_pending) {
+            if (!it.second.replay) {
+                dropped.push_back(it.first);
+            } else if (connected) {
+                replay.push_back(it.second.request);
+            }
+        }
+        m_stats.replayed += replay.size();
+    }
+
+    for (long id : dropped) {
+        finish(id, Disconnected);
+    }
+    // 服务端重复收到同一 id 时, 多余的回复会因查不到 id 被忽略
+    for (const json &request : replay) {
+        if (!m_sender(request)) {
+            break;
+        }
+    }
+}
+
+MtoolRpc::Stats MtoolRpc::stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats st = m_stats;
+    st.inFlight = m_pending.size();
+    return st;
+}
+
+const char *MtoolRpc::statusName(Status status) {
+    switch (status) {
+        case Ok: return "ok";
+        case Failed: return "failed";
+        case Timeout: return "timeout";
+        case Cancelled: return "cancelled";
+        case Disconnected: return "disconnected";
+    }
+    return "unknown";
+}
+
+void MtoolRpc::finish(long id, Status status) {
+    Callback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pending.find(id);
+        if (it == m_pending.end()) {
+            return;
+        }
+        callback = std::move(it->second.callback);
+        m_pending.erase(it);
+        switch (status) {
+            case Timeout: m_stats.timedOut++; break;
+            case Cancelled: m_stats.cancelled++; break;
+            default: m_stats.failed++; break;
+        }
+    }
+    if (callback) {
+        json empty;
+        callback(status, empty);
+    }
+}
+
+void MtoolRpc::schedule(long id, long timeoutMS) {
+    if (m_timerCount == 0) {
+        // 时间轮空闲期间不走动, 重新对齐起点
+        m_lastTick = std::chrono::steady_clock::now();
+    }
+    size_t ticks = (size_t) ((timeoutMS + kTick.count() - 1) / kTick.count());
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    Timer timer = { id, (ticks - 1) / kWheelSlots };
+    m_wheel[(m_cursor + ticks) % kWheelSlots].push_back(timer);
+    if (m_timerCount++ == 0) {
+        m_cv.notify_all();
+    }
+}
+
+void MtoolRpc::advanceLocked(std::vector<long> &expired) {
+    auto now = std::chrono::steady_clock::now();
+    while (m_timerCount > 0 && now - m_lastTick >= kTick) {
+        m_lastTick += kTick;
+        m_cursor = (m_cursor + 1) % kWheelSlots;
+
+        std::vector<Timer> &slot = m_wheel[m_cursor];
+        size_t keep = 0;
+        for (size_t i = 0; i < slot.size(); i++) {
+            if (slot[i].rounds > 0) {
+                slot[i].rounds--;
+                slot[keep++] = slot[i];
+                continue;
+            }
+            m_timerCount--;
+            if (m_pending.find(slot[i].id) != m_pending.end()) {
+                expired.push_back(slot[i].id);
+            }
+        }
+        slot.resize(keep);
+    }
+}
+
+void MtoolRpc::timerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        if (m_timerCount == 0) {
+            m_cv.wait(lock, [this]() {
+                return !m_running || m_timerCount > 0;
+            });
+            continue;
+        }
+
+        m_cv.wait_until(lock, m_lastTick + kTick);
+
+        std::vector<long> expired;
+        advanceLocked(expired);
+        if (expired.empty()) {
+            continue;
+        }
+
+        lock.unlock();
+        for (long id : expired) {
+            finish(id, Timeout);
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,129 @@
+//
+// Multiplexed request/response layer for the MTool link.
+//
+
+#ifndef MKXP_Z_MTOOLRPC_H
+#define MKXP_Z_MTOOLRPC_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <stdexcept>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 解决Ruby 1.9.3头文件与json.hpp的strtod冲突
+#ifdef strtod
+#undef strtod
+#endif
+
+#include "json.hpp"
+
+// 向服务端发出的请求表. 多个请求可以同时在途, 回复按 id 匹配.
+// 所有超时由一个时间轮线程驱动; 断线时可重放的请求保留在表中,
+// 重连后重新发送.
+class MtoolRpc {
+public:
+    enum Status {
+        Ok,
+        Failed,         // 服务端回复中带有 err
+        Timeout,
+        Cancelled,
+        Disconnected
+    };
+
+    // callFuture 的 future 在请求未成功时抛出
+    struct Error : std::runtime_error {
+        Status status;
+
+        explicit Error(Status status)
+            : std::runtime_error(statusName(status)), status(status) {}
+    };
+
+    // 在接收线程或时间轮线程中调用, 不应阻塞
+    using Callback = std::function<void(Status status, nlohmann::json &reply)>;
+    // 写出一条完整请求 {id, cmd, args}, 返回是否发送成功
+    using Sender = std::function<bool(const nlohmann::json &request)>;
+
+    struct Stats {
+        size_t inFlight;
+        uint64_t sent;
+        uint64_t completed;
+        uint64_t failed;
+        uint64_t timedOut;
+        uint64_t cancelled;
+        uint64_t replayed;
+    };
+
+    explicit MtoolRpc(Sender sender);
+    ~MtoolRpc();
+
+    // timeoutMS 为 0 时不设超时. 返回请求 id, 可用于 cancel().
+    // replay 为 false 的请求在断线时立即以 Disconnected 结束.
+    long call(const std::string &cmd, nlohmann::json args, long timeoutMS,
+              Callback callback, bool replay = true);
+
+    // 失败时 future 抛出 MtoolRpc::Error. id 非空时写入请求 id, 可用于 cancel().
+    std::future<nlohmann::json> callFuture(const std::string &cmd, nlohmann::json args,
+                                           long timeoutMS, bool replay = true,
+                                           long *id = nullptr);
+
+    // 不等待回复
+    bool notify(const std::string &cmd, nlohmann::json args);
+
+    // 请求以 Cancelled 结束. id 未知 (已结束) 时返回 false.
+    bool cancel(long id);
+
+    // 由接收线程调用. id 未知 (已超时或已取消) 时返回 false.
+    bool complete(nlohmann::json &reply);
+
+    void setConnected(bool connected);
+
+    Stats stats();
+
+    static const char *statusName(Status status);
+
+private:
+    struct Pending {
+        nlohmann::json request;
+        Callback callback;
+        bool replay;
+    };
+
+    // 时间轮中的条目; 请求提前结束时不删除, 到期时按 id 查表忽略
+    struct Timer {
+        long id;
+        size_t rounds;
+    };
+
+    void timerLoop();
+    void schedule(long id, long timeoutMS);
+    void advanceLocked(std::vector<long> &expired);
+    void finish(long id, Status status);
+    nlohmann::json makeRequest(long id, const std::string &cmd, nlohmann::json &args);
+
+    Sender m_sender;
+    std::atomic<long> m_nextId;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::unordered_map<long, Pending> m_pending;
+    bool m_connected;
+    bool m_running;
+
+    std::vector<std::vector<Timer>> m_wheel;
+    size_t m_cursor;
+    size_t m_timerCount;
+    std::chrono::steady_clock::time_point m_lastTick;
+
+    Stats m_stats;
+    std::thread m_thread;
+};
+
+#endif //MKXP_Z_MTOOLRPC_H
@@ -0,0 +1,352 @@
+//
+// Sampling profiler for the Ruby thread, by script section.
+//
+
+#include "RubyProfiler.h"
+#include "sharedstate.h"
+#include "config.h"
+
+#include <ruby.h>
+#ifndef MKXPZ_LEGACY_RUBY
+#include <ruby/debug.h>
+#endif
+
+#include <algorithm>
+
+RubyProfiler rubyProfiler;
+
+// 超出部分 (靠近根的一端) 被截断
+static const int maxDepth = 128;
+static const uint32_t truncatedFrame = 0xFFFFFFFF;
+// 采样被长时间推迟 (如切到后台) 时, 单次最多计入的采样间隔数
+static const long maxWeightIntervals = 100;
+
+#ifndef MKXPZ_LEGACY_RUBY
+// 保持已记录的帧对象存活, 以免地址被复用后名称错位
+static VALUE keepFrames = Qnil;
+#endif
+
+RubyProfiler::RubyProfiler()
+    : m_running(false),
+      m_intervalUs(1000),
+      m_samples(0),
+      m_sampledUs(0),
+      m_firstSample(true),
+      m_keepStale(false) {
+}
+
+RubyProfiler::~RubyProfiler() {
+    std::lock_guard<std::mutex> control(m_control);
+    stopTimer();
+}
+
+bool RubyProfiler::start(long intervalUs) {
+#ifdef MKXPZ_LEGACY_RUBY
+    // rb_profile_frames 需要 Ruby 2.1 以上
+    return false;
+#else
+    std::lock_guard<std::mutex> control(m_control);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+        return false;
+    }
+
+    m_frameIds.clear();
+    m_frames.clear();
+    m_sectionIds.clear();
+    m_sectionNames.clear();
+    m_selfUs.clear();
+    m_totalUs.clear();
+    m_stacks.clear();
+    m_samples = 0;
+    m_sampledUs = 0;
+    m_firstSample = true;
+    m_keepStale = true;
+
+    m_intervalUs = std::max(100L, intervalUs);
+    m_running = true;
+    m_thread = std::thread(&RubyProfiler::timerLoop, this);
+    return true;
+#endif
+}
+
+void RubyProfiler::stopTimer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool RubyProfiler::stop(const std::string &outBase, std::string &error) {
+    std::lock_guard<std::mutex> control(m_control);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            error = "not running";
+            return false;
+        }
+    }
+    stopTimer();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::string foldedPath = outBase + ".folded";
+    FILE *f = fopen(foldedPath.c_str(), "wb");
+    if (!f) {
+        error = "cannot write " + foldedPath;
+        return false;
+    }
+    writeFolded(f);
+    fclose(f);
+
+    std::string sectionsPath = outBase + ".sections.txt";
+    f = fopen(sectionsPath.c_str(), "wb");
+    if (!f) {
+        error = "cannot write " + sectionsPath;
+        return false;
+    }
+    writeSections(f);
+    fclose(f);
+
+    return true;
+}
+
+std::string RubyProfiler::defaultOutBase() {
+    const std::string &dataPath = shState->config().customDataPath;
+    return (dataPath.empty() ? std::string(".") : dataPath) + "/profile";
+}
+
+bool RubyProfiler::isRunning() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+RubyProfiler::Summary RubyProfiler::summary(size_t maxSections) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Summary s;
+    s.running = m_running;
+    s.samples = m_samples;
+    s.sampledMs = m_sampledUs / 1000.0;
+
+    std::vector<int> order(m_sectionNames.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = (int) i;
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return m_selfUs[a] > m_selfUs[b];
+    });
+    if (order.size() > maxSections) {
+        order.resize(maxSections);
+    }
+
+    for (int i : order) {
+        SectionTime t;
+        t.name = m_sectionNames[i];
+        t.selfMs = m_selfUs[i] / 1000.0;
+        t.totalMs = m_totalUs[i] / 1000.0;
+        s.sections.push_back(std::move(t));
+    }
+    return s;
+}
+
+void RubyProfiler::setScriptName(const std::string &file, const std::string &name) {
+    m_scriptNames[file] = name;
+}
+
+void RubyProfiler::timerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        m_cv.wait_for(lock, std::chrono::microseconds(m_intervalUs));
+        if (!m_running) {
+            break;
+        }
+        lock.unlock();
+#ifndef MKXPZ_LEGACY_RUBY
+        // 在 Ruby 线程下一次检查中断时执行 (持有 GVL);
+        // 尚未执行时重复登记只算一次
+        rb_postponed_job_register_one(0, sampleJob, this);
+#endif
+        lock.lock();
+    }
+}
+
+void RubyProfiler::sampleJob(void *data) {
+    static_cast<RubyProfiler *>(data)->sample();
+}
+
+int RubyProfiler::sectionId(const std::string &name) {
+    auto it = m_sectionIds.find(name);
+    if (it != m_sectionIds.end()) {
+        return it->second;
+    }
+    int id = (int) m_sectionNames.size();
+    m_sectionIds[name] = id;
+    m_sectionNames.push_back(name);
+    m_selfUs.push_back(0);
+    m_totalUs.push_back(0);
+    return id;
+}
+
+// 折叠栈以 ';' 分隔各帧, 以行分隔各栈
+static void sanitize(std::string &s) {
+    for (char &c : s) {
+        if (c == ';' || c == '\n') {
+            c = ',';
+        }
+    }
+}
+
+#ifndef MKXPZ_LEGACY_RUBY
+static std::string frameString(VALUE str) {
+    if (NIL_P(str)) {
+        return std::string();
+    }
+    return std::string(RSTRING_PTR(str), RSTRING_LEN(str));
+}
+#endif
+
+uint32_t RubyProfiler::frameId(uintptr_t frame) {
+    auto it = m_frameIds.find(frame);
+    if (it != m_frameIds.end()) {
+        return it->second;
+    }
+
+    Frame f;
+    f.section = -1;
+#ifndef MKXPZ_LEGACY_RUBY
+    VALUE value = (VALUE) frame;
+    rb_ary_push(keepFrames, value);
+
+    f.label = frameString(rb_profile_frame_full_label(value));
+    std::string path = frameString(rb_profile_frame_path(value));
+    // Integer#times 等用 Ruby 实现的内建方法同 C 函数一样处理
+    if (!path.empty() && path.compare(0, 10, "<internal:") != 0) {
+        auto name = m_scriptNames.find(path);
+        if (name != m_scriptNames.end()) {
+            path = name->second;
+        }
+        sanitize(path);
+        f.section = sectionId(path);
+        f.label += " [" + path + "]";
+    }
+#endif
+    sanitize(f.label);
+    if (f.label.empty()) {
+        f.label = "?";
+    }
+
+    uint32_t id = (uint32_t) m_frames.size();
+    m_frames.push_back(std::move(f));
+    m_frameIds[frame] = id;
+    return id;
+}
+
+void RubyProfiler::sample() {
+#ifndef MKXPZ_LEGACY_RUBY
+    VALUE frames[maxDepth];
+    int lines[maxDepth];
+    int n = rb_profile_frames(0, maxDepth, frames, lines);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_running) {
+        return;
+    }
+
+    if (NIL_P(keepFrames)) {
+        keepFrames = rb_ary_new();
+        rb_gc_register_address(&keepFrames);
+    } else if (m_keepStale) {
+        rb_ary_clear(keepFrames);
+    }
+    m_keepStale = false;
+
+    auto now = std::chrono::steady_clock::now();
+    uint64_t weight = (uint64_t) m_intervalUs;
+    if (!m_firstSample) {
+        long long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            now - m_lastSample).count();
+        weight = (uint64_t) std::max(0LL, std::min(elapsed, (long long) m_intervalUs * maxWeightIntervals));
+    }
+    m_lastSample = now;
+    m_firstSample = false;
+
+    // rb_profile_frames 由叶到根, 这里反过来
+    std::string key;
+    key.reserve((n + 1) * sizeof(uint32_t));
+    if (n == maxDepth) {
+        key.append((const char *) &truncatedFrame, sizeof(uint32_t));
+    }
+
+    int section = -1;
+    std::vector<int> seen;
+    for (int i = n - 1; i >= 0; --i) {
+        uint32_t id = frameId((uintptr_t) frames[i]);
+        key.append((const char *) &id, sizeof(uint32_t));
+
+        int frameSection = m_frames[id].section;
+        if (frameSection < 0) {
+            continue;
+        }
+        section = frameSection;
+        if (std::find(seen.begin(), seen.end(), section) == seen.end()) {
+            seen.push_back(section);
+            m_totalUs[section] += weight;
+        }
+    }
+
+    // 没有 Ruby 帧时 (例如只在 C 函数中)
+    if (section < 0) {
+        section = sectionId("(native)");
+        m_totalUs[section] += weight;
+    }
+    m_selfUs[section] += weight;
+
+    m_stacks[key] += weight;
+    m_samples++;
+    m_sampledUs += weight;
+#endif
+}
+
+void RubyProfiler::writeFolded(FILE *f) {
+    std::string line;
+    for (auto it = m_stacks.begin(); it != m_stacks.end(); ++it) {
+        line.clear();
+        const uint32_t *ids = (const uint32_t *) it->first.data();
+        size_t count = it->first.size() / sizeof(uint32_t);
+        for (size_t i = 0; i < count; ++i) {
+            if (i > 0) {
+                line += ';';
+            }
+            line += (ids[i] == truncatedFrame) ? "..." : m_frames[ids[i]].label;
+        }
+        fprintf(f, "%s %llu\n", line.c_str(), (unsigned long long) it->second);
+    }
+}
+
+void RubyProfiler::writeSections(FILE *f) {
+    std::vector<int> order(m_sectionNames.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = (int) i;
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return m_selfUs[a] > m_selfUs[b];
+    });
+
+    double totalMs = m_sampledUs / 1000.0;
+    fprintf(f, "# %llu samples, %.1f ms, interval %ld us\n",
+            (unsigned long long) m_samples, totalMs, m_intervalUs);
+    fprintf(f, "%10s %7s %10s %7s  %s\n", "self ms", "self%", "total ms", "total%", "script");
+
+    for (int i : order) {
+        double selfMs = m_selfUs[i] / 1000.0;
+        double sectionMs = m_totalUs[i] / 1000.0;
+        fprintf(f, "%10.1f %6.1f%% %10.1f %6.1f%%  %s\n",
+                selfMs, totalMs > 0 ? selfMs * 100 / totalMs : 0.0,
+                sectionMs, totalMs > 0 ? sectionMs * 100 / totalMs : 0.0,
+                m_sectionNames[i].c_str());
+    }
+}
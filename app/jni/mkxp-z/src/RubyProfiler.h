@@ -0,0 +1,101 @@
+//
+// Sampling profiler for the Ruby thread, by script section.
+//
+
+#ifndef MKXP_Z_RUBYPROFILER_H
+#define MKXP_Z_RUBYPROFILER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+// 定时采样 Ruby 线程的调用栈, 把 SectionXXX 之类的文件名换回脚本名,
+// 统计每个脚本的自身/累计耗时, 并可写出 flamegraph.pl 使用的折叠栈.
+// 采样在 Ruby 线程下一次检查中断时进行 (rb_postponed_job), 故计的是
+// 墙钟时间: 一次耗时的 C 调用会记在它返回后所处的脚本上.
+class RubyProfiler {
+public:
+    struct SectionTime {
+        std::string name;
+        double selfMs;
+        double totalMs;
+    };
+
+    struct Summary {
+        bool running;
+        uint64_t samples;
+        double sampledMs;
+        // 按自身耗时从高到低
+        std::vector<SectionTime> sections;
+    };
+
+    RubyProfiler();
+    ~RubyProfiler();
+
+    // 以下可在任意线程调用.
+    // 开始新一轮采样, 丢弃上一轮的结果. 不支持时返回 false.
+    bool start(long intervalUs);
+    // 停止采样, 写出 outBase + ".folded" (折叠栈, 权重单位微秒)
+    // 和 outBase + ".sections.txt" (按脚本统计).
+    bool stop(const std::string &outBase, std::string &error);
+    // 数据目录下的 "profile"
+    static std::string defaultOutBase();
+    bool isRunning();
+    Summary summary(size_t maxSections);
+
+    // 仅限 Ruby 线程: 登记脚本段在 Ruby 中可见的文件名
+    void setScriptName(const std::string &file, const std::string &name);
+
+private:
+    struct Frame {
+        std::string label;
+        // C 函数和内建方法没有所属脚本, 计入调用它的脚本
+        int section;
+    };
+
+    static void sampleJob(void *data);
+    void timerLoop();
+    void sample();
+    uint32_t frameId(uintptr_t frame);
+    int sectionId(const std::string &name);
+    void writeFolded(FILE *f);
+    void writeSections(FILE *f);
+    void stopTimer();
+
+    // 串行化 start / stop
+    std::mutex m_control;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_running;
+    long m_intervalUs;
+    std::thread m_thread;
+
+    // 以下受 m_mutex 保护, 仅在 Ruby 线程中增加
+    std::unordered_map<uintptr_t, uint32_t> m_frameIds;
+    std::vector<Frame> m_frames;
+    std::unordered_map<std::string, int> m_sectionIds;
+    std::vector<std::string> m_sectionNames;
+    std::vector<uint64_t> m_selfUs;
+    std::vector<uint64_t> m_totalUs;
+    // 键: 由根到叶的帧编号
+    std::unordered_map<std::string, uint64_t> m_stacks;
+    uint64_t m_samples;
+    uint64_t m_sampledUs;
+    std::chrono::steady_clock::time_point m_lastSample;
+    bool m_firstSample;
+    // 上一轮保留的帧对象已不再需要, 待 Ruby 线程释放
+    bool m_keepStale;
+
+    // 以下仅由 Ruby 线程访问
+    std::unordered_map<std::string, std::string> m_scriptNames;
+};
+
+extern RubyProfiler rubyProfiler;
+
+#endif //MKXP_Z_RUBYPROFILER_H
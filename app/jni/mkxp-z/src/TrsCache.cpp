@@ -0,0 +1,119 @@
+//
+// Translation cache used by fixString.
+//
+
+#include "TrsCache.h"
+
+TrsCache::TrsCache(size_t capacity)
+    : m_capacity(capacity ? capacity : 1),
+      m_hits(0), m_reverseHits(0), m_misses(0), m_evictions(0) {
+}
+
+bool TrsCache::lookup(const std::string &key, std::string &out) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        // 移到表头, O(1)
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        out = it->second->dst;
+        m_hits++;
+        return true;
+    }
+
+    if (m_reverse.count(key) != 0) {
+        out = key;
+        m_reverseHits++;
+        return true;
+    }
+
+    m_misses++;
+    return false;
+}
+
+void TrsCache::insert(const std::string &src, const std::string &dst) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_index.find(src);
+    if (it != m_index.end()) {
+        Entry &e = *it->second;
+        if (e.dst != dst) {
+            reverseRemoveLocked(e.dst);
+            e.dst = dst;
+            reverseAddLocked(dst);
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return;
+    }
+
+    while (m_index.size() >= m_capacity)
+        evictLocked();
+
+    m_lru.push_front(Entry{src, dst});
+    m_index.emplace(src, m_lru.begin());
+    reverseAddLocked(dst);
+}
+
+void TrsCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_index.clear();
+    m_reverse.clear();
+    m_lru.clear();
+}
+
+void TrsCache::setCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_capacity = capacity ? capacity : 1;
+    while (m_index.size() > m_capacity)
+        evictLocked();
+}
+
+size_t TrsCache::capacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+}
+
+TrsCache::Stats TrsCache::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Stats s;
+    s.hits = m_hits;
+    s.reverseHits = m_reverseHits;
+    s.misses = m_misses;
+    s.evictions = m_evictions;
+    s.size = m_index.size();
+    s.capacity = m_capacity;
+    return s;
+}
+
+void TrsCache::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_hits = m_reverseHits = m_misses = m_evictions = 0;
+}
+
+void TrsCache::evictLocked() {
+    if (m_lru.empty())
+        return;
+
+    Entry &victim = m_lru.back();
+    reverseRemoveLocked(victim.dst);
+    m_index.erase(victim.src);
+    m_lru.pop_back();
+    m_evictions++;
+}
+
+void TrsCache::reverseAddLocked(const std::string &dst) {
+    m_reverse[dst]++;
+}
+
+void TrsCache::reverseRemoveLocked(const std::string &dst) {
+    auto it = m_reverse.find(dst);
+    if (it == m_reverse.end())
+        return;
+
+    if (--it->second == 0)
+        m_reverse.erase(it);
+}
@@ -0,0 +1,69 @@
+//
+// Translation cache used by fixString.
+//
+
+#ifndef MKXP_Z_TRSCACHE_H
+#define MKXP_Z_TRSCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+// 翻译缓存: 原文 -> 译文, 哈希索引 + O(1) LRU 淘汰.
+// 同时维护译文的反向集合, 用于识别"已经翻译过"的字符串.
+class TrsCache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t reverseHits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t size;
+        size_t capacity;
+    };
+
+    explicit TrsCache(size_t capacity = 1000);
+
+    // 命中时将译文写入 out 并返回 true.
+    // 若 key 本身就是缓存中的某条译文, 则原样写入 out 并返回 true.
+    bool lookup(const std::string &key, std::string &out);
+
+    void insert(const std::string &src, const std::string &dst);
+
+    void clear();
+
+    void setCapacity(size_t capacity);
+    size_t capacity() const;
+
+    Stats stats() const;
+    void resetStats();
+
+private:
+    struct Entry {
+        std::string src;
+        std::string dst;
+    };
+    typedef std::list<Entry> LRUList;
+
+    void evictLocked();
+    void reverseAddLocked(const std::string &dst);
+    void reverseRemoveLocked(const std::string &dst);
+
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+
+    // 表头为最近使用
+    LRUList m_lru;
+    std::unordered_map<std::string, LRUList::iterator> m_index;
+    // 译文 -> 引用计数 (多个原文可能翻译成同一译文)
+    std::unordered_map<std::string, uint32_t> m_reverse;
+
+    uint64_t m_hits;
+    uint64_t m_reverseHits;
+    uint64_t m_misses;
+    uint64_t m_evictions;
+};
+
+#endif //MKXP_Z_TRSCACHE_H
@@ -0,0 +1,307 @@
+//
+// Memory-mapped translation dictionary.
+//
+
+#include "TrsDict.h"
+
+#include <cstring>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char DICT_MAGIC[4] = { 'M', 'T', 'D', 'C' };
+const uint32_t DICT_VERSION = 1;
+
+struct DictHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t bucketCount;
+    uint32_t entriesOff;
+    uint32_t srcBucketsOff;
+    uint32_t dstBucketsOff;
+    uint32_t stringsOff;
+    uint32_t stringsSize;
+    uint32_t reserved;
+};
+
+struct DictEntry {
+    uint32_t hash;
+    uint32_t srcOff;
+    uint32_t srcLen;
+    uint32_t dstOff;
+    uint32_t dstLen;
+};
+
+static_assert(sizeof(DictHeader) == 40, "DictHeader must be packed");
+static_assert(sizeof(DictEntry) == 20, "DictEntry must be packed");
+
+inline uint32_t fnv1a(const char *str, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t) str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+inline DictEntry readEntry(const uint8_t *p) {
+    DictEntry e;
+    memcpy(&e, p, sizeof(e));
+    return e;
+}
+
+}
+
+TrsDict::TrsDict()
+    : m_base(nullptr), m_size(0), m_mapping(nullptr),
+      m_count(0), m_bucketMask(0),
+      m_entries(nullptr), m_srcBuckets(nullptr), m_dstBuckets(nullptr),
+      m_strings(nullptr), m_stringsSize(0) {
+}
+
+TrsDict::~TrsDict() {
+#ifndef _WIN32
+    if (m_mapping) {
+        munmap(m_mapping, m_size);
+    }
+#endif
+}
+
+std::shared_ptr<TrsDict> TrsDict::openFile(const std::string &path, std::string &error) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(DictHeader)) {
+        close(fd);
+        error = "invalid dictionary size";
+        return nullptr;
+    }
+    void *map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        error = "mmap failed";
+        return nullptr;
+    }
+    madvise(map, (size_t) st.st_size, MADV_WILLNEED);
+
+    std::shared_ptr<TrsDict> dict(new TrsDict());
+    dict->m_mapping = map;
+    dict->m_base = (const uint8_t *) map;
+    dict->m_size = (size_t) st.st_size;
+    if (!dict->validate(error)) {
+        return nullptr;
+    }
+    return dict;
+#else
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return fromBuffer(std::move(data), error);
+#endif
+}
+
+std::shared_ptr<TrsDict> TrsDict::fromBuffer(std::vector<uint8_t> &&data, std::string &error) {
+    std::shared_ptr<TrsDict> dict(new TrsDict());
+    dict->m_owned = std::move(data);
+    dict->m_base = dict->m_owned.data();
+    dict->m_size = dict->m_owned.size();
+    if (!dict->validate(error)) {
+        return nullptr;
+    }
+    return dict;
+}
+
+bool TrsDict::isDictData(const void *data, size_t size) {
+    return size >= sizeof(DictHeader) && memcmp(data, DICT_MAGIC, 4) == 0;
+}
+
+bool TrsDict::validate(std::string &error) {
+    if (!isDictData(m_base, m_size)) {
+        error = "bad magic";
+        return false;
+    }
+
+    DictHeader hdr;
+    memcpy(&hdr, m_base, sizeof(hdr));
+    if (hdr.version != DICT_VERSION) {
+        error = "unsupported version";
+        return false;
+    }
+    if (hdr.bucketCount == 0 || (hdr.bucketCount & (hdr.bucketCount - 1)) != 0 ||
+        hdr.bucketCount < hdr.count) {
+        error = "bad bucket count";
+        return false;
+    }
+
+    uint64_t entriesEnd = (uint64_t) hdr.entriesOff + (uint64_t) hdr.count * sizeof(DictEntry);
+    uint64_t bucketBytes = (uint64_t) hdr.bucketCount * sizeof(uint32_t);
+    uint64_t stringsEnd = (uint64_t) hdr.stringsOff + hdr.stringsSize;
+    if (entriesEnd > m_size ||
+        (hdr.srcBucketsOff & 3) != 0 || hdr.srcBucketsOff + bucketBytes > m_size ||
+        (hdr.dstBucketsOff & 3) != 0 || hdr.dstBucketsOff + bucketBytes > m_size ||
+        stringsEnd > m_size) {
+        error = "truncated dictionary";
+        return false;
+    }
+
+    m_count = hdr.count;
+    m_bucketMask = hdr.bucketCount - 1;
+    m_entries = m_base + hdr.entriesOff;
+    m_srcBuckets = (const uint32_t *) (m_base + hdr.srcBucketsOff);
+    m_dstBuckets = (const uint32_t *) (m_base + hdr.dstBucketsOff);
+    m_strings = (const char *) (m_base + hdr.stringsOff);
+    m_stringsSize = hdr.stringsSize;
+
+    // 只检查字符串范围, 避免查询时越界
+    for (uint32_t i = 0; i < m_count; i++) {
+        DictEntry e = readEntry(m_entries + i * sizeof(DictEntry));
+        if ((uint64_t) e.srcOff + e.srcLen > m_stringsSize ||
+            (uint64_t) e.dstOff + e.dstLen > m_stringsSize) {
+            error = "bad string offset";
+            return false;
+        }
+    }
+    return true;
+}
+
+const uint8_t *TrsDict::findEntry(const uint32_t *buckets, bool matchDst,
+                                  const char *str, size_t len) const {
+    if (m_count == 0) {
+        return nullptr;
+    }
+
+    uint32_t h = fnv1a(str, len);
+    for (uint32_t probe = 0, slot = h & m_bucketMask; probe <= m_bucketMask;
+         probe++, slot = (slot + 1) & m_bucketMask) {
+        uint32_t idx = buckets[slot];
+        if (idx == 0 || idx > m_count) {
+            return nullptr;
+        }
+        const uint8_t *p = m_entries + (idx - 1) * sizeof(DictEntry);
+        DictEntry e = readEntry(p);
+        uint32_t off = matchDst ? e.dstOff : e.srcOff;
+        uint32_t elen = matchDst ? e.dstLen : e.srcLen;
+        if (elen == len && memcmp(m_strings + off, str, len) == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+bool TrsDict::lookup(const char *src, size_t len, const char *&out, size_t &outLen) const {
+    const uint8_t *p = findEntry(m_srcBuckets, false, src, len);
+    if (!p) {
+        return false;
+    }
+    DictEntry e = readEntry(p);
+    out = m_strings + e.dstOff;
+    outLen = e.dstLen;
+    return true;
+}
+
+bool TrsDict::isTranslation(const char *str, size_t len) const {
+    return findEntry(m_dstBuckets, true, str, len) != nullptr;
+}
+
+uint32_t TrsDict::size() const {
+    return m_count;
+}
+
+size_t TrsDict::byteSize() const {
+    return m_size;
+}
+
+void TrsDict::build(const Pairs &pairs, std::vector<uint8_t> &out) {
+    uint32_t count = (uint32_t) pairs.size();
+    uint32_t bucketCount = 16;
+    while (bucketCount < count * 2) {
+        bucketCount <<= 1;
+    }
+
+    std::vector<DictEntry> entries(count);
+    std::vector<uint32_t> srcBuckets(bucketCount, 0);
+    std::vector<uint32_t> dstBuckets(bucketCount, 0);
+    std::string strings;
+
+    uint32_t mask = bucketCount - 1;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const std::string &src = pairs[i].first;
+        const std::string &dst = pairs[i].second;
+
+        DictEntry &e = entries[used];
+        e.hash = fnv1a(src.data(), src.size());
+
+        // 重复的原文只保留第一条
+        uint32_t slot = e.hash & mask;
+        bool dup = false;
+        while (srcBuckets[slot] != 0) {
+            const DictEntry &o = entries[srcBuckets[slot] - 1];
+            if (o.srcLen == src.size() &&
+                strings.compare(o.srcOff, o.srcLen, src) == 0) {
+                dup = true;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (dup) {
+            continue;
+        }
+
+        e.srcOff = (uint32_t) strings.size();
+        e.srcLen = (uint32_t) src.size();
+        strings += src;
+        e.dstOff = (uint32_t) strings.size();
+        e.dstLen = (uint32_t) dst.size();
+        strings += dst;
+        srcBuckets[slot] = ++used;
+
+        uint32_t dslot = fnv1a(dst.data(), dst.size()) & mask;
+        while (dstBuckets[dslot] != 0) {
+            dslot = (dslot + 1) & mask;
+        }
+        dstBuckets[dslot] = used;
+    }
+    entries.resize(used);
+
+    DictHeader hdr;
+    memcpy(hdr.magic, DICT_MAGIC, 4);
+    hdr.version = DICT_VERSION;
+    hdr.count = used;
+    hdr.bucketCount = bucketCount;
+    hdr.entriesOff = sizeof(DictHeader);
+    hdr.srcBucketsOff = hdr.entriesOff + used * (uint32_t) sizeof(DictEntry);
+    hdr.dstBucketsOff = hdr.srcBucketsOff + bucketCount * (uint32_t) sizeof(uint32_t);
+    hdr.stringsOff = hdr.dstBucketsOff + bucketCount * (uint32_t) sizeof(uint32_t);
+    hdr.stringsSize = (uint32_t) strings.size();
+    hdr.reserved = 0;
+
+    out.resize(hdr.stringsOff + strings.size());
+    uint8_t *p = out.data();
+    memcpy(p, &hdr, sizeof(hdr));
+    memcpy(p + hdr.entriesOff, entries.data(), used * sizeof(DictEntry));
+    memcpy(p + hdr.srcBucketsOff, srcBuckets.data(), bucketCount * sizeof(uint32_t));
+    memcpy(p + hdr.dstBucketsOff, dstBuckets.data(), bucketCount * sizeof(uint32_t));
+    memcpy(p + hdr.stringsOff, strings.data(), strings.size());
+}
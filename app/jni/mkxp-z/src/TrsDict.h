@@ -0,0 +1,71 @@
+//
+// Memory-mapped translation dictionary.
+//
+
+#ifndef MKXP_Z_TRSDICT_H
+#define MKXP_Z_TRSDICT_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// 只读翻译词典, 可直接 mmap 磁盘文件, 查询时零分配.
+//
+// 文件格式 (小端序):
+//   Header       magic "MTDC", version, 条目数, 桶数 (2 的幂),
+//                entries / srcBuckets / dstBuckets / strings 的偏移
+//   Entry[n]     { hash, srcOff, srcLen, dstOff, dstLen }
+//   u32[b]       原文哈希表, 线性探测, 存 entry 下标 + 1 (0 为空)
+//   u32[b]       译文哈希表 (反查 "已翻译"), 格式同上
+//   char[]       字符串池, 偏移相对于 strings 段起始
+//
+// 哈希为 32 位 FNV-1a.
+class TrsDict {
+public:
+    typedef std::vector<std::pair<std::string, std::string>> Pairs;
+
+    ~TrsDict();
+
+    // 出错时返回 nullptr 并写入 error
+    static std::shared_ptr<TrsDict> openFile(const std::string &path, std::string &error);
+    static std::shared_ptr<TrsDict> fromBuffer(std::vector<uint8_t> &&data, std::string &error);
+
+    // 序列化为上述格式
+    static void build(const Pairs &pairs, std::vector<uint8_t> &out);
+
+    static bool isDictData(const void *data, size_t size);
+
+    // 命中时 out 指向词典内部内存, 在词典对象存活期间有效
+    bool lookup(const char *src, size_t len, const char *&out, size_t &outLen) const;
+    bool isTranslation(const char *str, size_t len) const;
+
+    uint32_t size() const;
+    size_t byteSize() const;
+
+private:
+    TrsDict();
+
+    bool validate(std::string &error);
+    const uint8_t *findEntry(const uint32_t *buckets, bool matchDst,
+                             const char *str, size_t len) const;
+
+    const uint8_t *m_base;
+    size_t m_size;
+
+    // mmap 映射, 或由 m_owned 持有
+    void *m_mapping;
+    std::vector<uint8_t> m_owned;
+
+    uint32_t m_count;
+    uint32_t m_bucketMask;
+    const uint8_t *m_entries;
+    const uint32_t *m_srcBuckets;
+    const uint32_t *m_dstBuckets;
+    const char *m_strings;
+    size_t m_stringsSize;
+};
+
+#endif //MKXP_Z_TRSDICT_H
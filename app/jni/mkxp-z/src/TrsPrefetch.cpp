@@ -0,0 +1,301 @@
+//
+// Batched / prefetched translation requests for fixString.
+//
+
+#include "TrsPrefetch.h"
+#include "TrsCache.h"
+#include "MtoolProc.h"
+#include "MtoolRpc.h"
+
+using json = nlohmann::json;
+
+TrsPrefetcher::TrsPrefetcher(TrsCache &cache)
+    : m_cache(cache),
+      m_flushRequested(false),
+      m_running(false),
+      m_maxBatch(64),
+      m_generation(0),
+      m_batchUnsupported(false) {
+}
+
+TrsPrefetcher::~TrsPrefetcher() {
+    stop();
+}
+
+void TrsPrefetcher::start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    m_thread = std::thread(&TrsPrefetcher::workerLoop, this);
+}
+
+void TrsPrefetcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void TrsPrefetcher::setMaxBatch(size_t maxBatch) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxBatch = maxBatch ? maxBatch : 1;
+}
+
+void TrsPrefetcher::enqueue(const std::string &src) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_known.insert(src).second) {
+            return;
+        }
+        m_pending.push_back(src);
+        // 队列已满一批时不必等到帧末
+        wake = m_pending.size() >= m_maxBatch;
+        if (wake) {
+            m_flushRequested = true;
+        }
+    }
+    if (wake) {
+        m_cv.notify_one();
+    }
+}
+
+void TrsPrefetcher::flush() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pending.empty()) {
+            return;
+        }
+        m_flushRequested = true;
+    }
+    m_cv.notify_one();
+}
+
+bool TrsPrefetcher::translateNow(const std::string &src, std::string &dst, long timeoutMS) {
+    std::vector<std::string> srcs;
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        generation = m_generation;
+        srcs = takeBatchLocked();
+        m_known.insert(src);
+    }
+    srcs.insert(srcs.begin(), src);
+
+    std::vector<std::string> dsts;
+    bool ok = request(srcs, dsts, timeoutMS);
+    if (ok) {
+        commit(srcs, dsts, generation);
+        dst = dsts[0];
+    } else {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const std::string &s : srcs) {
+            m_known.erase(s);
+        }
+    }
+    return ok;
+}
+
+void TrsPrefetcher::clear() {
+    std::vector<long> ids;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.clear();
+        m_known.clear();
+        m_flushRequested = false;
+        m_generation++;
+        ids.assign(m_inFlight.begin(), m_inFlight.end());
+    }
+    // 结果反正会被丢弃, 不必再等回复
+    cancelRequests(ids);
+}
+
+void TrsPrefetcher::cancelRequests(const std::vector<long> &ids) {
+    MtoolProc *proc = MtoolProc::instance;
+    if (proc == nullptr) {
+        return;
+    }
+    for (long id : ids) {
+        proc->cancelTask(id);
+    }
+}
+
+size_t TrsPrefetcher::pendingCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size();
+}
+
+std::vector<std::string> TrsPrefetcher::takeBatchLocked() {
+    std::vector<std::string> batch;
+    if (m_pending.size() <= m_maxBatch) {
+        batch.swap(m_pending);
+    } else {
+        batch.assign(m_pending.begin(), m_pending.begin() + m_maxBatch);
+        m_pending.erase(m_pending.begin(), m_pending.begin() + m_maxBatch);
+    }
+    m_flushRequested = !m_pending.empty();
+    return batch;
+}
+
+void TrsPrefetcher::commit(const std::vector<std::string> &srcs,
+                           const std::vector<std::string> &dsts,
+                           unsigned int generation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // clear() 之后返回的结果已过期
+    if (generation == m_generation) {
+        for (size_t i = 0; i < srcs.size(); i++) {
+            m_cache.insert(srcs[i], dsts[i]);
+        }
+    }
+    for (const std::string &s : srcs) {
+        m_known.erase(s);
+    }
+}
+
+bool TrsPrefetcher::request(const std::vector<std::string> &srcs,
+                            std::vector<std::string> &dsts,
+                            long timeoutMS) {
+    MtoolProc *proc = MtoolProc::instance;
+    if (proc == nullptr || srcs.empty()) {
+        return false;
+    }
+
+    if (srcs.size() > 1 && !m_batchUnsupported) {
+        try {
+            json::array_t args;
+            args.push_back(srcs);
+            long id;
+            std::future<json> reply = proc->doTaskAsync("trsBatch", args, timeoutMS, &id);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_inFlight.insert(id);
+            }
+            json ret;
+            try {
+                ret = reply.get();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_inFlight.erase(id);
+                throw;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_inFlight.erase(id);
+            }
+            json list = ret["ret"];
+            if (list.is_string()) {
+                list = json::parse(list.get<std::string>());
+            }
+            if (list.is_array() && list.size() == srcs.size()) {
+                dsts.clear();
+                dsts.reserve(srcs.size());
+                for (size_t i = 0; i < list.size(); i++) {
+                    dsts.push_back(list[i].is_string() ? list[i].get<std::string>() : srcs[i]);
+                }
+                return true;
+            }
+            m_batchUnsupported = true;
+        }
+        catch (MtoolRpc::Error &e) {
+            // 旧版本服务端会对未知命令返回 err;
+            // 超时, 被 clear() 取消等其它情况只放弃这一次
+            if (e.status != MtoolRpc::Failed) {
+                return false;
+            }
+            m_batchUnsupported = true;
+        }
+        catch (std::exception &e) {
+            // 未连接
+            return false;
+        }
+    }
+
+    // 逐条请求同时发出, 再依次等待回复
+    dsts.clear();
+    dsts.reserve(srcs.size());
+    std::vector<std::future<json>> replies;
+    std::vector<long> ids;
+    replies.reserve(srcs.size());
+    ids.reserve(srcs.size());
+    bool ok = true;
+    try {
+        for (const std::string &s : srcs) {
+            json::array_t args;
+            args.push_back(s);
+            long id;
+            replies.push_back(proc->doTaskAsync("trs", args, timeoutMS, &id));
+            ids.push_back(id);
+        }
+    }
+    catch (std::exception &e) {
+        // 发送途中断线
+        ok = false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inFlight.insert(ids.begin(), ids.end());
+    }
+    if (ok) {
+        try {
+            for (std::future<json> &reply : replies) {
+                json ret = reply.get();
+                dsts.push_back(ret["ret"].get<std::string>());
+            }
+        }
+        catch (std::exception &e) {
+            ok = false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (long id : ids) {
+            m_inFlight.erase(id);
+        }
+    }
+    // 这一批已作废, 其余回复不再需要
+    if (!ok) {
+        cancelRequests(ids);
+    }
+    return ok;
+}
+
+void TrsPrefetcher::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this]() {
+            return !m_running || m_flushRequested;
+        });
+        if (!m_running) {
+            break;
+        }
+
+        unsigned int generation = m_generation;
+        std::vector<std::string> batch = takeBatchLocked();
+        if (batch.empty()) {
+            continue;
+        }
+
+        lock.unlock();
+        std::vector<std::string> dsts;
+        bool ok = request(batch, dsts, 3000);
+        if (ok) {
+            commit(batch, dsts, generation);
+        } else {
+            std::lock_guard<std::mutex> g(m_mutex);
+            for (const std::string &s : batch) {
+                m_known.erase(s);
+            }
+        }
+        lock.lock();
+    }
+}
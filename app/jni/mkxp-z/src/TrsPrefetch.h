@@ -0,0 +1,77 @@
+//
+// Batched / prefetched translation requests for fixString.
+//
+
+#ifndef MKXP_Z_TRSPREFETCH_H
+#define MKXP_Z_TRSPREFETCH_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+class TrsCache;
+
+// 把一帧内出现的未命中字符串合并成一条 "trsBatch" 请求.
+// 后台线程负责发送并回填 TrsCache, 使 fixString 不必逐条阻塞等待.
+class TrsPrefetcher {
+public:
+    TrsPrefetcher(TrsCache &cache);
+    ~TrsPrefetcher();
+
+    void start();
+    void stop();
+
+    void setMaxBatch(size_t maxBatch);
+
+    // 加入待翻译队列 (去重), 不阻塞.
+    void enqueue(const std::string &src);
+
+    // 每帧调用一次: 将本帧积累的请求合并发送.
+    void flush();
+
+    // 同步翻译: 连同队列中尚未发送的字符串一起合并为一次请求.
+    // 成功时写入 dst 并返回 true.
+    bool translateNow(const std::string &src, std::string &dst, long timeoutMS);
+
+    // 丢弃待发送队列, 并使进行中的请求结果失效.
+    void clear();
+
+    size_t pendingCount();
+
+private:
+    void workerLoop();
+    std::vector<std::string> takeBatchLocked();
+    void commit(const std::vector<std::string> &srcs,
+                const std::vector<std::string> &dsts,
+                unsigned int generation);
+
+    // 发送一批请求. 服务端不支持批量命令时退化为逐条 "trs".
+    bool request(const std::vector<std::string> &srcs,
+                 std::vector<std::string> &dsts,
+                 long timeoutMS);
+    // 放弃 ids 中尚未结束的请求
+    void cancelRequests(const std::vector<long> &ids);
+
+    TrsCache &m_cache;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<std::string> m_pending;
+    // 已排队或正在请求中的字符串
+    std::unordered_set<std::string> m_known;
+    bool m_flushRequested;
+    bool m_running;
+    size_t m_maxBatch;
+    unsigned int m_generation;
+    // 在途请求的 id, clear() 时一并取消
+    std::unordered_set<long> m_inFlight;
+
+    std::atomic<bool> m_batchUnsupported;
+    std::thread m_thread;
+};
+
+#endif //MKXP_Z_TRSPREFETCH_H
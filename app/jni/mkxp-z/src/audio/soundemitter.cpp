@@ -23,6 +23,7 @@
 
 #include "sharedstate.h"
 #include "filesystem.h"
+#include "assetprefetch.h"
 #include "exception.h"
 #include "src/config.h"
 #include "src/util/util.h"
@@ -239,9 +240,25 @@ SoundBuffer *SoundEmitter::allocateBuffer(const std::string &filename)
 	else
 	{
 		/* Buffer not in cache, needs to be loaded */
-		SoundOpenHandler handler;
-		shState->fileSystem().openRead(handler, filename.c_str());
-		buffer = handler.buffer;
+		AssetPrefetch::Sound staged;
+
+		if (shState->assetPrefetch().takeSound(filename.c_str(), staged))
+		{
+			/* Decoded ahead of time, only the upload is left */
+			buffer = new SoundBuffer;
+			buffer->bytes = staged.pcm.size();
+
+			ALenum alFormat = chooseALFormat(staged.sampleSize, staged.channels);
+
+			AL::Buffer::uploadData(buffer->alBuffer, alFormat, staged.pcm.data(),
+			                       buffer->bytes, staged.rate);
+		}
+		else
+		{
+			SoundOpenHandler handler;
+			shState->fileSystem().openRead(handler, filename.c_str());
+			buffer = handler.buffer;
+		}
 
 		if (!buffer)
 		{
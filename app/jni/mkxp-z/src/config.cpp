@@ -140,6 +140,9 @@ void Config::read(int argc, char *argv[]) {
         {"bitmapSmoothScalingDown", 0},
         {"smoothScalingMipmaps", false},
         {"bicubicSharpness", 100},
+        {"spriteBatching", true},
+        {"textAtlas", true},
+        {"texturePoolSize", 20},
 #ifdef MKXPZ_SSL
         {"xbrzScalingFactor", 1.},
 #endif
@@ -154,6 +157,8 @@ void Config::read(int argc, char *argv[]) {
         {"fixedFramerate", 0},
         {"frameSkip", false},
         {"syncToRefreshrate", false},
+        {"reuseIdleFrames", true},
+        {"skipIdlePresent", false},
         {"solidFonts", json::array({})},
 #if defined(__APPLE__) && defined(__aarch64__)
         {"preferMetalRenderer", true},
@@ -185,6 +190,12 @@ void Config::read(int argc, char *argv[]) {
         {"BGMTrackCount", 1},
         {"customScript", ""},
         {"pathCache", true},
+        {"pathCacheFile", true},
+        {"scriptCache", true},
+        {"bytecodeCache", true},
+        {"dataCacheSize", 16},
+        {"dataCacheParsed", false},
+        {"prefetchCacheSize", 32},
         {"useScriptNames", true},
         {"preloadScript", json::array({})},
         {"postloadScript", json::array({})},
@@ -198,6 +209,16 @@ void Config::read(int argc, char *argv[]) {
         {"JITMinCalls", 10000},
         {"YJITEnable", false},
         {"dumpAtlas", false},
+        {"mtoolTrsCacheSize", 1000},
+        {"mtoolTrsAsync", false},
+        {"mtoolTrsBatchSize", 64},
+        {"mtoolWorkerThreads", 4},
+        {"mtoolTaskQueueSize", 256},
+        {"mtoolEvalBudgetMs", 100},
+        {"mtoolPumpSliceMs", 4},
+        {"mtoolPumpIntervalMs", 50},
+        {"mtoolPackedMessages", false},
+        {"mtoolReconnectMs", 1000},
         {"bindingNames", json::object({
             {"a", "A"},
             {"b", "B"},
@@ -245,6 +266,12 @@ try { exp } catch (...) {}
     SET_STRINGOPT(execName, execName);
     SET_OPT(allowSymlinks, boolean);
     SET_OPT(pathCache, boolean);
+    SET_OPT(pathCacheFile, boolean);
+    SET_OPT(scriptCache, boolean);
+    SET_OPT(bytecodeCache, boolean);
+    SET_OPT(dataCacheSize, integer);
+    SET_OPT(dataCacheParsed, boolean);
+    SET_OPT(prefetchCacheSize, integer);
     SET_OPT_CUSTOMKEY(jit.enabled, JITEnable, boolean);
     SET_OPT_CUSTOMKEY(jit.verboseLevel, JITVerboseLevel, integer);
     SET_OPT_CUSTOMKEY(jit.maxCache, JITMaxCache, integer);
@@ -287,6 +314,9 @@ try { exp } catch (...) {}
     SET_OPT(bitmapSmoothScalingDown, integer);
     SET_OPT(smoothScalingMipmaps, boolean);
     SET_OPT(bicubicSharpness, integer);
+    SET_OPT(spriteBatching, boolean);
+    SET_OPT(textAtlas, boolean);
+    SET_OPT(texturePoolSize, integer);
 #ifdef MKXPZ_SSL
     SET_OPT(xbrzScalingFactor, integer);
 #endif
@@ -300,6 +330,8 @@ try { exp } catch (...) {}
     SET_OPT(fixedFramerate, integer);
     SET_OPT(frameSkip, boolean);
     SET_OPT(syncToRefreshrate, boolean);
+    SET_OPT(reuseIdleFrames, boolean);
+    SET_OPT(skipIdlePresent, boolean);
     fillStringVec(opts["solidFonts"], solidFonts);
     for (std::string & solidFont : solidFonts)
         std::transform(solidFont.begin(), solidFont.end(), solidFont.begin(),
@@ -323,6 +355,16 @@ try { exp } catch (...) {}
     SET_STRINGOPT(customScript, customScript);
     SET_OPT(useScriptNames, boolean);
     SET_OPT(dumpAtlas, boolean);
+    SET_OPT_CUSTOMKEY(mtool.trsCacheSize, mtoolTrsCacheSize, integer);
+    SET_OPT_CUSTOMKEY(mtool.trsAsync, mtoolTrsAsync, boolean);
+    SET_OPT_CUSTOMKEY(mtool.trsBatchSize, mtoolTrsBatchSize, integer);
+    SET_OPT_CUSTOMKEY(mtool.workerThreads, mtoolWorkerThreads, integer);
+    SET_OPT_CUSTOMKEY(mtool.taskQueueSize, mtoolTaskQueueSize, integer);
+    SET_OPT_CUSTOMKEY(mtool.evalBudgetMs, mtoolEvalBudgetMs, integer);
+    SET_OPT_CUSTOMKEY(mtool.pumpSliceMs, mtoolPumpSliceMs, integer);
+    SET_OPT_CUSTOMKEY(mtool.pumpIntervalMs, mtoolPumpIntervalMs, integer);
+    SET_OPT_CUSTOMKEY(mtool.packedMessages, mtoolPackedMessages, boolean);
+    SET_OPT_CUSTOMKEY(mtool.reconnectMs, mtoolReconnectMs, integer);
     
     fillStringVec(opts["preloadScript"], preloadScripts);
     fillStringVec(opts["postloadScript"], postloadScripts);
@@ -349,6 +391,17 @@ try { exp } catch (...) {}
     rgssVersion = clamp(rgssVersion, 0, 3);
     SE.sourceCount = clamp(SE.sourceCount, 1, 64);
     BGM.trackCount = clamp(BGM.trackCount, 1, 16);
+    texturePoolSize = std::max(texturePoolSize, 0);
+    dataCacheSize = std::max(dataCacheSize, 0);
+    prefetchCacheSize = std::max(prefetchCacheSize, 0);
+    mtool.trsCacheSize = std::max(mtool.trsCacheSize, 1);
+    mtool.trsBatchSize = clamp(mtool.trsBatchSize, 1, 1024);
+    mtool.workerThreads = clamp(mtool.workerThreads, 1, 32);
+    mtool.taskQueueSize = clamp(mtool.taskQueueSize, 1, 65536);
+    mtool.evalBudgetMs = std::max(mtool.evalBudgetMs, 0);
+    mtool.pumpSliceMs = std::max(mtool.pumpSliceMs, 1);
+    mtool.pumpIntervalMs = std::max(mtool.pumpIntervalMs, 0);
+    mtool.reconnectMs = std::max(mtool.reconnectMs, 0);
     
     // Determine whether to open a console window on... Windows
     winConsole = getEnvironmentBool("MKXPZ_WINDOWS_CONSOLE", editor.debug);
@@ -49,6 +49,9 @@ struct Config {
     int bitmapSmoothScalingDown;
     bool smoothScalingMipmaps;
     int bicubicSharpness;
+    bool spriteBatching;
+    bool textAtlas;
+    int texturePoolSize;
 #ifdef MKXPZ_SSL
     double xbrzScalingFactor;
 #endif
@@ -65,6 +68,8 @@ struct Config {
     int fixedFramerate;
     bool frameSkip;
     bool syncToRefreshrate;
+    bool reuseIdleFrames;
+    bool skipIdlePresent;
     
     std::vector<std::string> solidFonts;
     
@@ -85,6 +90,12 @@ struct Config {
     bool enableSettings;
     bool allowSymlinks;
     bool pathCache;
+    bool pathCacheFile;
+    bool scriptCache;
+    bool bytecodeCache;
+    int dataCacheSize;
+    bool dataCacheParsed;
+    int prefetchCacheSize;
     
     std::string dataPathOrg;
     std::string dataPathApp;
@@ -148,6 +159,20 @@ struct Config {
 
     bool dumpAtlas;
 
+    // MTool link options
+    struct {
+        int trsCacheSize;
+        bool trsAsync;
+        int trsBatchSize;
+        int workerThreads;
+        int taskQueueSize;
+        int evalBudgetMs;
+        int pumpSliceMs;
+        int pumpIntervalMs;
+        bool packedMessages;
+        int reconnectMs;
+    } mtool;
+
     // Keybinding action name mappings
     struct {
         std::string a;
@@ -27,6 +27,12 @@
 
 #include <string>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
 /* Equivalent Linear Congruential Generator (LCG) constants for iteration 2^n
  * all the way up to 2^32/4 (the largest dword offset possible in
  * RGSS{AD,[23]A}).
@@ -60,17 +66,24 @@ struct RGSS_entryData
 	uint32_t startMagic;
 };
 
+/* Marks the position of an entry's archive io as unknown */
+#define RGSS_IO_UNKNOWN UINT64_MAX
+
 struct RGSS_entryHandle
 {
 	const RGSS_entryData data;
 	uint32_t currentMagic;
 	uint64_t currentOffset;
 	PHYSFS_Io *io;
+	/* Entry offset the archive io is positioned at; lets
+	 * sequential reads skip seeking it */
+	uint64_t ioOffset;
 
 	RGSS_entryHandle(const RGSS_entryData &data, PHYSFS_Io *archIo)
 	    : data(data),
 	      currentMagic(data.startMagic),
-	      currentOffset(0)
+	      currentOffset(0),
+	      ioOffset(RGSS_IO_UNKNOWN)
 	{
 		io = archIo->duplicate(archIo);
 	}
@@ -142,6 +155,94 @@ advanceMagicN(uint32_t &magic, uint32_t n) {
     return old;
 }
 
+/* XORs count dwords at buf (no alignment required) with the
+ * keystream starting at magic, and advances magic past them.
+ *
+ * Stepping the LCG one dword at a time makes every multiply-add
+ * wait on the previous one. Instead, the keystream is split into
+ * 8 interleaved lanes seeded with the next 8 magics, each of which
+ * jumps 8 steps at a time (LCG_TABLE[3]). The lanes don't depend
+ * on each other, so they map onto two NEON/SSE vectors. */
+static void
+xorKeystream(uint8_t *buf, uint64_t count, uint32_t &magic)
+{
+	uint64_t i = 0;
+
+	if (count >= 8)
+	{
+		uint32_t lanes[8];
+		lanes[0] = magic;
+		for (int k = 1; k < 8; ++k)
+			lanes[k] = lanes[k-1] * 7 + 3;
+
+		const uint32_t mul = LCG_TABLE[3][0];
+		const uint32_t add = LCG_TABLE[3][1];
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		const uint32x4_t vMul = vdupq_n_u32(mul);
+		const uint32x4_t vAdd = vdupq_n_u32(add);
+		uint32x4_t m0 = vld1q_u32(&lanes[0]);
+		uint32x4_t m1 = vld1q_u32(&lanes[4]);
+
+		for (; i + 8 <= count; i += 8)
+		{
+			uint8_t *p = buf + i * 4;
+			uint8x16_t d0 = vld1q_u8(p);
+			uint8x16_t d1 = vld1q_u8(p + 16);
+			vst1q_u8(p,      veorq_u8(d0, vreinterpretq_u8_u32(m0)));
+			vst1q_u8(p + 16, veorq_u8(d1, vreinterpretq_u8_u32(m1)));
+			m0 = vmlaq_u32(vAdd, m0, vMul);
+			m1 = vmlaq_u32(vAdd, m1, vMul);
+		}
+
+		vst1q_u32(&lanes[0], m0);
+		vst1q_u32(&lanes[4], m1);
+#elif defined(__SSE4_1__)
+		const __m128i vMul = _mm_set1_epi32((int) mul);
+		const __m128i vAdd = _mm_set1_epi32((int) add);
+		__m128i m0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&lanes[0]));
+		__m128i m1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&lanes[4]));
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i *p = reinterpret_cast<__m128i*>(buf + i * 4);
+			__m128i d0 = _mm_loadu_si128(p);
+			__m128i d1 = _mm_loadu_si128(p + 1);
+			_mm_storeu_si128(p,     _mm_xor_si128(d0, m0));
+			_mm_storeu_si128(p + 1, _mm_xor_si128(d1, m1));
+			m0 = _mm_add_epi32(_mm_mullo_epi32(m0, vMul), vAdd);
+			m1 = _mm_add_epi32(_mm_mullo_epi32(m1, vMul), vAdd);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&lanes[0]), m0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&lanes[4]), m1);
+#else
+		for (; i + 8 <= count; i += 8)
+		{
+			uint32_t d[8];
+			memcpy(d, buf + i * 4, sizeof(d));
+			for (int k = 0; k < 8; ++k)
+			{
+				d[k] ^= lanes[k];
+				lanes[k] = lanes[k] * mul + add;
+			}
+			memcpy(buf + i * 4, d, sizeof(d));
+		}
+#endif
+
+		/* Lane 0 holds the magic of the first dword not processed */
+		magic = lanes[0];
+	}
+
+	for (; i < count; ++i)
+	{
+		uint32_t dword;
+		memcpy(&dword, buf + i * 4, 4);
+		dword ^= advanceMagic(magic);
+		memcpy(buf + i * 4, &dword, 4);
+	}
+}
+
 static PHYSFS_sint64
 RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 {
@@ -152,7 +253,13 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 	uint64_t toRead = std::min<uint64_t>(entry->data.size - entry->currentOffset, len);
 	uint64_t offs = entry->currentOffset;
 
-	io->seek(io, entry->data.offset + offs);
+	if (toRead == 0)
+		return 0;
+
+	/* Nothing else moves this entry's io, so after a read
+	 * it already sits where the next sequential read starts */
+	if (entry->ioOffset != offs)
+		io->seek(io, entry->data.offset + offs);
 
 	/* We divide up the bytes to be read in 3 categories:
 	 *
@@ -177,11 +284,11 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 	if (preAlign == 4)
 		preAlign = 0;
 	else
-		preAlign = std::min<uint64_t>(preAlign, len);
+		preAlign = std::min<uint64_t>(preAlign, toRead);
 
-	uint8_t postAlign = (len > preAlign) ? (offs + len) % 4 : 0;
+	uint8_t postAlign = (toRead > preAlign) ? (offs + toRead) % 4 : 0;
 
-	uint64_t align = len - (preAlign + postAlign);
+	uint64_t align = toRead - (preAlign + postAlign);
 
 	/* Byte buffer pointer */
 	uint8_t *bBufferP = static_cast<uint8_t*>(buffer);
@@ -210,15 +317,11 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 
 	if (align > 0)
 	{
-		/* Double word buffer pointer */
-		uint32_t *dwBufferP = reinterpret_cast<uint32_t*>(bBufferP);
-
 		/* Read aligned dwords in one go */
 		io->read(io, bBufferP, align);
 
 		/* Then xor them */
-		for (uint64_t i = 0; i < (align / 4); ++i)
-			dwBufferP[i] ^= advanceMagic(entry->currentMagic);
+		xorKeystream(bBufferP, align / 4, entry->currentMagic);
 
 		bBufferP += align;
 	}
@@ -234,6 +337,7 @@ RGSS_ioRead(PHYSFS_Io *self, void *buffer, PHYSFS_uint64 len)
 	}
 
 	entry->currentOffset += toRead;
+	entry->ioOffset = entry->currentOffset;
 
 	return toRead;
 }
@@ -263,8 +367,8 @@ RGSS_ioSeek(PHYSFS_Io *self, PHYSFS_uint64 offset)
 
 	advanceMagicN(entry->currentMagic, (uint32_t) dwordsSought);
 
+	/* The archive io is seeked lazily by the next read */
 	entry->currentOffset = offset;
-	entry->io->seek(entry->io, entry->data.offset + entry->currentOffset);
 
 	return 1;
 }
@@ -289,7 +393,11 @@ static PHYSFS_Io*
 RGSS_ioDuplicate(PHYSFS_Io *self)
 {
 	const RGSS_entryHandle *entry = static_cast<RGSS_entryHandle*>(self->opaque);
-	RGSS_entryHandle *entryDup = new RGSS_entryHandle(*entry);
+	/* The duplicate gets its own archive io, as both
+	 * handles track where theirs is positioned */
+	RGSS_entryHandle *entryDup = new RGSS_entryHandle(entry->data, entry->io);
+	entryDup->currentMagic = entry->currentMagic;
+	entryDup->currentOffset = entry->currentOffset;
 
 	PHYSFS_Io *dup = PHYSFS_ALLOC(PHYSFS_Io);
 	*dup = *self;
@@ -39,8 +39,10 @@
 #include "sharedstate.h"
 #include "glstate.h"
 #include "texpool.h"
+#include "textatlas.h"
 #include "shader.h"
 #include "filesystem.h"
+#include "assetprefetch.h"
 #include "font.h"
 #include "eventthread.h"
 #include "graphics.h"
@@ -53,6 +55,7 @@
 
 #include <math.h>
 #include <algorithm>
+#include <vector>
 
 extern "C" {
 #include "libnsgif/libnsgif.h"
@@ -187,15 +190,18 @@ struct BitmapPrivate
         inline void play() {
             playing = true;
             needsReset = true;
+            SharedState::damageScreen();
         }
         
         inline void stop() {
             lastFrame = currentFrameI();
             playing = false;
+            SharedState::damageScreen();
         }
         
         inline void seek(int frame) {
             lastFrame = clamp(frame, 0, (int)frames.size());
+            SharedState::damageScreen();
         }
         
         void updateTimer() {
@@ -225,11 +231,45 @@ struct BitmapPrivate
     SDL_Surface *megaSurface;
     
     /* A cached version of the bitmap in client memory, for
-     * getPixel calls. Is invalidated any time the bitmap
-     * is modified */
+     * getPixel calls. Modifications only mark the area they
+     * touched as stale, and just that part is read back from
+     * the texture the next time the surface is needed */
     SDL_Surface *surface;
+    pixman_region16_t staleArea;
     SDL_PixelFormat *format;
     
+    /* Readback started ahead of time by prefetchPixels():
+     * rows [y1, y2) of the texture are being copied into 'pbo'.
+     * While it is in flight, staleArea only collects what
+     * was modified after the readback was issued */
+    struct
+    {
+        PBO::ID pbo;
+        int y1, y2;
+    } prefetch;
+    
+    /* setPixel writes that haven't reached the texture yet.
+     * They're uploaded in a few batched calls right before
+     * the texture is next used (see flushPixels()).
+     *
+     * While 'surface' is current, writes go into it and only the
+     * touched row spans are remembered; otherwise the pixels
+     * themselves are queued */
+    struct PendingSpan
+    {
+        int x1, x2; /* [x1, x2) */
+        int y1, y2; /* [y1, y2) */
+    };
+    
+    struct PendingPixel
+    {
+        int x, y;
+        uint8_t rgba[4];
+    };
+    
+    std::vector<PendingSpan> pendingSpans;
+    std::vector<PendingPixel> pendingPixels;
+    
     /* The 'tainted' area describes which parts of the
      * bitmap are not cleared, ie. don't have 0 opacity.
      * If we're blitting / drawing text to a cleared part
@@ -251,6 +291,9 @@ struct BitmapPrivate
     surface(0),
     assumingRubyGC(false)
     {
+        prefetch.pbo = PBO::ID();
+        prefetch.y1 = prefetch.y2 = 0;
+        
         format = SDL_AllocFormat(SDL_PIXELFORMAT_ABGR8888);
         
         animation.width = 0;
@@ -267,16 +310,21 @@ struct BitmapPrivate
         
         font = &shState->defaultFont();
         pixman_region_init(&tainted);
+        pixman_region_init(&staleArea);
     }
     
     ~BitmapPrivate()
     {
         prepareCon.disconnect();
+        dropSurface();
         SDL_FreeFormat(format);
         pixman_region_fini(&tainted);
+        pixman_region_fini(&staleArea);
     }
     
     TEXFBO &getGLTypes() {
+        flushPixels();
+        
         return (animation.enabled) ? animation.currentFrame() : gl;
     }
     
@@ -285,6 +333,11 @@ struct BitmapPrivate
         if (!animation.enabled || !animation.playing) return;
         
         animation.updateTimer();
+        
+        /* Whatever shows this bitmap needs to be composited
+         * again next frame, until a one-shot animation ends */
+        if (animation.loop || animation.currentFrameIRaw() < animation.frames.size())
+            SharedState::damageScreen();
     }
     
     void allocSurface()
@@ -294,6 +347,326 @@ struct BitmapPrivate
                                        format->Bmask, format->Amask);
     }
     
+    void dropSurface()
+    {
+        if (prefetch.pbo != PBO::ID())
+        {
+            PBO::del(prefetch.pbo);
+            prefetch.pbo = PBO::ID();
+        }
+        
+        if (surface)
+        {
+            SDL_FreeSurface(surface);
+            surface = 0;
+        }
+        
+        clearStaleArea();
+    }
+    
+    void clearStaleArea()
+    {
+        pixman_region_fini(&staleArea);
+        pixman_region_init(&staleArea);
+    }
+    
+    /* True if 'surface' can be used without going back to the texture */
+    bool surfaceCurrent()
+    {
+        return surface && prefetch.pbo == PBO::ID() && !pixman_region_not_empty(&staleArea);
+    }
+    
+    void addStaleArea(const IntRect &rect)
+    {
+        if (!surface)
+            return;
+        
+        IntRect norm = normalizedRect(rect);
+        pixman_region_union_rect
+        (&staleArea, &staleArea, norm.x, norm.y, norm.w, norm.h);
+        pixman_region_intersect_rect
+        (&staleArea, &staleArea, 0, 0, gl.width, gl.height);
+    }
+    
+    /* Reads the stale area from the texture into 'surface' */
+    void readStaleArea()
+    {
+        int count;
+        const pixman_box16_t *boxes = pixman_region_rectangles(&staleArea, &count);
+        
+        if (count == 0)
+            return;
+        
+        FBO::bind(gl.fbo);
+        
+        glState.viewport.pushSet(IntRect(0, 0, gl.width, gl.height));
+        
+        uint8_t *pixels = (uint8_t*) surface->pixels;
+        
+        if (::gl.pack_subimage)
+        {
+            ::gl.PixelStorei(GL_PACK_ROW_LENGTH, surface->w);
+            
+            for (int i = 0; i < count; ++i)
+            {
+                const pixman_box16_t &b = boxes[i];
+                ::gl.ReadPixels(b.x1, b.y1, b.x2 - b.x1, b.y2 - b.y1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                pixels + b.y1 * surface->pitch + b.x1 * format->BytesPerPixel);
+            }
+            
+            ::gl.PixelStorei(GL_PACK_ROW_LENGTH, 0);
+        }
+        else
+        {
+            /* Only whole rows are contiguous in the surface. The boxes
+             * come sorted in bands, so touching bands are merged */
+            int y1 = boxes[0].y1, y2 = boxes[0].y2;
+            
+            for (int i = 1; i <= count; ++i)
+            {
+                if (i < count && boxes[i].y1 <= y2)
+                {
+                    y2 = std::max<int>(y2, boxes[i].y2);
+                    continue;
+                }
+                
+                ::gl.ReadPixels(0, y1, gl.width, y2 - y1, GL_RGBA, GL_UNSIGNED_BYTE,
+                                pixels + y1 * surface->pitch);
+                
+                if (i < count)
+                {
+                    y1 = boxes[i].y1;
+                    y2 = boxes[i].y2;
+                }
+            }
+        }
+        
+        glState.viewport.pop();
+        
+        clearStaleArea();
+    }
+    
+    /* Starts an asynchronous readback of the stale rows */
+    void prefetchPixels()
+    {
+        if (!::gl.MapBufferRange || prefetch.pbo != PBO::ID() || surfaceCurrent())
+            return;
+        
+        flushPixels();
+        
+        if (!surface)
+        {
+            allocSurface();
+            addStaleArea(IntRect(0, 0, gl.width, gl.height));
+        }
+        
+        const pixman_box16_t *extents = pixman_region_extents(&staleArea);
+        prefetch.y1 = extents->y1;
+        prefetch.y2 = extents->y2;
+        
+        prefetch.pbo = PBO::gen();
+        PBO::bind(prefetch.pbo);
+        PBO::allocEmpty((prefetch.y2 - prefetch.y1) * surface->pitch, GL_STREAM_READ);
+        
+        FBO::bind(gl.fbo);
+        
+        /* With a pack buffer bound, the pointer is an offset into it */
+        ::gl.ReadPixels(0, prefetch.y1, gl.width, prefetch.y2 - prefetch.y1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        
+        PBO::unbind();
+        
+        clearStaleArea();
+    }
+    
+    /* Copies a finished prefetch into 'surface' */
+    void resolvePrefetch()
+    {
+        size_t size = (prefetch.y2 - prefetch.y1) * surface->pitch;
+        
+        PBO::bind(prefetch.pbo);
+        
+        void *data = ::gl.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        
+        if (data)
+        {
+            memcpy((uint8_t*) surface->pixels + prefetch.y1 * surface->pitch, data, size);
+            ::gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        else
+        {
+            /* Fall back to reading those rows directly */
+            addStaleArea(IntRect(0, prefetch.y1, gl.width, prefetch.y2 - prefetch.y1));
+        }
+        
+        PBO::unbind();
+        PBO::del(prefetch.pbo);
+        prefetch.pbo = PBO::ID();
+    }
+    
+    /* Makes sure 'surface' holds the texture contents */
+    void readbackSurface()
+    {
+        if (surfaceCurrent())
+            return;
+        
+        flushPixels();
+        
+        if (!surface)
+        {
+            allocSurface();
+            addStaleArea(IntRect(0, 0, gl.width, gl.height));
+        }
+        
+        /* Anything modified after the prefetch was issued is
+         * in the stale area, and is read over the prefetched rows */
+        if (prefetch.pbo != PBO::ID())
+            resolvePrefetch();
+        
+        readStaleArea();
+    }
+    
+    void addPendingSpan(int x, int y)
+    {
+        for (size_t i = 0; i < pendingSpans.size(); ++i)
+        {
+            PendingSpan &span = pendingSpans[i];
+            
+            if (y < span.y1 - 1 || y > span.y2)
+                continue;
+            
+            span.x1 = std::min(span.x1, x);
+            span.x2 = std::max(span.x2, x + 1);
+            span.y1 = std::min(span.y1, y);
+            span.y2 = std::max(span.y2, y + 1);
+            return;
+        }
+        
+        PendingSpan span = { x, x + 1, y, y + 1 };
+        pendingSpans.push_back(span);
+        
+        if (pendingSpans.size() <= 4)
+            return;
+        
+        /* Too many spans; merge the two that are closest */
+        std::sort(pendingSpans.begin(), pendingSpans.end(),
+                  [](const PendingSpan &a, const PendingSpan &b) { return a.y1 < b.y1; });
+        
+        size_t closest = 0;
+        for (size_t i = 1; i + 1 < pendingSpans.size(); ++i)
+            if (pendingSpans[i+1].y1 - pendingSpans[i].y2 <
+                pendingSpans[closest+1].y1 - pendingSpans[closest].y2)
+                closest = i;
+        
+        PendingSpan &a = pendingSpans[closest];
+        const PendingSpan &b = pendingSpans[closest+1];
+        a.x1 = std::min(a.x1, b.x1);
+        a.x2 = std::max(a.x2, b.x2);
+        a.y2 = std::max(a.y2, b.y2);
+        pendingSpans.erase(pendingSpans.begin() + closest + 1);
+    }
+    
+    void addPendingPixel(int x, int y, const uint8_t rgba[4])
+    {
+        PendingPixel pixel = { x, y, { rgba[0], rgba[1], rgba[2], rgba[3] } };
+        pendingPixels.push_back(pixel);
+        
+        /* Past this point, keeping a full copy of the
+         * bitmap is cheaper than queueing every pixel */
+        if (pendingPixels.size() > (size_t) (gl.width * gl.height) / 4)
+            readbackSurface();
+    }
+    
+    void uploadPendingSpans()
+    {
+        for (size_t i = 0; i < pendingSpans.size(); ++i)
+        {
+            const PendingSpan &span = pendingSpans[i];
+            
+            if (::gl.unpack_subimage)
+            {
+                ::gl.PixelStorei(GL_UNPACK_ROW_LENGTH, surface->w);
+                ::gl.PixelStorei(GL_UNPACK_SKIP_PIXELS, span.x1);
+                ::gl.PixelStorei(GL_UNPACK_SKIP_ROWS, span.y1);
+                TEX::uploadSubImage(span.x1, span.y1, span.x2 - span.x1, span.y2 - span.y1,
+                                    surface->pixels, GL_RGBA);
+                GLMeta::subRectImageEnd();
+            }
+            else
+            {
+                /* Whole rows are contiguous in the surface */
+                const uint8_t *rows = (const uint8_t*) surface->pixels + span.y1 * surface->pitch;
+                TEX::uploadSubImage(0, span.y1, surface->w, span.y2 - span.y1, rows, GL_RGBA);
+            }
+        }
+        
+        pendingSpans.clear();
+    }
+    
+    void uploadPendingPixels()
+    {
+        /* Sort into rows, keeping the latest write to each pixel,
+         * and upload every horizontal run with one call */
+        std::stable_sort(pendingPixels.begin(), pendingPixels.end(),
+                         [](const PendingPixel &a, const PendingPixel &b) {
+            return (a.y != b.y) ? a.y < b.y : a.x < b.x;
+        });
+        
+        std::vector<uint8_t> run;
+        int runX = 0, runY = 0;
+        
+        for (size_t i = 0; i < pendingPixels.size(); ++i)
+        {
+            while (i + 1 < pendingPixels.size() &&
+                   pendingPixels[i+1].x == pendingPixels[i].x &&
+                   pendingPixels[i+1].y == pendingPixels[i].y)
+                ++i;
+            
+            const PendingPixel &pixel = pendingPixels[i];
+            
+            if (!run.empty() && (pixel.y != runY || pixel.x != runX + (int) run.size() / 4))
+            {
+                TEX::uploadSubImage(runX, runY, run.size() / 4, 1, &run[0], GL_RGBA);
+                run.clear();
+            }
+            
+            if (run.empty())
+            {
+                runX = pixel.x;
+                runY = pixel.y;
+            }
+            
+            run.insert(run.end(), pixel.rgba, pixel.rgba + 4);
+        }
+        
+        if (!run.empty())
+            TEX::uploadSubImage(runX, runY, run.size() / 4, 1, &run[0], GL_RGBA);
+        
+        pendingPixels.clear();
+    }
+    
+    /* Must run before anything reads or renders to the texture */
+    void flushPixels()
+    {
+        if (pendingSpans.empty() && pendingPixels.empty())
+            return;
+        
+        TEX::bind(gl.tex);
+        
+        if (!pendingSpans.empty())
+            uploadPendingSpans();
+        
+        if (!pendingPixels.empty())
+            uploadPendingPixels();
+    }
+    
+    /* For operations that overwrite the whole texture */
+    void discardPixels()
+    {
+        pendingSpans.clear();
+        pendingPixels.clear();
+    }
+    
     void clearTaintedArea()
     {
         pixman_region_fini(&tainted);
@@ -334,10 +707,12 @@ struct BitmapPrivate
         return result != PIXMAN_REGION_OUT;
     }
     
-    void bindTexture(ShaderBase &shader, bool substituteLoresSize = true)
+    void getTexture(TEX::ID &tex, Vec2i &texSize, bool substituteLoresSize = true)
     {
+        flushPixels();
+        
         if (selfHires) {
-            selfHires->bindTex(shader, substituteLoresSize);
+            selfHires->getTex(tex, texSize, substituteLoresSize);
             return;
         }
 
@@ -347,18 +722,29 @@ struct BitmapPrivate
             }
 
             TEXFBO cframe = animation.currentFrame();
-            TEX::bind(cframe.tex);
-            shader.setTexSize(Vec2i(cframe.width, cframe.height));
+            tex = cframe.tex;
+            texSize = Vec2i(cframe.width, cframe.height);
             return;
         }
-        TEX::bind(gl.tex);
+        tex = gl.tex;
         if (selfLores && substituteLoresSize) {
-            shader.setTexSize(Vec2i(selfLores->width(), selfLores->height()));
+            texSize = Vec2i(selfLores->width(), selfLores->height());
         }
         else {
-            shader.setTexSize(Vec2i(gl.width, gl.height));
+            texSize = Vec2i(gl.width, gl.height);
         }
     }
+
+    void bindTexture(ShaderBase &shader, bool substituteLoresSize = true)
+    {
+        TEX::ID tex;
+        Vec2i texSize;
+
+        getTexture(tex, texSize, substituteLoresSize);
+
+        TEX::bind(tex);
+        shader.setTexSize(texSize);
+    }
     
     void bindFBO()
     {
@@ -386,6 +772,7 @@ struct BitmapPrivate
     void fillRect(const IntRect &rect,
                   const Vec4 &color)
     {
+        flushPixels();
         bindFBO();
         
         glState.scissorTest.pushSet(true);
@@ -413,11 +800,32 @@ struct BitmapPrivate
     {
         if (surface && freeSurface)
         {
-            SDL_FreeSurface(surface);
-            surface = 0;
+            /* Callers flush before touching the texture,
+             * so nothing can be pending on the surface */
+            pendingSpans.clear();
+            dropSurface();
+        }
+        
+        self->modified();
+        SharedState::damageScreen();
+    }
+    
+    /* Like onModified(), for operations that only touched 'rect' */
+    void onModified(const IntRect &rect)
+    {
+        addStaleArea(rect);
+        
+        if (surface)
+        {
+            pixman_box16_t box = { 0, 0, (int16_t) gl.width, (int16_t) gl.height };
+            
+            /* Nothing left worth keeping */
+            if (pixman_region_contains_rectangle(&staleArea, &box) == PIXMAN_REGION_IN)
+                dropSurface();
         }
         
         self->modified();
+        SharedState::damageScreen();
     }
 };
 
@@ -508,6 +916,12 @@ Bitmap::Bitmap(const char *filename)
         }
     }
 
+    /* Already decoded by System.prefetch */
+    if (SDL_Surface *staged = shState->assetPrefetch().takeImage(filename)) {
+        initFromSurface(staged, hiresBitmap, false);
+        return;
+    }
+
     BitmapOpenHandler handler;
     try {
         shState->fileSystem().openRead(handler, filename);
@@ -1050,6 +1464,9 @@ void Bitmap::stretchBlt(IntRect destRect,
     if (source.isDisposed())
         return;
 
+    p->flushPixels();
+    source.p->flushPixels();
+
     if (hasHires()) {
         int destX, destY, destWidth, destHeight;
         destX = destRect.x * p->selfHires->width() / width();
@@ -1319,7 +1736,7 @@ void Bitmap::stretchBlt(IntRect destRect,
         SDL_FreeSurface(blitTemp);
     
     p->addTaintedArea(destRect);
-    p->onModified();
+    p->onModified(destRect);
 }
 
 void Bitmap::fillRect(int x, int y,
@@ -1355,7 +1772,7 @@ void Bitmap::fillRect(const IntRect &rect, const Vec4 &color)
     /* Fill op */
         p->addTaintedArea(rect);
     
-    p->onModified();
+    p->onModified(rect);
 }
 
 void Bitmap::gradientFillRect(int x, int y,
@@ -1408,6 +1825,7 @@ void Bitmap::gradientFillRect(const IntRect &rect,
     
     quad.setPosRect(rect);
     
+    p->flushPixels();
     p->bindFBO();
     p->pushSetViewport(shader);
     
@@ -1417,7 +1835,7 @@ void Bitmap::gradientFillRect(const IntRect &rect,
     
     p->addTaintedArea(rect);
     
-    p->onModified();
+    p->onModified(rect);
 }
 
 void Bitmap::clearRect(int x, int y, int width, int height)
@@ -1444,7 +1862,7 @@ void Bitmap::clearRect(const IntRect &rect)
 
     p->fillRect(rect, Vec4());
     
-    p->onModified();
+    p->onModified(rect);
 }
 
 void Bitmap::blur()
@@ -1458,6 +1876,8 @@ void Bitmap::blur()
         p->selfHires->blur();
     }
 
+    p->flushPixels();
+
     // TODO: Is there some kind of blur radius that we need to handle for high-res mode?
 
     Quad &quad = shState->gpQuad();
@@ -1611,6 +2031,7 @@ void Bitmap::clear()
         p->selfHires->clear();
     }
 
+    p->discardPixels();
     p->bindFBO();
     
     glState.clearColor.pushSet(Vec4());
@@ -1685,18 +2106,7 @@ Color Bitmap::getPixel(int x, int y) const
     if (x < 0 || y < 0 || x >= width() || y >= height())
         return Vec4();
 
-    if (!p->surface)
-    {
-        p->allocSurface();
-        
-        FBO::bind(p->gl.fbo);
-        
-        glState.viewport.pushSet(IntRect(0, 0, width(), height()));
-        
-        gl.ReadPixels(0, 0, width(), height(), GL_RGBA, GL_UNSIGNED_BYTE, p->surface->pixels);
-        
-        glState.viewport.pop();
-    }
+    p->readbackSurface();
     
     uint32_t pixel = getPixelAt(p->surface, p->format, x, y);
     
@@ -1706,6 +2116,19 @@ Color Bitmap::getPixel(int x, int y) const
                  (pixel >> p->format->Ashift) & 0xFF);
 }
 
+void Bitmap::prefetchPixels()
+{
+    guardDisposed();
+    
+    if (p->megaSurface || p->animation.enabled)
+        return;
+    
+    if (hasHires())
+        p->selfHires->prefetchPixels();
+    
+    p->prefetchPixels();
+}
+
 void Bitmap::setPixel(int x, int y, const Color &color)
 {
     guardDisposed();
@@ -1713,6 +2136,9 @@ void Bitmap::setPixel(int x, int y, const Color &color)
     GUARD_MEGA;
     GUARD_ANIMATED;
     
+    if (x < 0 || y < 0 || x >= width() || y >= height())
+        return;
+    
     if (hasHires()) {
         Debug() << "GAME BUG: Game is calling setPixel on low-res Bitmap; you may want to patch the game to improve graphics quality.";
 
@@ -1739,20 +2165,27 @@ void Bitmap::setPixel(int x, int y, const Color &color)
         (uint8_t) clamp<double>(color.alpha, 0, 255)
     };
     
-    TEX::bind(p->gl.tex);
-    TEX::uploadSubImage(x, y, 1, 1, &pixel, GL_RGBA);
-    
-    p->addTaintedArea(IntRect(x, y, 1, 1));
-    
     /* Setting just a single pixel is no reason to throw away the
-     * whole cached surface; we can just apply the same change */
+     * whole cached surface; we can just apply the same change.
+     * The texture itself is updated once it's next used */
     
-    if (p->surface)
+    if (p->surfaceCurrent())
     {
         uint32_t &surfPixel = getPixelAt(p->surface, p->format, x, y);
         surfPixel = SDL_MapRGBA(p->format, pixel[0], pixel[1], pixel[2], pixel[3]);
+        
+        p->addPendingSpan(x, y);
+    }
+    else
+    {
+        /* The surface's copy is read back with the rest
+         * of the stale area instead */
+        p->addStaleArea(IntRect(x, y, 1, 1));
+        p->addPendingPixel(x, y, pixel);
     }
     
+    p->addTaintedArea(IntRect(x, y, 1, 1));
+    
     p->onModified(false);
 }
 
@@ -1766,9 +2199,12 @@ bool Bitmap::getRaw(void *output, int output_size)
         Debug() << "GAME BUG: Game is calling getRaw on low-res Bitmap; you may want to patch the game to improve graphics quality.";
     }
 
-    if (!p->animation.enabled && (p->surface || p->megaSurface)) {
-        void *src = (p->megaSurface) ? p->megaSurface->pixels : p->surface->pixels;
-        memcpy(output, src, output_size);
+    if (p->megaSurface) {
+        memcpy(output, p->megaSurface->pixels, output_size);
+    }
+    else if (!p->animation.enabled) {
+        p->readbackSurface();
+        memcpy(output, p->surface->pixels, output_size);
     }
     else {
         FBO::bind(getGLTypes().fbo);
@@ -1794,6 +2230,8 @@ void Bitmap::replaceRaw(void *pixel_data, int size)
     if (size != w*h*4)
         throw Exception(Exception::MKXPError, "Replacement bitmap data is not large enough (given %i bytes, need %i)", size, requiredsize);
     
+    p->discardPixels();
+    
     TEX::bind(getGLTypes().tex);
     TEX::uploadImage(w, h, pixel_data, GL_RGBA);
     
@@ -1810,11 +2248,17 @@ void Bitmap::saveToFile(const char *filename)
     }
 
     SDL_Surface *surf;
+    bool tempSurf = false;
     
-    if (p->surface || p->megaSurface) {
-        surf = (p->surface) ? p->surface : p->megaSurface;
+    if (p->megaSurface) {
+        surf = p->megaSurface;
+    }
+    else if (!p->animation.enabled) {
+        p->readbackSurface();
+        surf = p->surface;
     }
     else {
+        tempSurf = true;
         surf = SDL_CreateRGBSurface(0, width(), height(),p->format->BitsPerPixel, p->format->Rmask,p->format->Gmask,p->format->Bmask,p->format->Amask);
         
         if (!surf)
@@ -1855,7 +2299,7 @@ void Bitmap::saveToFile(const char *filename)
             break;
     }
     
-    if (!p->surface && !p->megaSurface)
+    if (tempSurf)
         SDL_FreeSurface(surf);
     
     if (rc) throw Exception(Exception::SDLError, "%s", SDL_GetError());
@@ -2014,6 +2458,53 @@ static void applyShadow(SDL_Surface *&in, const SDL_PixelFormat &fm, const SDL_C
     in = out;
 }
 
+/* Renders 'str' with the font's shadow and outline applied.
+ * 'rawHeight' receives the height before either was added */
+static SDL_Surface *renderText(Font &f, TTF_Font *font, const char *str,
+                               const SDL_Color &c, const SDL_Color &co,
+                               int outlineSize, SDL_PixelFormat &format,
+                               int &rawHeight)
+{
+    SDL_Surface *txtSurf;
+    
+    if (f.isSolid())
+        txtSurf = TTF_RenderUTF8_Solid(font, str, c);
+    else
+        txtSurf = TTF_RenderUTF8_Blended(font, str, c);
+    
+    BitmapPrivate::ensureFormat(txtSurf, SDL_PIXELFORMAT_ABGR8888);
+    
+    rawHeight = txtSurf->h;
+    
+    if (f.getShadow())
+        applyShadow(txtSurf, format, c);
+    
+    /* outline using TTF_Outline and blending it together with SDL_BlitSurface
+     * FIXME: outline is forced to have the same opacity as the font color */
+    if (f.getOutline())
+    {
+        SDL_Surface *outline;
+        /* set the next font render to render the outline */
+        TTF_SetFontOutline(font, outlineSize);
+        if (f.isSolid())
+            outline = TTF_RenderUTF8_Solid(font, str, co);
+        else
+            outline = TTF_RenderUTF8_Blended(font, str, co);
+        
+        BitmapPrivate::ensureFormat(outline, SDL_PIXELFORMAT_ABGR8888);
+        SDL_Rect outRect = {outlineSize, outlineSize, txtSurf->w, txtSurf->h};
+        
+        SDL_SetSurfaceBlendMode(txtSurf, SDL_BLENDMODE_BLEND);
+        SDL_BlitSurface(txtSurf, NULL, outline, &outRect);
+        SDL_FreeSurface(txtSurf);
+        txtSurf = outline;
+        /* reset outline to 0 */
+        TTF_SetFontOutline(font, 0);
+    }
+    
+    return txtSurf;
+}
+
 void Bitmap::drawText(const IntRect &rect, const char *str, int align)
 {
     guardDisposed();
@@ -2059,48 +2550,63 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
     SDL_Color c = fontColor.toSDLColor();
     c.a = 255;
     
-    SDL_Surface *txtSurf;
+    SDL_Color co = outColor.toSDLColor();
+    co.a = 255;
     
-    if (p->font->isSolid())
-        txtSurf = TTF_RenderUTF8_Solid(font, str, c);
-    else
-        txtSurf = TTF_RenderUTF8_Blended(font, str, c);
+    // Handle high-res for outline.
+    int scaledOutlineSize = OUTLINE_SIZE;
+    if (p->selfLores) {
+        scaledOutlineSize = scaledOutlineSize * width() / p->selfLores->width();
+    }
     
-    p->ensureFormat(txtSurf, SDL_PIXELFORMAT_ABGR8888);
+    const bool useAtlas = shState->config().textAtlas;
+    TextAtlas::Key key;
+    const TextAtlas::Entry *cached = 0;
     
-    int rawTxtSurfH = txtSurf->h;
+    if (useAtlas)
+    {
+        key.font = font;
+        key.style = TTF_GetFontStyle(font);
+        key.solid = p->font->isSolid();
+        key.shadow = p->font->getShadow();
+        key.outline = p->font->getOutline() ? scaledOutlineSize : 0;
+        key.color = c.r << 16 | c.g << 8 | c.b;
+        key.outColor = key.outline ? (co.r << 16 | co.g << 8 | co.b) : 0;
+        key.text = str;
+        
+        cached = shState->textAtlas().find(key);
+    }
     
-    if (p->font->getShadow())
-        applyShadow(txtSurf, *p->format, c);
+    SDL_Surface *txtSurf = 0;
+    int rawTxtSurfH;
     
-    /* outline using TTF_Outline and blending it together with SDL_BlitSurface
-     * FIXME: outline is forced to have the same opacity as the font color */
-    if (p->font->getOutline())
+    if (!cached)
     {
-        SDL_Color co = outColor.toSDLColor();
-        co.a = 255;
-        SDL_Surface *outline;
-        // Handle high-res for outline.
-        int scaledOutlineSize = OUTLINE_SIZE;
-        if (p->selfLores) {
-            scaledOutlineSize = scaledOutlineSize * width() / p->selfLores->width();
-        }
-        /* set the next font render to render the outline */
-        TTF_SetFontOutline(font, scaledOutlineSize);
-        if (p->font->isSolid())
-            outline = TTF_RenderUTF8_Solid(font, str, co);
-        else
-            outline = TTF_RenderUTF8_Blended(font, str, co);
+        txtSurf = renderText(*p->font, font, str, c, co, scaledOutlineSize,
+                             *p->format, rawTxtSurfH);
         
-        p->ensureFormat(outline, SDL_PIXELFORMAT_ABGR8888);
-        SDL_Rect outRect = {scaledOutlineSize, scaledOutlineSize, txtSurf->w, txtSurf->h};
+        if (useAtlas)
+            cached = shState->textAtlas().insert(key, txtSurf, rawTxtSurfH);
         
-        SDL_SetSurfaceBlendMode(txtSurf, SDL_BLENDMODE_BLEND);
-        SDL_BlitSurface(txtSurf, NULL, outline, &outRect);
-        SDL_FreeSurface(txtSurf);
-        txtSurf = outline;
-        /* reset outline to 0 */
-        TTF_SetFontOutline(font, 0);
+        if (cached)
+        {
+            SDL_FreeSurface(txtSurf);
+            txtSurf = 0;
+        }
+    }
+    
+    int txtW, txtH;
+    
+    if (cached)
+    {
+        txtW = cached->rect.w;
+        txtH = cached->rect.h;
+        rawTxtSurfH = cached->rawHeight;
+    }
+    else
+    {
+        txtW = txtSurf->w;
+        txtH = txtSurf->h;
     }
     
     int alignX = rect.x;
@@ -2112,11 +2618,11 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
             break;
             
         case Center :
-            alignX += (rect.w - txtSurf->w) / 2;
+            alignX += (rect.w - txtW) / 2;
             break;
             
         case Right :
-            alignX += rect.w - txtSurf->w;
+            alignX += rect.w - txtW;
             break;
     }
     
@@ -2125,14 +2631,14 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
     
     int alignY = rect.y + (rect.h - rawTxtSurfH) / 2;
     
-    float squeeze = (float) rect.w / txtSurf->w;
+    float squeeze = (float) rect.w / txtW;
     
     if (squeeze > 1)
         squeeze = 1;
     
     IntRect destRect(alignX, alignY, 0, 0);
-    destRect.w = std::min(rect.w, (int)(txtSurf->w * squeeze));
-    destRect.h = std::min(rect.h, txtSurf->h);
+    destRect.w = std::min(rect.w, (int)(txtW * squeeze));
+    destRect.h = std::min(rect.h, txtH);
     
     destRect.w = std::min(destRect.w, width() - destRect.x);
     destRect.h = std::min(destRect.h, height() - destRect.y);
@@ -2141,8 +2647,17 @@ void Bitmap::drawText(const IntRect &rect, const char *str, int align)
     sourceRect.w = destRect.w / squeeze;
     sourceRect.h = destRect.h;
     
-    Bitmap txtBitmap(txtSurf, nullptr, true);
     bool smooth = squeeze != 1.0f;
+    
+    if (cached)
+    {
+        sourceRect.x = cached->rect.x;
+        sourceRect.y = cached->rect.y;
+        stretchBlt(destRect, *cached->page, sourceRect, fontColor.alpha, smooth);
+        return;
+    }
+    
+    Bitmap txtBitmap(txtSurf, nullptr, true);
     stretchBlt(destRect, txtBitmap, sourceRect, fontColor.alpha, smooth);
 }
 
@@ -2253,6 +2768,9 @@ SDL_Surface *Bitmap::surface() const
         Debug() << "BUG: High-res Bitmap surface not implemented";
     }
 
+    if (p->surface)
+        p->readbackSurface();
+
     return p->surface;
 }
 
@@ -2410,6 +2928,9 @@ int Bitmap::addFrame(Bitmap &source, int position)
         throw Exception(Exception::MKXPError, "Animations with varying dimensions are not supported (%ix%i vs %ix%i)",
                         source.width(), source.height(), width(), height());
     
+    p->flushPixels();
+    source.p->flushPixels();
+    
     TEXFBO newframe = shState->texPool().request(source.width(), source.height());
     
     // Convert the bitmap into an animated bitmap if it isn't already one
@@ -2426,16 +2947,13 @@ int Bitmap::addFrame(Bitmap &source, int position)
         
         p->animation.frames.push_back(p->gl);
         
-        if (p->surface)
-            SDL_FreeSurface(p->surface);
+        p->dropSurface();
         p->gl = TEXFBO();
     }
     
-    if (source.surface()) {
+    if (source.p->surfaceCurrent()) {
         TEX::bind(newframe.tex);
-        TEX::uploadImage(source.width(), source.height(), source.surface()->pixels, GL_RGBA);
-        SDL_FreeSurface(p->surface);
-        p->surface = 0;
+        TEX::uploadImage(source.width(), source.height(), source.p->surface->pixels, GL_RGBA);
     }
     else {
         GLMeta::blitBegin(newframe, false, SameScale);
@@ -2455,6 +2973,8 @@ int Bitmap::addFrame(Bitmap &source, int position)
         ret = position;
     }
     
+    SharedState::damageScreen();
+    
     return ret;
 }
 
@@ -2486,6 +3006,8 @@ void Bitmap::removeFrame(int position) {
         FBO::bind(p->gl.fbo);
         taintArea(rect());
     }
+    
+    SharedState::damageScreen();
 }
 
 void Bitmap::nextFrame()
@@ -2499,6 +3021,8 @@ void Bitmap::nextFrame()
     }
 
     stop();
+    SharedState::damageScreen();
+    
     if ((uint32_t)p->animation.lastFrame >= p->animation.frames.size() - 1)  {
         if (!p->animation.loop) return;
         p->animation.lastFrame = 0;
@@ -2519,6 +3043,8 @@ void Bitmap::previousFrame()
     }
 
     stop();
+    SharedState::damageScreen();
+    
     if (p->animation.lastFrame <= 0) {
         if (!p->animation.loop) {
             p->animation.lastFrame = 0;
@@ -2602,6 +3128,11 @@ void Bitmap::bindTex(ShaderBase &shader, bool substituteLoresSize)
     p->bindTexture(shader, substituteLoresSize);
 }
 
+void Bitmap::getTex(TEX::ID &tex, Vec2i &texSize, bool substituteLoresSize)
+{
+    p->getTexture(tex, texSize, substituteLoresSize);
+}
+
 void Bitmap::taintArea(const IntRect &rect)
 {
     if (hasHires()) {
@@ -2644,6 +3175,9 @@ void Bitmap::releaseResources()
         shState->texPool().release(p->gl);
     
     delete p;
+    
+    /* Anything still showing it stops drawing it */
+    SharedState::damageScreen();
 }
 
 void Bitmap::loresDisposal()
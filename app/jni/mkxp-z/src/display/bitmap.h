@@ -32,6 +32,7 @@ class Font;
 class ShaderBase;
 struct TEXFBO;
 struct SDL_Surface;
+namespace TEX { struct ID; }
 
 struct BitmapPrivate;
 // FIXME make this class use proper RGSS classes again
@@ -94,6 +95,11 @@ public:
 
 	Color getPixel(int x, int y) const;
 	void setPixel(int x, int y, const Color &color);
+
+	/* Starts reading back the parts of the bitmap that changed
+	 * since the last getPixel/getRaw, so a later call doesn't
+	 * stall on the GPU. Does nothing without pixel buffer support */
+	void prefetchPixels();
     
     bool getRaw(void *output, int output_size);
     void replaceRaw(void *pixel_data, int size);
@@ -160,6 +166,10 @@ public:
 	 * texture size uniform in shader */
 	void bindTex(ShaderBase &shader, bool substituteLoresSize = true);
 
+	/* Reports what bindTex() would bind, without touching
+	 * any GL state */
+	void getTex(TEX::ID &tex, Vec2i &texSize, bool substituteLoresSize = true);
+
 	/* Adds 'rect' to tainted area */
 	void taintArea(const IntRect &rect);
 
@@ -24,6 +24,7 @@
 
 #include "etc.h"
 #include "etc-internal.h"
+#include "sharedstate.h"
 
 class Flashable
 {
@@ -45,6 +46,8 @@ public:
 		this->duration = duration;
 		counter = 0;
 
+		SharedState::damageScreen();
+
 		if (!color)
 		{
 			emptyFlashFlag = true;
@@ -60,6 +63,8 @@ public:
 		if (!flashing)
 			return;
 
+		SharedState::damageScreen();
+
 		if (++counter > duration)
 		{
 			/* Flash finished. Cleanup */
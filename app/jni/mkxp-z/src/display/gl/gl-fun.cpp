@@ -177,6 +177,15 @@ void initGLFunctions()
         GL_VAO_FUN;
     }
     
+    /* Buffer mapping entrypoints, used for
+     * asynchronous readback into pixel buffers */
+    if (glMajor >= 3 || (!gles && HAVE_EXT(ARB_map_buffer_range)))
+    {
+#undef EXT_SUFFIX
+#define EXT_SUFFIX ""
+        GL_MAP_BUFFER_FUN;
+    }
+    
     /* Debug callback entrypoints */
     if (HAVE_EXT(KHR_debug))
     {
@@ -202,6 +211,9 @@ void initGLFunctions()
     if (!gles || glMajor >= 3 || HAVE_EXT(EXT_unpack_subimage))
         gl.unpack_subimage = true;
     
+    if (!gles || glMajor >= 3 || HAVE_EXT(NV_pack_subimage))
+        gl.pack_subimage = true;
+    
     if (!gles || glMajor >= 3 || HAVE_EXT(OES_texture_npot))
         gl.npot_repeat = true;
 }
@@ -204,6 +204,9 @@ typedef struct GenericBO<GL_ARRAY_BUFFER> VBO;
 /* Index Buffer Object */
 typedef struct GenericBO<GL_ELEMENT_ARRAY_BUFFER> IBO;
 
+/* Pixel Buffer Object (readback target) */
+typedef struct GenericBO<GL_PIXEL_PACK_BUFFER> PBO;
+
 #undef DEF_GL_ID
 
 /* Convenience struct wrapping a framebuffer
@@ -21,6 +21,8 @@
 
 #include "scene.h"
 #include "sharedstate.h"
+#include "spritebatch.h"
+#include "config.h"
 
 Scene::Scene()
 {}
@@ -36,45 +38,58 @@ Scene::~Scene()
 	}
 }
 
-void Scene::insert(SceneElement &element)
+bool Scene::ElementLess::operator()(const SceneElement *a,
+                                    const SceneElement *b) const
 {
-	IntruListLink<SceneElement> *iter;
+	return *a < *b;
+}
 
-	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
-	{
-		SceneElement *e = iter->data;
+void Scene::insert(SceneElement &element)
+{
+	Order::iterator iter = order.insert(&element).first;
+	element.orderIter = iter;
 
-		if (element < *e)
-		{
-			elements.insertBefore(element.link, *iter);
-			return;
-		}
-	}
+	/* The list mirrors the ordered set, so the element
+	 * goes right before its successor there */
+	if (++iter == order.end())
+		elements.append(element.link);
+	else
+		elements.insertBefore(element.link, (*iter)->link);
 
-	elements.append(element.link);
+	SharedState::damageScreen();
 }
 
-void Scene::insertAfter(SceneElement &element, SceneElement &after)
+void Scene::remove(SceneElement &element)
 {
-	IntruListLink<SceneElement> *iter;
-
-	for (iter = &after.link; iter != elements.end(); iter = iter->next)
-	{
-		SceneElement *e = iter->data;
+	if (!element.link.next)
+		return;
 
-		if (element < *e)
-		{
-			elements.insertBefore(element.link, *iter);
-			return;
-		}
-	}
+	elements.remove(element.link);
+	order.erase(element.orderIter);
 
-	elements.append(element.link);
+	SharedState::damageScreen();
 }
 
 void Scene::reinsert(SceneElement &element)
 {
-	elements.remove(element.link);
+	if (!element.link.next)
+	{
+		insert(element);
+		return;
+	}
+
+	IntruListLink<SceneElement> *prev = element.link.prev;
+	IntruListLink<SceneElement> *next = element.link.next;
+
+	/* Most changes (eg. a sprite moving a few pixels)
+	 * leave the element between its neighbours */
+	if ((prev == elements.end() || *prev->data < element) &&
+	    (next == elements.end() || element < *next->data))
+		return;
+
+	/* Erasing by iterator doesn't compare keys, so the
+	 * stale entry can be dropped even though they changed */
+	remove(element);
 	insert(element);
 }
 
@@ -82,6 +97,8 @@ void Scene::notifyGeometryChange()
 {
 	IntruListLink<SceneElement> *iter;
 
+	SharedState::damageScreen();
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		iter->data->onGeometryChange(geometry);
@@ -92,13 +109,25 @@ void Scene::composite()
 {
 	IntruListLink<SceneElement> *iter;
 
+	SpriteBatch &batch = shState->spriteBatch();
+	const bool batching = shState->config().spriteBatching;
+
 	for (iter = elements.begin(); iter != elements.end(); iter = iter->next)
 	{
 		SceneElement *e = iter->data;
 
-		if (e->visible)
-			e->draw();
+		if (!e->visible)
+			continue;
+
+		if (batching && e->drawBatched(batch))
+			continue;
+
+		batch.interrupt();
+		e->draw();
 	}
+
+	/* Whoever composited us may change GL state next */
+	batch.flush();
 }
 
 
@@ -158,7 +187,11 @@ void SceneElement::setVisible(bool value)
 {
 	aboutToAccess();
 
+	if (visible == value)
+		return;
+
 	visible = value;
+	SharedState::damageScreen();
 }
 
 bool SceneElement::operator<(const SceneElement &o) const
@@ -198,5 +231,5 @@ void SceneElement::setSpriteY(int value)
 void SceneElement::unlink()
 {
 	if (scene)
-		scene->elements.remove(link);
+		scene->remove(*this);
 }
@@ -23,11 +23,15 @@
 #define SCENE_H
 
 #include "src/util/util.h"
+#include "sharedstate.h"
 #include "intrulist.h"
 #include "etc.h"
 #include "etc-internal.h"
 
+#include <set>
+
 class SceneElement;
+class SpriteBatch;
 class Viewport;
 class WindowVX;
 class Window;
@@ -62,14 +66,25 @@ public:
 	const Geometry &getGeometry() const { return geometry; }
 
 protected:
+	struct ElementLess
+	{
+		bool operator()(const SceneElement *a, const SceneElement *b) const;
+	};
+
+	/* Elements ordered by SceneElement::operator<, used to
+	 * find an element's place in 'elements' in O(log n) */
+	typedef std::set<SceneElement*, ElementLess> Order;
+
 	void insert(SceneElement &element);
-	void insertAfter(SceneElement &element, SceneElement &after);
+	void remove(SceneElement &element);
+	/* Call after changing an element's z or spriteY */
 	void reinsert(SceneElement &element);
 
 	/* Notify all elements that geometry has changed */
 	void notifyGeometryChange();
 
 	IntruList<SceneElement> elements;
+	Order order;
 	Geometry geometry;
 
 	friend class SceneElement;
@@ -112,6 +127,11 @@ protected:
 	 */
 	virtual void draw() = 0;
 
+	/* Elements that can be merged with their neighbours queue
+	 * their geometry into 'batch' here and return true. Returning
+	 * false makes the Scene flush the batch and call draw() */
+	virtual bool drawBatched(SpriteBatch &) { return false; }
+
 	// FIXME: This should be a signal
 	virtual void onGeometryChange(const Scene::Geometry &) {}
 
@@ -123,6 +143,7 @@ protected:
 	void unlink();
 
 	IntruListLink<SceneElement> link;
+	Scene::Order::iterator orderIter;
 	const unsigned int creationStamp;
 	int z;
 	bool visible;
@@ -152,4 +173,17 @@ private:
 #define ABOUT_TO_ACCESS_DISP \
 	void aboutToAccess() const { guardDisposed(); }
 
+/* Like DEF_ATTR_SIMPLE, for attributes that affect how an
+ * element is drawn: assigning a new value damages the screen */
+#define DEF_ATTR_SIMPLE_DAMAGE(klass, name, type, location) \
+	DEF_ATTR_RD_SIMPLE(klass, name, type, location) \
+	void klass :: set##name(type value) \
+{ \
+	guardDisposed(); \
+	if (location == value) \
+		return; \
+	location = value; \
+	SharedState::damageScreen(); \
+}
+
 #endif // SCENE_H
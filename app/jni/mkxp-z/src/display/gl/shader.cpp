@@ -39,6 +39,7 @@
 #include "bitmapBlit.frag.xxd"
 #include "plane.frag.xxd"
 #include "gray.frag.xxd"
+#include "viewportEffect.frag.xxd"
 #include "flatColor.frag.xxd"
 #include "simple.frag.xxd"
 #include "simpleColor.frag.xxd"
@@ -670,6 +671,39 @@ void GrayShader::setGray(float value)
 }
 
 
+ViewportEffectShader::ViewportEffectShader()
+{
+	INIT_SHADER(simple, viewportEffect, ViewportEffectShader);
+
+	ShaderBase::init();
+
+	GET_U(tone);
+	GET_U(color);
+	GET_U(flash);
+}
+
+bool ViewportEffectShader::framebufferScalingAllowed()
+{
+	// Same as GrayShader, the input is the already scaled screen.
+	return false;
+}
+
+void ViewportEffectShader::setTone(const Vec4 &value)
+{
+	setVec4Uniform(u_tone, value);
+}
+
+void ViewportEffectShader::setColor(const Vec4 &value)
+{
+	setVec4Uniform(u_color, value);
+}
+
+void ViewportEffectShader::setFlash(const Vec4 &value)
+{
+	setVec4Uniform(u_flash, value);
+}
+
+
 TilemapShader::TilemapShader()
 {
 	INIT_SHADER(tilemap, tilemap, TilemapShader);
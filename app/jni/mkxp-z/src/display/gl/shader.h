@@ -234,6 +234,24 @@ private:
 	GLint u_gray;
 };
 
+/* Applies all viewport effects (gray, tone, color and
+ * flash) to a copy of the screen in a single pass */
+class ViewportEffectShader : public ShaderBase
+{
+public:
+	ViewportEffectShader();
+
+	void setTone(const Vec4 &value);
+	void setColor(const Vec4 &value);
+	void setFlash(const Vec4 &value);
+
+protected:
+	virtual bool framebufferScalingAllowed();
+
+private:
+	GLint u_tone, u_color, u_flash;
+};
+
 class TilemapShader : public ShaderBase
 {
 public:
@@ -410,6 +428,7 @@ struct ShaderSet
 	SpriteShader sprite;
 	PlaneShader plane;
 	GrayShader gray;
+	ViewportEffectShader viewportEffect;
 	TilemapShader tilemap;
 	FlashMapShader flashMap;
 	TransShader trans;
@@ -0,0 +1,162 @@
+/*
+** spritebatch.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spritebatch.h"
+
+#include "sharedstate.h"
+#include "global-ibo.h"
+#include "glstate.h"
+#include "shader.h"
+#include "src/util/util.h"
+
+/* Size of the stream buffer in quads, which also caps a single
+ * batch. Must stay well below what 16 bit indices can address */
+static const size_t streamQuads = 4096;
+
+SpriteBatch::SpriteBatch()
+    : bufferQuads(streamQuads),
+      cursor(0),
+      blendType(BlendNormal),
+      smooth(false),
+      current(),
+      lastFrame()
+{
+	vertices.reserve(bufferQuads * 4);
+
+	vbo = VBO::gen();
+
+	GLMeta::vaoFillInVertexData<Vertex>(vao);
+	vao.vbo = vbo;
+	vao.ibo = shState->globalIBO().ibo;
+
+	GLMeta::vaoInit(vao, true);
+	VBO::allocEmpty(bufferQuads * 4 * sizeof(Vertex), GL_STREAM_DRAW);
+	GLMeta::vaoUnbind(vao);
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	GLMeta::vaoFini(vao);
+	VBO::del(vbo);
+}
+
+void SpriteBatch::add(TEX::ID tex, const Vec2i &texSize, BlendType blendType,
+                      bool smooth, const Vertex vert[4])
+{
+	if (!vertices.empty())
+	{
+		if (tex != this->tex || texSize != this->texSize ||
+		    blendType != this->blendType || smooth != this->smooth)
+		{
+			flush();
+			++current.batchBreaks;
+		}
+		else if (vertices.size() == bufferQuads * 4)
+		{
+			flush();
+		}
+	}
+
+	if (vertices.empty())
+	{
+		this->tex = tex;
+		this->texSize = texSize;
+		this->blendType = blendType;
+		this->smooth = smooth;
+	}
+
+	vertices.insert(vertices.end(), vert, vert + 4);
+	++current.quads;
+}
+
+void SpriteBatch::upload(size_t count)
+{
+	VBO::bind(vbo);
+
+	if (cursor + count > bufferQuads)
+	{
+		/* Orphan the old storage instead of overwriting it;
+		 * draws still reading from it keep their copy */
+		VBO::allocEmpty(bufferQuads * 4 * sizeof(Vertex), GL_STREAM_DRAW);
+		cursor = 0;
+	}
+
+	VBO::uploadSubData(cursor * 4 * sizeof(Vertex),
+	                   count * 4 * sizeof(Vertex), dataPtr(vertices));
+
+	VBO::unbind();
+
+	shState->ensureQuadIBO(cursor + count);
+}
+
+void SpriteBatch::flush()
+{
+	if (vertices.empty())
+		return;
+
+	size_t count = vertices.size() / 4;
+	upload(count);
+
+	SimpleAlphaShader &shader = shState->shaders().simpleAlpha;
+	shader.bind();
+	shader.applyViewportProj();
+	shader.setTranslation(Vec2i());
+	shader.setTexSize(texSize);
+
+	glState.blendMode.pushSet(blendType);
+
+	TEX::bind(tex);
+	TEX::setSmooth(smooth);
+
+	GLMeta::vaoBind(vao);
+
+	const char *offset = (const char*) 0 + cursor * 6 * sizeof(index_t);
+	gl.DrawElements(GL_TRIANGLES, count * 6, _GL_INDEX_TYPE, offset);
+
+	GLMeta::vaoUnbind(vao);
+
+	if (smooth)
+		TEX::setSmooth(false);
+
+	glState.blendMode.pop();
+
+	cursor += count;
+	vertices.clear();
+
+	++current.drawCalls;
+}
+
+void SpriteBatch::interrupt()
+{
+	if (!vertices.empty())
+	{
+		flush();
+		++current.batchBreaks;
+	}
+
+	++current.drawCalls;
+}
+
+void SpriteBatch::endFrame()
+{
+	flush();
+
+	lastFrame = current;
+	current = Stats();
+}
@@ -0,0 +1,98 @@
+/*
+** spritebatch.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include "gl-util.h"
+#include "gl-meta.h"
+#include "vertex.h"
+#include "etc.h"
+#include "etc-internal.h"
+
+#include <vector>
+
+/* Collects quads of consecutive scene elements that share
+ * texture, blend type and filtering, and draws them with a
+ * single call through SimpleAlphaShader. Vertices are expected
+ * in viewport space with the opacity in the color alpha.
+ *
+ * Vertex data is streamed into one VBO: each flush appends
+ * behind the previous one, and the buffer is orphaned once
+ * it wraps around, so the driver never has to wait on a
+ * draw that is still in flight. */
+class SpriteBatch
+{
+public:
+	struct Stats
+	{
+		/* Flushed batches plus one per element drawn
+		 * outside of the batch (viewports included) */
+		unsigned int drawCalls;
+		/* Batches cut short because the next element's
+		 * state differed or it couldn't be batched */
+		unsigned int batchBreaks;
+		/* Quads that went through the batch */
+		unsigned int quads;
+	};
+
+	SpriteBatch();
+	~SpriteBatch();
+
+	/* Queues one quad; flushes first if the current batch
+	 * was started with different state */
+	void add(TEX::ID tex, const Vec2i &texSize, BlendType blendType,
+	         bool smooth, const Vertex vert[4]);
+
+	/* Draws whatever is queued. Must be called before any
+	 * GL state the batch depends on changes */
+	void flush();
+
+	/* Flushes ahead of an element that draws on its own,
+	 * and counts that element as one draw call */
+	void interrupt();
+
+	/* Moves the running counters into frameStats()
+	 * and starts a new frame */
+	void endFrame();
+
+	const Stats &frameStats() const { return lastFrame; }
+
+private:
+	void upload(size_t count);
+
+	std::vector<Vertex> vertices;
+
+	VBO::ID vbo;
+	GLMeta::VAO vao;
+
+	/* Capacity and write position of the stream buffer, in quads */
+	size_t bufferQuads;
+	size_t cursor;
+
+	TEX::ID tex;
+	Vec2i texSize;
+	BlendType blendType;
+	bool smooth;
+
+	Stats current;
+	Stats lastFrame;
+};
+
+#endif // SPRITEBATCH_H
@@ -24,106 +24,113 @@
 #include "sharedstate.h"
 #include "glstate.h"
 #include "boost-hash.h"
+#include "intrulist.h"
 #include "debugwriter.h"
 
-#include <list>
 #include <utility>
 #include <assert.h>
 #include <string.h>
 
 typedef std::pair<uint16_t, uint16_t> Size;
 
-static uint32_t byteCount(Size &s)
+static uint64_t byteCount(const Size &s)
 {
-	return s.first * s.second * 4;
+	return (uint64_t) s.first * s.second * 4;
 }
 
 struct CacheNode
 {
 	TEXFBO obj;
-	std::list<TEXFBO>::iterator prioIter;
 
-	bool operator==(const CacheNode &o) const
-	{
-		return obj == o.obj;
-	}
+	/* Position in the release order
+	 * and in the exact size bucket */
+	IntruListLink<CacheNode> prioLink;
+	IntruListLink<CacheNode> sizeLink;
+
+	CacheNode(const TEXFBO &obj)
+	    : obj(obj),
+	      prioLink(this),
+	      sizeLink(this)
+	{}
 };
 
-typedef std::list<CacheNode> CNodeList;
+typedef IntruList<CacheNode> CNodeList;
 
 struct TexPoolPrivate
 {
 	/* Contains all cached TexFBOs, grouped by size */
-	BoostHash<Size, CNodeList> poolHash;
+	BoostHash<Size, CNodeList> sizeHash;
 
-	/* Contains all cached TexFBOs, sorted by release time */
-	std::list<TEXFBO> priorityQueue;
+	/* Contains all cached TexFBOs, most recently released first */
+	CNodeList priorityQueue;
 
 	/* Maximal allowed cache memory */
-	const uint32_t maxMemSize;
+	const uint64_t maxMemSize;
 
 	/* Current amound of memory consumed by the cache */
-	uint32_t memSize;
+	uint64_t memSize;
 
-	/* Current amount of TexFBOs cached */
-	uint16_t objCount;
+	TexPool::Stats stats;
 
 	/* Has this pool been disabled? */
 	bool disabled;
 
-	TexPoolPrivate(uint32_t maxMemSize)
+	TexPoolPrivate(uint64_t maxMemSize)
 	    : maxMemSize(maxMemSize),
 	      memSize(0),
-	      objCount(0),
+	      stats(),
 	      disabled(false)
 	{}
+
+	/* Takes a node out of every list in O(1)
+	 * and hands back its texture */
+	TEXFBO take(CacheNode *node)
+	{
+		Size size(node->obj.width, node->obj.height);
+
+		priorityQueue.remove(node->prioLink);
+		sizeHash[size].remove(node->sizeLink);
+
+		memSize -= byteCount(size);
+
+		TEXFBO obj = node->obj;
+		delete node;
+
+		return obj;
+	}
 };
 
-TexPool::TexPool(uint32_t maxMemSize)
+TexPool::TexPool(uint64_t maxMemSize)
 {
 	p = new TexPoolPrivate(maxMemSize);
 }
 
 TexPool::~TexPool()
 {
-	std::list<TEXFBO>::iterator iter;
-
-	for (iter = p->priorityQueue.begin();
-	     iter != p->priorityQueue.end();
-	     ++iter)
+	while (CacheNode *node = p->priorityQueue.tail())
 	{
-		TEXFBO obj = *iter;
+		TEXFBO obj = p->take(node);
 		TEXFBO::fini(obj);
-		--p->objCount;
 	}
 
-	assert(p->objCount == 0);
+	assert(p->memSize == 0);
 
 	delete p;
 }
 
 TEXFBO TexPool::request(int width, int height)
 {
-	CacheNode cnode;
 	Size size(width, height);
 
 	/* See if we can statisfy request from cache */
-	CNodeList &bucket = p->poolHash[size];
-
-	if (!bucket.empty())
+	if (CacheNode *node = p->sizeHash[size].tail())
 	{
 		/* Found one! */
-		cnode = bucket.back();
-		bucket.pop_back();
-
-		p->priorityQueue.erase(cnode.prioIter);
-
-		p->memSize -= byteCount(size);
-		--p->objCount;
+		++p->stats.hits;
 
 //		Debug() << "TexPool: <?+> (" << width << height << ")";
 
-		return cnode.obj;
+		return p->take(node);
 	}
 
 	int maxSize = glState.caps.maxTexSize;
@@ -133,13 +140,16 @@ TEXFBO TexPool::request(int width, int height)
 		                width, height);
 
 	/* Nope, create it instead */
-	TEXFBO::init(cnode.obj);
-	TEXFBO::allocEmpty(cnode.obj, width, height);
-	TEXFBO::linkFBO(cnode.obj);
+	++p->stats.misses;
+
+	TEXFBO obj;
+	TEXFBO::init(obj);
+	TEXFBO::allocEmpty(obj, width, height);
+	TEXFBO::linkFBO(obj);
 
 //	Debug() << "TexPool: <?-> (" << width << height << ")";
 
-	return cnode.obj;
+	return obj;
 }
 
 void TexPool::release(TEXFBO &obj)
@@ -160,50 +170,40 @@ void TexPool::release(TEXFBO &obj)
 
 	Size size(obj.width, obj.height);
 
-	uint32_t newMemSize = p->memSize + byteCount(size);
+	/* Reuse is off, or the object could never fit the budget;
+	 * don't flush the pool for it */
+	if (p->maxMemSize == 0 || byteCount(size) > p->maxMemSize)
+	{
+		TEXFBO::fini(obj);
+		return;
+	}
 
 	/* If caching this object would spill over the allowed memory budget,
 	 * delete least used objects until we're good again */
-	while (newMemSize > p->maxMemSize)
+	while (p->memSize + byteCount(size) > p->maxMemSize)
 	{
-		if (p->objCount == 0)
+		CacheNode *last = p->priorityQueue.tail();
+
+		if (!last)
 			break;
 
 //		Debug() << "TexPool: <!~> Size:" << p->memSize;
 
-		/* Retrieve object with lowest priority for deletion */
-		CacheNode last;
-		last.obj = p->priorityQueue.back();
-		Size removedSize(last.obj.width, last.obj.height);
-
-		CNodeList &bucket = p->poolHash[removedSize];
-
-		std::list<CacheNode>::iterator toRemove =
-		        std::find(bucket.begin(), bucket.end(), last);
-		assert(toRemove != bucket.end());
-		bucket.erase(toRemove);
+		TEXFBO removed = p->take(last);
+		TEXFBO::fini(removed);
 
-		p->priorityQueue.pop_back();
+		++p->stats.evictions;
 
-		TEXFBO::fini(last.obj);
-
-		newMemSize -= byteCount(removedSize);
-		--p->objCount;
-
-//		Debug() << "TexPool: <!-> (" << last.obj.width << last.obj.height << ")";
+//		Debug() << "TexPool: <!-> (" << removed.width << removed.height << ")";
 	}
 
-	p->memSize = newMemSize;
-
 	/* Retain object */
-	p->priorityQueue.push_front(obj);
-	CacheNode cnode;
-	cnode.obj = obj;
-	cnode.prioIter = p->priorityQueue.begin();
-	CNodeList &bucket = p->poolHash[size];
-	bucket.push_back(cnode);
+	CacheNode *node = new CacheNode(obj);
+
+	p->priorityQueue.prepend(node->prioLink);
+	p->sizeHash[size].append(node->sizeLink);
 
-	++p->objCount;
+	p->memSize += byteCount(size);
 
 //	Debug() << "TexPool: <!+> (" << obj.width << obj.height << ") Current size:" << p->memSize;
 }
@@ -213,4 +213,13 @@ void TexPool::disable()
 	p->disabled = true;
 }
 
+TexPool::Stats TexPool::getStats() const
+{
+	Stats stats = p->stats;
+
+	stats.cachedBytes = p->memSize;
+	stats.budgetBytes = p->maxMemSize;
+	stats.cachedCount = p->priorityQueue.getSize();
 
+	return stats;
+}
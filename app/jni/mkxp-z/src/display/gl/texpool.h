@@ -24,12 +24,29 @@
 
 #include "gl-util.h"
 
+#include <stdint.h>
+
 struct TexPoolPrivate;
 
 class TexPool
 {
 public:
-	TexPool(uint32_t maxMemSize = 20000000 /* 20 MB */);
+	struct Stats
+	{
+		/* Requests served by a cached texture of the exact size */
+		uint64_t hits;
+		/* Requests that had to create a new texture */
+		uint64_t misses;
+		/* Cached textures deleted to stay within budget */
+		uint64_t evictions;
+
+		/* Memory held by cached (released) textures */
+		uint64_t cachedBytes;
+		uint64_t budgetBytes;
+		uint32_t cachedCount;
+	};
+
+	TexPool(uint64_t maxMemSize = 20000000 /* 20 MB */);
 	~TexPool();
 
 	TEXFBO request(int width, int height);
@@ -37,6 +54,8 @@ public:
 
 	void disable();
 
+	Stats getStats() const;
+
 private:
 	TexPoolPrivate *p;
 };
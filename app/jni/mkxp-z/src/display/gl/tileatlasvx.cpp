@@ -627,27 +627,6 @@ onTile(Reader &reader, int16_t tileID,
 	}
 }
 
-static void
-readLayer(Reader &reader, const Table &data,
-          const Table *flags, int ox, int oy, int w, int h, int z)
-{
-	/* The table autotile pattern (A2) has two quads (table
-	 * legs, etc.) which extend over the tile below. We process
-	 * the tiles in rows from bottom to top so the table extents
-	 * are added after the tile below and drawn over it. */
-
-	for (int y = h-1; y >= 0; --y)
-		for (int x = 0; x < w; ++x)
-		{
-			int16_t tileID = tableGetWrapped(data, x+ox, y+oy, z);
-
-			if (tileID <= 0)
-				continue;
-
-			onTile(reader, tileID, x, y, flags);
-		}
-}
-
 static void
 onShadowTile(Reader &reader, int8_t value,
              int x, int y)
@@ -663,28 +642,23 @@ onShadowTile(Reader &reader, int8_t value,
 	reader.onQuads(&tex, &pos, 1, false);
 }
 
-static void
-readShadowLayer(Reader &reader, const Table &data,
-                int ox, int oy, int w, int h)
+void readCell(Reader &reader, const Table &data,
+              const Table *flags, int x, int y, int z)
 {
-	for (int y = 0; y < h; ++y)
-		for (int x = 0; x < w; ++x)
-		{
-			int16_t value = tableGetWrapped(data, x+ox, y+oy, 3);
-			onShadowTile(reader, value & 0xF, x, y);
-		}
-}
+	if (z == 3)
+	{
+		if (rgssVer >= 3)
+			onShadowTile(reader, tableGetWrapped(data, x, y, 3) & 0xF, x, y);
 
-void readTiles(Reader &reader, const Table &data,
-               const Table *flags, int ox, int oy, int w, int h)
-{
-	for (int i = 0; i < 2; ++i)
-		readLayer(reader, data, flags, ox, oy, w, h, i);
+		return;
+	}
 
-	if (rgssVer >= 3)
-		readShadowLayer(reader, data, ox, oy, w, h);
+	int16_t tileID = tableGetWrapped(data, x, y, z);
+
+	if (tileID <= 0)
+		return;
 
-	readLayer(reader, data, flags, ox, oy, w, h, 2);
+	onTile(reader, tileID, x, y, flags);
 }
 
 }
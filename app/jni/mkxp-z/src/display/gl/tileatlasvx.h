@@ -58,8 +58,11 @@ struct Reader
 
 void build(TEXFBO &tf, Bitmap *bitmaps[BM_COUNT]);
 
-void readTiles(Reader &reader, const Table &data,
-               const Table *flags, int ox, int oy, int w, int h);
+/* Reads the tile at x/y in map layer 'z' (0-2), or the shadow
+ * there if 'z' is 3. Quads are positioned at x/y, which may lie
+ * outside of the map as the map data is wrapped around */
+void readCell(Reader &reader, const Table &data,
+              const Table *flags, int x, int y, int z);
 }
 
 #endif // TILEATLASVX_H
@@ -45,6 +45,7 @@
 #include "src/util/util.h"
 #include "input.h"
 #include "sprite.h"
+#include "spritebatch.h"
 
 
 #include <SDL.h>
@@ -509,6 +510,10 @@ public:
         const int w = geometry.rect.w;
         const int h = geometry.rect.h;
         
+        /* Anything damaged from here on (eg. by a running
+         * animation) shows up in the next frame, not this one */
+        SharedState::screenDamaged = false;
+        
         shState->prepareDraw();
         
         pp.startRender();
@@ -538,36 +543,51 @@ public:
         const bool colorEffect = c.w > 0;
         const bool flashEffect = f.w > 0;
         
-        if (toneGrayEffect) {
-            pp.swapRender();
+        /* Effects only ever cover the visible part of the viewport */
+        int x1 = std::max(viewpRect.x, screenRect.x);
+        int y1 = std::max(viewpRect.y, screenRect.y);
+        int x2 = std::min(viewpRect.x + viewpRect.w, screenRect.x + screenRect.w);
+        int y2 = std::min(viewpRect.y + viewpRect.h, screenRect.y + screenRect.h);
+        
+        if (x1 >= x2 || y1 >= y2)
+            return;
+        
+        const IntRect rect(x1, y1, x2 - x1, y2 - y1);
+        effectQuad.setTexPosRect(rect, rect);
+        
+        /* Tone with mixed signs needs both an additive and a
+         * subtractive blend; like gray, it is cheaper to read
+         * the screen once and apply everything in the shader */
+        const bool mixedTone = (t.x > 0 || t.y > 0 || t.z > 0) &&
+                               (t.x < 0 || t.y < 0 || t.z < 0);
+        
+        if (toneGrayEffect || mixedTone) {
+            /* Copy the affected area to the back buffer and
+             * draw it back with all effects applied at once */
+            int scaleIsSpecial = GLMeta::blitScaleIsSpecial(pp.backBuffer(), false, rect, pp.frontBuffer(), rect);
             
-            if (!viewpRect.encloses(screenRect)) {
-                /* Scissor test _does_ affect FBO blit operations,
-                 * and since we're inside the draw cycle, it will
-                 * be turned on, so turn it off temporarily */
-                glState.scissorTest.pushSet(false);
-                
-                int scaleIsSpecial = GLMeta::blitScaleIsSpecial(pp.frontBuffer(), false, geometry.rect, pp.backBuffer(), geometry.rect);
-
-                GLMeta::blitBegin(pp.frontBuffer(), false, scaleIsSpecial);
-                GLMeta::blitSource(pp.backBuffer(), scaleIsSpecial);
-                GLMeta::blitRectangle(geometry.rect, Vec2i());
-                GLMeta::blitEnd();
-                
-                glState.scissorTest.pop();
-            }
+            GLMeta::blitBegin(pp.backBuffer(), false, scaleIsSpecial);
+            GLMeta::blitSource(pp.frontBuffer(), scaleIsSpecial);
+            GLMeta::blitRectangle(rect, rect.pos());
+            GLMeta::blitEnd();
+            
+            pp.startRender();
             
-            GrayShader &shader = shState->shaders().gray;
+            ViewportEffectShader &shader = shState->shaders().viewportEffect;
             shader.bind();
-            shader.setGray(t.w);
             shader.applyViewportProj();
             shader.setTexSize(screenRect.size());
+            shader.setTone(t);
+            shader.setColor(colorEffect ? c : Vec4());
+            shader.setFlash(flashEffect ? f : Vec4());
             
             TEX::bind(pp.backBuffer().tex);
             
             glState.blend.pushSet(false);
-            screenQuad.draw();
+            effectQuad.draw();
             glState.blend.pop();
+            
+            return;
         }
         
         if (!toneRGBEffect && !colorEffect && !flashEffect)
@@ -578,55 +598,40 @@ public:
         shader.applyViewportProj();
         
         if (toneRGBEffect) {
-            /* First split up additive / substractive components */
-            Vec4 add, sub;
-            
-            if (t.x > 0)
-                add.x = t.x;
-            if (t.y > 0)
-                add.y = t.y;
-            if (t.z > 0)
-                add.z = t.z;
-            
-            if (t.x < 0)
-                sub.x = -t.x;
-            if (t.y < 0)
-                sub.y = -t.y;
-            if (t.z < 0)
-                sub.z = -t.z;
+            /* All components share one sign here, so
+             * a single hardware blend applies them */
+            const bool add = t.x > 0 || t.y > 0 || t.z > 0;
             
-            /* Then apply them using hardware blending */
             gl.BlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE);
+            gl.BlendEquation(add ? GL_FUNC_ADD : GL_FUNC_REVERSE_SUBTRACT);
             
-            if (add.xyzNotNull()) {
-                gl.BlendEquation(GL_FUNC_ADD);
-                shader.setColor(add);
-                
-                screenQuad.draw();
-            }
+            if (add)
+                shader.setColor(Vec4(std::max(t.x, 0.f), std::max(t.y, 0.f), std::max(t.z, 0.f), 0));
+            else
+                shader.setColor(Vec4(std::max(-t.x, 0.f), std::max(-t.y, 0.f), std::max(-t.z, 0.f), 0));
             
-            if (sub.xyzNotNull()) {
-                gl.BlendEquation(GL_FUNC_REVERSE_SUBTRACT);
-                shader.setColor(sub);
-                
-                screenQuad.draw();
-            }
+            effectQuad.draw();
         }
         
         if (colorEffect || flashEffect) {
+            /* Blending color and then flash over the screen equals
+             * one blend of their premultiplied combination:
+             * dst * (1-ca) * (1-fa) + c * ca * (1-fa) + f * fa */
+            const float ca = colorEffect ? c.w : 0;
+            const float fa = flashEffect ? f.w : 0;
+            const float cw = ca * (1 - fa);
+            
+            Vec4 comb(c.x * cw + f.x * fa,
+                      c.y * cw + f.y * fa,
+                      c.z * cw + f.z * fa,
+                      1 - (1 - ca) * (1 - fa));
+            
             gl.BlendEquation(GL_FUNC_ADD);
-            gl.BlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO,
+            gl.BlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO,
                                  GL_ONE);
-        }
-        
-        if (colorEffect) {
-            shader.setColor(c);
-            screenQuad.draw();
-        }
-        
-        if (flashEffect) {
-            shader.setColor(f);
-            screenQuad.draw();
+            
+            shader.setColor(comb);
+            effectQuad.draw();
         }
         
         glState.blendMode.refresh();
@@ -636,13 +641,14 @@ public:
         brightnessQuad.setColor(Vec4(0, 0, 0, 1.0f - norm));
         
         brightEffect = norm < 1.0f;
+        
+        SharedState::damageScreen();
     }
     
     void updateReso(int width, int height) {
         geometry.rect.w = width;
         geometry.rect.h = height;
         
-        screenQuad.setTexPosRect(geometry.rect, geometry.rect);
         brightnessQuad.setTexPosRect(geometry.rect, geometry.rect);
         
         notifyGeometryChange();
@@ -657,7 +663,8 @@ public:
     
 private:
     PingPong pp;
-    Quad screenQuad;
+    /* Covers the viewport an effect is rendered for */
+    Quad effectQuad;
     
     Quad brightnessQuad;
     bool brightEffect;
@@ -819,6 +826,11 @@ struct GraphicsPrivate {
     TEXFBO frozenScene;
     Quad screenQuad;
     
+    /* Set when the window no longer shows the last composited
+     * frame (or needs it drawn again), so an idle frame still
+     * has to be presented */
+    bool presentDirty;
+    
     float backingScaleFactor;
     
     Vec2i integerScaleFactor;
@@ -847,6 +859,7 @@ struct GraphicsPrivate {
     glCtx(SDL_GL_GetCurrentContext()), multithreadedMode(true),
     frameRate(DEF_FRAMERATE), frameCount(0), brightness(255),
     fpsLimiter(frameRate), useFrameSkip(rtData->config.frameSkip), frozen(false),
+    presentDirty(true),
     last_update(0), last_avg_update(0), backingScaleFactor(1), integerScaleFactor(0, 0),
     integerScaleActive(rtData->config.integerScaling.active),
     integerLastMileScaling(rtData->config.integerScaling.lastMileScaling) {
@@ -987,6 +1000,8 @@ struct GraphicsPrivate {
             
             SDL_Rect screen = {scOffset.x, scOffset.y, scSize.x, scSize.y};
             threadData->ethread->notifyGameScreenChange(screen);
+            
+            presentDirty = true;
         }
     }
     
@@ -1009,6 +1024,19 @@ struct GraphicsPrivate {
         ++frameCount;
         
         threadData->ethread->notifyFrame();
+        
+        /* Only redrawScreen() presents the composited frame */
+        presentDirty = true;
+    }
+    
+    /* Stands in for swapGLBuffer() when the window already shows
+     * the current frame: pacing and the frame count carry on */
+    void skipPresent() {
+        fpsLimiter.delay();
+        
+        ++frameCount;
+        
+        threadData->ethread->notifyFrame();
     }
     
     void compositeToBuffer(TEXFBO &buffer) {
@@ -1044,7 +1072,20 @@ struct GraphicsPrivate {
     }
     
     void redrawScreen() {
-        screen.composite();
+        const Config &conf = threadData->config;
+        const bool damaged = SharedState::screenDamaged || !conf.reuseIdleFrames;
+        
+        /* Without a frame limiter, presenting is what paces us */
+        if (!damaged && !presentDirty && conf.skipIdlePresent && !fpsLimiter.disabled) {
+            skipPresent();
+            updateAvgFPS();
+            return;
+        }
+        
+        /* Otherwise the last composite is still sitting
+         * in the PingPong front buffer and can be reused */
+        if (damaged)
+            screen.composite();
         
         // maybe unspaghetti this later
         if (integerScaleStepApplicable() && !integerLastMileScaling)
@@ -1059,6 +1100,7 @@ struct GraphicsPrivate {
             GLMeta::blitEnd();
             
             swapGLBuffer();
+            presentDirty = false;
             return;
         }
         
@@ -1109,6 +1151,7 @@ struct GraphicsPrivate {
         GLMeta::blitEnd();
         
         swapGLBuffer();
+        presentDirty = false;
         
         updateAvgFPS();
     }
@@ -1125,6 +1168,7 @@ struct GraphicsPrivate {
         SDL_GL_MakeCurrent(threadData->window, glCtx);
 
         fpsLimiter.resetFrameAdjust();
+        presentDirty = true;
     }
     
     double averageFPS() {
@@ -1215,9 +1259,7 @@ void Graphics::update(bool checkForShutdown) {
     if (p->fpsLimiter.frameSkipRequired()) {
         if (p->useFrameSkip) {
             /* Skip frame */
-            p->fpsLimiter.delay();
-            ++p->frameCount;
-            p->threadData->ethread->notifyFrame();
+            p->skipPresent();
             
             return;
         } else {
@@ -1228,6 +1270,8 @@ void Graphics::update(bool checkForShutdown) {
     
     p->checkResize();
     p->redrawScreen();
+
+    shState->spriteBatch().endFrame();
 }
 
 void Graphics::freeze() {
@@ -1378,6 +1422,14 @@ double Graphics::averageFrameRate() {
     return p->averageFPS();
 }
 
+int Graphics::drawCalls() {
+    return shState->spriteBatch().frameStats().drawCalls;
+}
+
+int Graphics::batchBreaks() {
+    return shState->spriteBatch().frameStats().batchBreaks;
+}
+
 void Graphics::wait(int duration) {
     for (int i = 0; i < duration; ++i) {
         p->checkShutDownReset();
@@ -1610,6 +1662,7 @@ void Graphics::reset() {
     p->fpsLimiter.resetFrameAdjust();
     p->frozen = false;
     p->screen.getPP().clearBuffers();
+    SharedState::damageScreen();
     
     setFrameRate(DEF_FRAMERATE);
     setBrightness(255);
@@ -1663,6 +1716,7 @@ void Graphics::setFixedAspectRatio(bool value)
     p->findHighestIntegerScale();
     p->recalculateScreenSize(p->threadData->config.fixedAspectRatio);
     p->updateScreenResoRatio(p->threadData);
+    p->presentDirty = true;
 }
 
 int Graphics::getSmoothScaling() const
@@ -1674,6 +1728,7 @@ int Graphics::getSmoothScaling() const
 void Graphics::setSmoothScaling(int value)
 {
     shState->config().smoothScaling = value;
+    p->presentDirty = true;
 }
 
 bool Graphics::getIntegerScaling() const
@@ -1689,6 +1744,7 @@ void Graphics::setIntegerScaling(bool value)
     
     p->recalculateScreenSize(p->threadData->config.fixedAspectRatio);
     p->updateScreenResoRatio(p->threadData);
+    p->presentDirty = true;
 }
 
 bool Graphics::getLastMileScaling() const
@@ -1701,6 +1757,7 @@ void Graphics::setLastMileScaling(bool value)
     p->integerLastMileScaling = value;
     p->recalculateScreenSize(p->threadData->config.fixedAspectRatio);
     p->updateScreenResoRatio(p->threadData);
+    p->presentDirty = true;
 }
 
 bool Graphics::getThreadsafe() const
@@ -1765,6 +1822,8 @@ void Graphics::repaintWait(const AtomicFlag &exitCond, bool checkReset) {
     }
     
     GLMeta::blitEnd();
+    
+    p->presentDirty = true;
 }
 
 void Graphics::lock(bool force) {
@@ -88,6 +88,11 @@ public:
     DECL_ATTR( Threadsafe, bool )
     double averageFrameRate();
 
+    /* Draw calls and sprite batch breaks of the last
+     * presented frame */
+    int drawCalls();
+    int batchBreaks();
+
 	/* <internal> */
 	Scene *getScreen() const;
 	/* Repaint screen with static image until exitCond
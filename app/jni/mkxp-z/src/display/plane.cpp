@@ -174,9 +174,9 @@ DEF_ATTR_RD_SIMPLE(Plane, ZoomX,     float,   p->zoomX)
 DEF_ATTR_RD_SIMPLE(Plane, ZoomY,     float,   p->zoomY)
 DEF_ATTR_RD_SIMPLE(Plane, BlendType, int,     p->blendType)
 
-DEF_ATTR_SIMPLE(Plane, Opacity,   int,     p->opacity)
-DEF_ATTR_SIMPLE(Plane, Color,     Color&, *p->color)
-DEF_ATTR_SIMPLE(Plane, Tone,      Tone&,  *p->tone)
+DEF_ATTR_SIMPLE_DAMAGE(Plane, Opacity,   int,     p->opacity)
+DEF_ATTR_SIMPLE_DAMAGE(Plane, Color,     Color&, *p->color)
+DEF_ATTR_SIMPLE_DAMAGE(Plane, Tone,      Tone&,  *p->tone)
 
 Plane::~Plane()
 {
@@ -187,6 +187,9 @@ void Plane::setBitmap(Bitmap *value)
 {
 	guardDisposed();
 
+	if (p->bitmap != value)
+		SharedState::damageScreen();
+
 	p->bitmap = value;
 
 	p->bitmapDispCon.disconnect();
@@ -211,6 +214,7 @@ void Plane::setOX(int value)
 
 	p->ox = value;
 	p->quadSourceDirty = true;
+	SharedState::damageScreen();
 }
 
 void Plane::setOY(int value)
@@ -222,6 +226,7 @@ void Plane::setOY(int value)
 
 	p->oy = value;
 	p->quadSourceDirty = true;
+	SharedState::damageScreen();
 }
 
 void Plane::setZoomX(float value)
@@ -233,6 +238,7 @@ void Plane::setZoomX(float value)
 
 	p->zoomX = value;
 	p->quadSourceDirty = true;
+	SharedState::damageScreen();
 }
 
 void Plane::setZoomY(float value)
@@ -244,12 +250,16 @@ void Plane::setZoomY(float value)
 
 	p->zoomY = value;
 	p->quadSourceDirty = true;
+	SharedState::damageScreen();
 }
 
 void Plane::setBlendType(int value)
 {
 	guardDisposed();
 
+	if (p->blendType != value)
+		SharedState::damageScreen();
+
 	switch (value)
 	{
 	default :
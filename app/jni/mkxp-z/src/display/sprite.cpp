@@ -35,6 +35,7 @@
 #include "shader.h"
 #include "glstate.h"
 #include "quadarray.h"
+#include "spritebatch.h"
 
 #include <math.h>
 #ifndef M_PI
@@ -332,6 +333,62 @@ struct SpritePrivate
         wave.qArray.commit();
     }
     
+    bool needsEffectRender(bool flashing)
+    {
+        return color->hasEffect() ||
+        tone->hasEffect()  ||
+        flashing           ||
+        bushDepth != 0     ||
+        invert             ||
+        (pattern && !pattern->isDisposed());
+    }
+    
+    /* Filtering to use for the bitmap at the current
+     * zoom and rotation (NearestNeighbor, Bilinear, ...) */
+    int scalingMethod()
+    {
+        int scalingMethod = NearestNeighbor;
+
+        int sourceWidthHires = bitmap->hasHires() ? bitmap->getHires()->width() : bitmap->width();
+        int sourceHeightHires = bitmap->hasHires() ? bitmap->getHires()->height() : bitmap->height();
+
+        double framebufferScalingFactor = shState->config().enableHires ? shState->config().framebufferScalingFactor : 1.0;
+
+        int targetWidthHires = (int)lround(framebufferScalingFactor * bitmap->width() * trans.getScale().x);
+        int targetHeightHires = (int)lround(framebufferScalingFactor * bitmap->height() * trans.getScale().y);
+
+        int scaleIsSpecial = UpScale;
+
+        if (targetWidthHires == sourceWidthHires && targetHeightHires == sourceHeightHires)
+        {
+            scaleIsSpecial = SameScale;
+        }
+
+        if (targetWidthHires < sourceWidthHires && targetHeightHires < sourceHeightHires)
+        {
+            scaleIsSpecial = DownScale;
+        }
+
+        switch (scaleIsSpecial)
+        {
+        case SameScale:
+            scalingMethod = NearestNeighbor;
+            break;
+        case DownScale:
+            scalingMethod = shState->config().bitmapSmoothScalingDown;
+            break;
+        default:
+            scalingMethod = shState->config().bitmapSmoothScaling;
+        }
+
+        if (trans.getRotation() != 0.0)
+        {
+            scalingMethod = shState->config().bitmapSmoothScaling;
+        }
+
+        return scalingMethod;
+    }
+    
     void prepare()
     {
         if (wave.dirty)
@@ -376,18 +433,18 @@ DEF_ATTR_RD_SIMPLE(Sprite, WaveLength, int,     p->wave.length)
 DEF_ATTR_RD_SIMPLE(Sprite, WaveSpeed,  int,     p->wave.speed)
 DEF_ATTR_RD_SIMPLE(Sprite, WavePhase,  float,   p->wave.phase)
 
-DEF_ATTR_SIMPLE(Sprite, BushOpacity, int,     p->bushOpacity)
-DEF_ATTR_SIMPLE(Sprite, Opacity,     int,     p->opacity)
-DEF_ATTR_SIMPLE(Sprite, SrcRect,     Rect&,  *p->srcRect)
-DEF_ATTR_SIMPLE(Sprite, Color,       Color&, *p->color)
-DEF_ATTR_SIMPLE(Sprite, Tone,        Tone&,  *p->tone)
-DEF_ATTR_SIMPLE(Sprite, PatternTile, bool, p->patternTile)
-DEF_ATTR_SIMPLE(Sprite, PatternOpacity, int, p->patternOpacity)
-DEF_ATTR_SIMPLE(Sprite, PatternScrollX, int, p->patternScroll.x)
-DEF_ATTR_SIMPLE(Sprite, PatternScrollY, int, p->patternScroll.y)
-DEF_ATTR_SIMPLE(Sprite, PatternZoomX, float, p->patternZoom.x)
-DEF_ATTR_SIMPLE(Sprite, PatternZoomY, float, p->patternZoom.y)
-DEF_ATTR_SIMPLE(Sprite, Invert,      bool,    p->invert)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, BushOpacity, int,     p->bushOpacity)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, Opacity,     int,     p->opacity)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, SrcRect,     Rect&,  *p->srcRect)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, Color,       Color&, *p->color)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, Tone,        Tone&,  *p->tone)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, PatternTile, bool, p->patternTile)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, PatternOpacity, int, p->patternOpacity)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, PatternScrollX, int, p->patternScroll.x)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, PatternScrollY, int, p->patternScroll.y)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, PatternZoomX, float, p->patternZoom.x)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, PatternZoomY, float, p->patternZoom.y)
+DEF_ATTR_SIMPLE_DAMAGE(Sprite, Invert,      bool,    p->invert)
 
 void Sprite::setBitmap(Bitmap *bitmap)
 {
@@ -398,6 +455,8 @@ void Sprite::setBitmap(Bitmap *bitmap)
     
     p->bitmap = bitmap;
     
+    SharedState::damageScreen();
+    
     p->bitmapDispCon.disconnect();
     
     if (nullOrDisposed(bitmap))
@@ -425,6 +484,8 @@ void Sprite::setX(int value)
         return;
     
     p->trans.setPosition(Vec2(value, getY()));
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setY(int value)
@@ -441,6 +502,8 @@ void Sprite::setY(int value)
         p->wave.dirty = true;
         setSpriteY(value);
     }
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setOX(int value)
@@ -451,6 +514,8 @@ void Sprite::setOX(int value)
         return;
     
     p->trans.setOrigin(Vec2(value, getOY()));
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setOY(int value)
@@ -461,6 +526,8 @@ void Sprite::setOY(int value)
         return;
     
     p->trans.setOrigin(Vec2(getOX(), value));
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setZoomX(float value)
@@ -471,6 +538,8 @@ void Sprite::setZoomX(float value)
         return;
     
     p->trans.setScale(Vec2(value, getZoomY()));
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setZoomY(float value)
@@ -485,6 +554,8 @@ void Sprite::setZoomY(float value)
     
     if (rgssVer >= 2)
         p->wave.dirty = true;
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setAngle(float value)
@@ -495,6 +566,8 @@ void Sprite::setAngle(float value)
         return;
     
     p->trans.setRotation(value);
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setMirror(bool mirrored)
@@ -506,6 +579,8 @@ void Sprite::setMirror(bool mirrored)
     
     p->mirrored = mirrored;
     p->onSrcRectChange();
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setBushDepth(int value)
@@ -517,12 +592,17 @@ void Sprite::setBushDepth(int value)
     
     p->bushDepth = value;
     p->recomputeBushDepth();
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setBlendType(int type)
 {
     guardDisposed();
     
+    if (p->blendType != type)
+        SharedState::damageScreen();
+    
     switch (type)
     {
         default :
@@ -549,12 +629,17 @@ void Sprite::setPattern(Bitmap *value)
     
     if (!nullOrDisposed(value))
         value->ensureNonMega();
+    
+    SharedState::damageScreen();
 }
 
 void Sprite::setPatternBlendType(int type)
 {
     guardDisposed();
     
+    if (p->patternBlendType != type)
+        SharedState::damageScreen();
+    
     switch (type)
     {
         default :
@@ -578,6 +663,7 @@ if (p->wave.name == value) \
 return; \
 p->wave.name = value; \
 p->wave.dirty = true; \
+SharedState::damageScreen(); \
 }
 
 DEF_WAVE_SETTER(Amp,    amp,    int)
@@ -605,6 +691,10 @@ void Sprite::update()
     
     p->wave.phase += p->wave.speed / 180;
     p->wave.dirty = true;
+    
+    /* The phase only shows while the sprite is waving */
+    if (p->wave.amp != 0 && p->wave.speed != 0)
+        SharedState::damageScreen();
 }
 
 /* SceneElement */
@@ -618,51 +708,12 @@ void Sprite::draw()
     
     ShaderBase *base;
     
-    bool renderEffect = p->color->hasEffect() ||
-    p->tone->hasEffect()  ||
-    flashing              ||
-    p->bushDepth != 0     ||
-    p->invert             ||
-    (p->pattern && !p->pattern->isDisposed());
+    bool renderEffect = p->needsEffectRender(flashing);
     
-    int scalingMethod = NearestNeighbor;
-
     int sourceWidthHires = p->bitmap->hasHires() ? p->bitmap->getHires()->width() : p->bitmap->width();
     int sourceHeightHires = p->bitmap->hasHires() ? p->bitmap->getHires()->height() : p->bitmap->height();
 
-    double framebufferScalingFactor = shState->config().enableHires ? shState->config().framebufferScalingFactor : 1.0;
-
-    int targetWidthHires = (int)lround(framebufferScalingFactor * p->bitmap->width() * p->trans.getScale().x);
-    int targetHeightHires = (int)lround(framebufferScalingFactor * p->bitmap->height() * p->trans.getScale().y);
-
-    int scaleIsSpecial = UpScale;
-
-    if (targetWidthHires == sourceWidthHires && targetHeightHires == sourceHeightHires)
-    {
-        scaleIsSpecial = SameScale;
-    }
-
-    if (targetWidthHires < sourceWidthHires && targetHeightHires < sourceHeightHires)
-    {
-        scaleIsSpecial = DownScale;
-    }
-
-    switch (scaleIsSpecial)
-    {
-    case SameScale:
-        scalingMethod = NearestNeighbor;
-        break;
-    case DownScale:
-        scalingMethod = shState->config().bitmapSmoothScalingDown;
-        break;
-    default:
-        scalingMethod = shState->config().bitmapSmoothScaling;
-    }
-
-    if (p->trans.getRotation() != 0.0)
-    {
-        scalingMethod = shState->config().bitmapSmoothScaling;
-    }
+    int scalingMethod = p->scalingMethod();
 
     if (renderEffect)
     {
@@ -804,6 +855,46 @@ void Sprite::draw()
     glState.blendMode.pop();
 }
 
+bool Sprite::drawBatched(SpriteBatch &batch)
+{
+    if (!p->isVisible || emptyFlashFlag)
+        return true;
+    
+    /* Only the plain shaders reduce to SimpleAlphaShader */
+    if (p->wave.active || p->needsEffectRender(flashing))
+        return false;
+    
+    int scalingMethod = p->scalingMethod();
+    
+    if (scalingMethod != NearestNeighbor &&
+        (scalingMethod != Bilinear || p->opacity != 255))
+        return false;
+    
+    TEX::ID tex;
+    Vec2i texSize;
+    p->bitmap->getTex(tex, texSize, false);
+    
+    /* Apply the sprite matrix on the CPU, as the batch
+     * can't carry a per-sprite uniform */
+    const float *m = p->trans.getMatrix();
+    const Vec4 color(1, 1, 1, p->opacity.norm);
+    Vertex vert[4];
+    
+    for (int i = 0; i < 4; ++i)
+    {
+        const Vec2 &pos = p->quad.vert[i].pos;
+        
+        vert[i].pos = Vec2(m[0] * pos.x + m[4] * pos.y + m[12],
+                           m[1] * pos.x + m[5] * pos.y + m[13]);
+        vert[i].texPos = p->quad.vert[i].texPos;
+        vert[i].color = color;
+    }
+    
+    batch.add(tex, texSize, p->blendType, scalingMethod == Bilinear, vert);
+    
+    return true;
+}
+
 void Sprite::onGeometryChange(const Scene::Geometry &geo)
 {
     /* Offset at which the sprite will be drawn
@@ -0,0 +1,182 @@
+/*
+** textatlas.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "textatlas.h"
+
+#include "bitmap.h"
+#include "gl-util.h"
+#include "glstate.h"
+
+#include <SDL_surface.h>
+
+#include <algorithm>
+#include <functional>
+
+static const size_t maxPages = 2;
+static const int maxPageSize = 1024;
+
+bool TextAtlas::Key::operator==(const Key &o) const
+{
+	return font == o.font && style == o.style && solid == o.solid &&
+	       shadow == o.shadow && outline == o.outline &&
+	       color == o.color && outColor == o.outColor && text == o.text;
+}
+
+size_t TextAtlas::KeyHash::operator()(const Key &key) const
+{
+	size_t h = std::hash<std::string>()(key.text);
+
+	size_t state = std::hash<const void*>()(key.font);
+	state = state * 31 + key.style;
+	state = state * 31 + (key.solid << 1 | key.shadow);
+	state = state * 31 + key.outline;
+	state = state * 31 + key.color;
+	state = state * 31 + key.outColor;
+
+	return h ^ (state + 0x9e3779b9 + (h << 6) + (h >> 2));
+}
+
+TextAtlas::TextAtlas()
+    : pageSize(0),
+      nextReset(0)
+{}
+
+TextAtlas::~TextAtlas()
+{
+	for (size_t i = 0; i < pages.size(); ++i)
+		delete pages[i].bitmap;
+}
+
+const TextAtlas::Entry *TextAtlas::find(const Key &key) const
+{
+	std::unordered_map<Key, Entry, KeyHash>::const_iterator iter = entries.find(key);
+
+	if (iter == entries.end())
+		return 0;
+
+	return &iter->second;
+}
+
+const TextAtlas::Entry *TextAtlas::insert(const Key &key, SDL_Surface *surf, int rawHeight)
+{
+	if (pageSize == 0)
+		pageSize = std::min(maxPageSize, glState.caps.maxTexSize);
+
+	/* Runs are separated by (and pages start with) one row and
+	 * column of transparent pixels, so that filtering a squeezed
+	 * run never picks up its neighbours */
+	int w = surf->w + 1;
+	int h = surf->h + 1;
+
+	if (w + 1 > pageSize || h + 1 > pageSize)
+		return 0;
+
+	if (surf->pitch != surf->w * 4)
+		return 0;
+
+	int x, y;
+	size_t index = 0;
+
+	for (; index < pages.size(); ++index)
+		if (place(pages[index], w, h, x, y))
+			break;
+
+	if (index == pages.size())
+	{
+		if (pages.size() < maxPages)
+		{
+			Page page;
+			page.bitmap = new Bitmap(pageSize, pageSize, true);
+			page.nextY = 1;
+			pages.push_back(page);
+		}
+		else
+		{
+			index = nextReset;
+			nextReset = (nextReset + 1) % pages.size();
+			resetPage(index);
+		}
+
+		place(pages[index], w, h, x, y);
+	}
+
+	Page &page = pages[index];
+
+	TEX::bind(page.bitmap->getGLTypes().tex);
+	TEX::uploadSubImage(x, y, surf->w, surf->h, surf->pixels, GL_RGBA);
+
+	Entry entry;
+	entry.page = page.bitmap;
+	entry.rect = IntRect(x, y, surf->w, surf->h);
+	entry.rawHeight = rawHeight;
+
+	return &(entries[key] = entry);
+}
+
+bool TextAtlas::place(Page &page, int w, int h, int &x, int &y)
+{
+	for (size_t i = 0; i < page.shelves.size(); ++i)
+	{
+		Shelf &shelf = page.shelves[i];
+
+		/* Don't waste tall shelves on much smaller runs */
+		if (shelf.h < h || shelf.h > h + h / 4)
+			continue;
+
+		if (shelf.x + w > pageSize)
+			continue;
+
+		x = shelf.x;
+		y = shelf.y;
+		shelf.x += w;
+
+		return true;
+	}
+
+	if (page.nextY + h > pageSize)
+		return false;
+
+	Shelf shelf = { page.nextY, h, 1 + w };
+	page.shelves.push_back(shelf);
+	page.nextY += h;
+
+	x = 1;
+	y = shelf.y;
+
+	return true;
+}
+
+void TextAtlas::resetPage(size_t index)
+{
+	Page &page = pages[index];
+
+	page.bitmap->clear();
+	page.shelves.clear();
+	page.nextY = 1;
+
+	std::unordered_map<Key, Entry, KeyHash>::iterator iter = entries.begin();
+
+	while (iter != entries.end())
+	{
+		if (iter->second.page == page.bitmap)
+			iter = entries.erase(iter);
+		else
+			++iter;
+	}
+}
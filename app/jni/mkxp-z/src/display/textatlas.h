@@ -0,0 +1,113 @@
+/*
+** textatlas.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEXTATLAS_H
+#define TEXTATLAS_H
+
+#include "etc-internal.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class Bitmap;
+struct SDL_Surface;
+struct _TTF_Font;
+
+/* Keeps the text rendered by Bitmap::drawText in a few atlas
+ * pages, so drawing the same string with the same font state
+ * again only costs a blit from the page.
+ *
+ * Whole runs are cached instead of single glyphs: SDL_ttf
+ * applies kerning and composes overlapping glyphs on the
+ * complete string, and the shadow and outline passes work on
+ * that result too. Reusing the finished run is the only way
+ * to keep the output identical to rendering it afresh. */
+class TextAtlas
+{
+public:
+	struct Key
+	{
+		_TTF_Font *font;
+		int style;
+		bool solid;
+		bool shadow;
+		/* Outline size in pixels, 0 if disabled */
+		int outline;
+		/* RGB only; the text opacity is applied when blitting */
+		uint32_t color;
+		uint32_t outColor;
+		std::string text;
+
+		bool operator==(const Key &o) const;
+	};
+
+	struct Entry
+	{
+		Bitmap *page;
+		IntRect rect;
+		/* Height of the text before shadow and
+		 * outline were added, used for alignment */
+		int rawHeight;
+	};
+
+	TextAtlas();
+	~TextAtlas();
+
+	/* Returned entries stay valid until the next insert() */
+	const Entry *find(const Key &key) const;
+
+	/* Copies 'surf' (ABGR8888) into a page, making room by
+	 * clearing the least recently started page if needed.
+	 * Returns null if the run can't be cached at all */
+	const Entry *insert(const Key &key, SDL_Surface *surf, int rawHeight);
+
+private:
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const;
+	};
+
+	/* Pages are filled shelf by shelf, top to bottom */
+	struct Shelf
+	{
+		int y, h;
+		int x;
+	};
+
+	struct Page
+	{
+		Bitmap *bitmap;
+		std::vector<Shelf> shelves;
+		int nextY;
+	};
+
+	bool place(Page &page, int w, int h, int &x, int &y);
+	void resetPage(size_t index);
+
+	std::unordered_map<Key, Entry, KeyHash> entries;
+	std::vector<Page> pages;
+
+	int pageSize;
+	/* Page that is cleared next once all of them are full */
+	size_t nextReset;
+};
+
+#endif // TEXTATLAS_H
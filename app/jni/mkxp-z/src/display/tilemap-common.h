@@ -35,6 +35,7 @@
 
 #include <stdint.h>
 #include <assert.h>
+#include <algorithm>
 #include <vector>
 
 #include "sigslot/signal.hpp"
@@ -61,6 +62,18 @@ tableGetWrapped(const Table &t, int x, int y, int z = 0)
 	             z);
 }
 
+/* Smallest rectangle enclosing both 'a' and 'b' */
+static inline IntRect
+uniteRects(const IntRect &a, const IntRect &b)
+{
+	int x1 = std::min(a.x, b.x);
+	int y1 = std::min(a.y, b.y);
+	int x2 = std::max(a.x + a.w, b.x + b.w);
+	int y2 = std::max(a.y + a.h, b.y + b.h);
+
+	return IntRect(x1, y1, x2 - x1, y2 - y1);
+}
+
 /* Calculate the tile x/y on which this pixel x/y lies */
 static inline Vec2i
 getTilePos(const Vec2i &pixelPos)
@@ -143,7 +156,7 @@ struct FlashMap
 
 		data = value;
 		dataCon.disconnect();
-		dirty = true;
+		setDirty();
 
 		if (!data)
 			return;
@@ -153,6 +166,12 @@ struct FlashMap
         dataCon = data->modified.connect(&FlashMap::setDirty, this);
 	}
 
+	/* Whether the blinking flash currently shows anything */
+	bool animating() const
+	{
+		return dirty || quadCount() > 0;
+	}
+
 	void setViewport(const IntRect &value)
 	{
 		viewp = value;
@@ -195,6 +214,7 @@ private:
 	void setDirty()
 	{
 		dirty = true;
+		SharedState::damageScreen();
 	}
 
 	size_t quadCount() const
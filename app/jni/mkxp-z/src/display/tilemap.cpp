@@ -72,6 +72,11 @@ static const int viewpH = 16;
 
 static const size_t zlayersMax = viewpH + 5;
 
+/* Size of the ground ring buffer in tiles. The map
+ * viewport window includes both its edges, hence +1 */
+static const int ringW = viewpW + 1;
+static const int ringH = viewpH + 1;
+
 /* Vocabulary:
  *
  * Atlas: A texture containing both the tileset and all
@@ -152,8 +157,10 @@ static const size_t zlayersMax = viewpH + 5;
  *   This rectangle describes the subregion of the map that is
  *   actually translated to vertices and stored on the GPU ready
  *   for rendering. Whenever, ox/oy are modified, its position is
- *   adjusted if necessary and the data is regenerated. Its size
- *   is fixed. This is NOT related to the RGSS Viewport class!
+ *   adjusted if necessary and the tiles that came into view are
+ *   generated (the ground layer is a ring buffer, see
+ *   'groundVert'). Its size is fixed. This is NOT related to
+ *   the RGSS Viewport class!
  *
  */
 
@@ -227,7 +234,7 @@ struct ZLayer : public ViewportElement
 	static int calculateZ(TilemapPrivate *p, int index);
 
 	void initUpdateZ();
-	void finiUpdateZ(ZLayer *prev);
+	void finiUpdateZ();
 
 	ABOUT_TO_ACCESS_NOOP
 };
@@ -274,12 +281,43 @@ struct TilemapPrivate
 	/* Map viewport position */
 	Vec2i viewpPos;
 
-	/* Ground layer vertices */
+	/* Ground layer vertices, kept as a ring buffer over the map
+	 * viewport: a tile lives in the cell at its map position
+	 * modulo the ring size, and every cell has the same number
+	 * of quad slots (unused ones stay degenerate). Tiles are
+	 * placed at their map position, so when the viewport scrolls
+	 * only the cells that came into view are rebuilt and
+	 * uploaded, and the draw translation does the rest */
 	SVVector groundVert;
+	size_t groundCellQuads;
+
+	/* Quads in use per ground cell, and in total */
+	uint8_t groundUsed[ringW*ringH];
+	size_t groundQuads;
+
+	/* Ground cells not uploaded yet, as
+	 * column span [x1, x2) per ring row */
+	struct
+	{
+		int x1, x2;
+	} groundDirty[ringH];
+
+	/* Tiles with a priority above 0, per ring cell. The
+	 * zlayers are assembled from these after a scroll */
+	struct ZQuad
+	{
+		int prio;
+		SVertex v[4];
+	};
+
+	std::vector<ZQuad> zquadCells[ringW*ringH];
 
 	/* ZLayer vertices */
 	SVVector zlayerVert[zlayersMax];
 
+	/* Map viewport position the buffers were built for */
+	Vec2i buffersPos;
+
 	/* Base quad indices of each zlayer
 	 * in the shared buffer */
 	size_t zlayerBases[zlayersMax+1];
@@ -293,6 +331,9 @@ struct TilemapPrivate
 
 		/* Animation state */
 		uint32_t aniIdx;
+
+		/* Size of the VBO store in quads */
+		size_t allocQuads;
 	} tiles;
 
 	FlashMap flashMap;
@@ -312,10 +353,15 @@ struct TilemapPrivate
 	bool atlasSizeDirty;
 	/* Affected by: autotiles(.changed), tileset(.changed), allocateAtlas */
 	bool atlasDirty;
-	/* Affected by: mapData(.changed), priorities(.changed) */
+	/* Affected by: mapData (new), priorities(.changed), atlas layout */
 	bool buffersDirty;
 	/* Affected by: ox, oy */
 	bool mapViewportDirty;
+	/* Affected by: updateMapViewport */
+	bool buffersScrolled;
+	/* Affected by: mapData(.changed), covering 'mapDirtyArea' */
+	bool mapAreaDirty;
+	IntRect mapDirtyArea;
 	/* Affected by: oy */
 	bool zOrderDirty;
 
@@ -354,6 +400,8 @@ struct TilemapPrivate
 	      atlasDirty(false),
 	      buffersDirty(false),
 	      mapViewportDirty(false),
+	      buffersScrolled(false),
+	      mapAreaDirty(false),
 	      zOrderDirty(false),
 	      tilemapReady(false),
 
@@ -367,8 +415,14 @@ struct TilemapPrivate
 		atlas.animatedATs.reserve(autotileCount);
 		atlas.efTilesetH = 0;
 
+		groundCellQuads = 0;
+		groundQuads = 0;
+
 		tiles.animated = false;
 		tiles.aniIdx = 0;
+		tiles.allocQuads = 0;
+
+		clearGroundDirty();
 
 		/* Init tile buffers */
 		tiles.vbo = VBO::gen();
@@ -430,6 +484,9 @@ struct TilemapPrivate
 			return;
 		}
 
+		const Vec2i oldSize = atlas.size;
+		const int oldTilesetH = atlas.efTilesetH;
+
 		int tsH = tileset->height();
 		atlas.efTilesetH = tsH - (tsH % 32);
 
@@ -438,6 +495,10 @@ struct TilemapPrivate
 		if (atlas.size.x < 0)
 			throw Exception(Exception::MKXPError,
 		                    "Cannot allocate big enough texture for tileset atlas");
+
+		/* Tile texture coordinates depend on the atlas layout */
+		if (atlas.size != oldSize || atlas.efTilesetH != oldTilesetH)
+			buffersDirty = true;
 	}
 
 	void updateAutotileInfo()
@@ -449,6 +510,9 @@ struct TilemapPrivate
 		usableATs.clear();
 		animatedATs.clear();
 
+		bool oldSmallATs[autotileCount];
+		memcpy(oldSmallATs, atlas.smallATs, sizeof(oldSmallATs));
+
 		for (int i = 0; i < autotileCount; ++i)
 		{
 			if (nullOrDisposed(autotiles[i]) || autotiles[i]->megaSurface())
@@ -475,6 +539,10 @@ struct TilemapPrivate
 		}
 
 		tiles.animated = !animatedATs.empty();
+
+		/* Small autotiles are made of fewer quads */
+		if (memcmp(oldSmallATs, atlas.smallATs, sizeof(oldSmallATs)))
+			buffersDirty = true;
 	}
 
 	void updateSceneGeometry(const Scene::Geometry &geo)
@@ -486,11 +554,13 @@ struct TilemapPrivate
 	void invalidateAtlasSize()
 	{
 		atlasSizeDirty = true;
+		SharedState::damageScreen();
 	}
 
 	void invalidateAtlasContents()
 	{
 		atlasDirty = true;
+		SharedState::damageScreen();
 	}
 
 	void atlasContentsDisposal(int i)
@@ -510,6 +580,14 @@ struct TilemapPrivate
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		SharedState::damageScreen();
+	}
+
+	void invalidateMapArea(const IntRect &area)
+	{
+		mapDirtyArea = mapAreaDirty ? uniteRects(mapDirtyArea, area) : area;
+		mapAreaDirty = true;
+		SharedState::damageScreen();
 	}
 
 	/* Checks for the minimum amount of data needed to display */
@@ -697,7 +775,9 @@ struct TilemapPrivate
 		return value;
 	}
 
-	void handleAutotile(int x, int y, int tileInd, SVVector *array)
+	/* Writes the quads of an autotile at map position x/y
+	 * to 'vert' and returns how many there are */
+	size_t handleAutotile(int x, int y, int tileInd, SVertex *vert)
 	{
 		/* Which autotile [0-7] */
 		int atInd = tileInd / 48 - 1;
@@ -719,31 +799,24 @@ struct TilemapPrivate
 				/* Adjust to atlas coordinates */
 				texRect.y += atInd * autotileH;
 
-				SVertex v[4];
-				Quad::setTexPosRect(v, texRect, posRect);
-
-				/* Iterate over 4 vertices */
-				for (size_t j = 0; j < 4; ++j)
-					array->push_back(v[j]);
+				Quad::setTexPosRect(&vert[i*4], texRect, posRect);
 			}
+
+			return 4;
 		}
 		else
 		{
 			FloatRect posRect(x*32, y*32, 32, 32);
 			FloatRect texRect(0.5f, atInd * autotileH + 0.5f, 31, 31);
-			SVertex v[4];
-			Quad::setTexPosRect(v, texRect, posRect);
+			Quad::setTexPosRect(vert, texRect, posRect);
 
-			/* Iterate over 4 vertices */
-			for (size_t j = 0; j < 4; ++j)
-				array->push_back(v[j]);
+			return 1;
 		}
 	}
 
-	void handleTile(int x, int y, int z)
+	void handleTile(int x, int y, int z, size_t cell)
 	{
-		int tileInd =
-			tableGetWrapped(*mapData, x + viewpPos.x, y + viewpPos.y, z);
+		int tileInd = tableGetWrapped(*mapData, x, y, z);
 
 		/* Check for empty space */
 		if (tileInd < 48)
@@ -755,81 +828,180 @@ struct TilemapPrivate
 		if (prio == -1)
 			return;
 
-		SVVector *targetArray;
+		SVertex vert[4*4];
+		size_t quads;
 
-		/* Prio 0 tiles are all part of the same ground layer */
-		if (prio == 0)
+		/* Check for autotile */
+		if (tileInd < 48*8)
 		{
-			targetArray = &groundVert;
+			quads = handleAutotile(x, y, tileInd, vert);
 		}
 		else
 		{
-			int layerInd = y + prio;
-			if ((size_t)layerInd >= zlayersMax)
-				return;
-			targetArray = &zlayerVert[layerInd];
+			int tsInd = tileInd - 48*8;
+			int tileX = tsInd % 8;
+			int tileY = tsInd / 8;
+
+			Vec2i texPos = TileAtlas::tileToAtlasCoor(tileX, tileY, atlas.efTilesetH, atlas.size.y);
+			FloatRect texRect((float) texPos.x+0.5f, (float) texPos.y+0.5f, 31, 31);
+			FloatRect posRect(x*32, y*32, 32, 32);
+
+			Quad::setTexPosRect(vert, texRect, posRect);
+			quads = 1;
 		}
 
-		/* Check for autotile */
-		if (tileInd < 48*8)
+		/* Prio 0 tiles are all part of the same ground layer */
+		if (prio == 0)
 		{
-			handleAutotile(x, y, tileInd, targetArray);
+			size_t slot = cell * groundCellQuads + groundUsed[cell];
+			std::copy(vert, vert + quads*4, &groundVert[slot*4]);
+
+			groundUsed[cell] += quads;
+			groundQuads += quads;
+
 			return;
 		}
 
-		int tsInd = tileInd - 48*8;
-		int tileX = tsInd % 8;
-		int tileY = tsInd / 8;
+		for (size_t i = 0; i < quads; ++i)
+		{
+			ZQuad zquad;
+			zquad.prio = prio;
+			std::copy(&vert[i*4], &vert[i*4+4], zquad.v);
 
-		Vec2i texPos = TileAtlas::tileToAtlasCoor(tileX, tileY, atlas.efTilesetH, atlas.size.y);
-		FloatRect texRect((float) texPos.x+0.5f, (float) texPos.y+0.5f, 31, 31);
-		FloatRect posRect(x*32, y*32, 32, 32);
+			zquadCells[cell].push_back(zquad);
+		}
+	}
 
-		SVertex v[4];
-		Quad::setTexPosRect(v, texRect, posRect);
+	static size_t ringCell(int x, int y)
+	{
+		return wrap(y, ringH) * ringW + wrap(x, ringW);
+	}
+
+	void markGroundDirty(int x, int y)
+	{
+		int col = wrap(x, ringW);
+		int row = wrap(y, ringH);
 
-		for (size_t i = 0; i < 4; ++i)
-			targetArray->push_back(v[i]);
+		groundDirty[row].x1 = std::min(groundDirty[row].x1, col);
+		groundDirty[row].x2 = std::max(groundDirty[row].x2, col+1);
+	}
+
+	void clearGroundDirty()
+	{
+		for (int i = 0; i < ringH; ++i)
+		{
+			groundDirty[i].x1 = ringW;
+			groundDirty[i].x2 = 0;
+		}
 	}
 
-	void clearQuadArrays()
+	/* Rebuilds the tiles at map position x/y, which
+	 * has to lie within the current map viewport */
+	void buildCell(int x, int y)
 	{
-		groundVert.clear();
+		size_t cell = ringCell(x, y);
+		size_t oldUsed = groundUsed[cell];
+
+		SVertex *slots = dataPtr(groundVert) + cell * groundCellQuads * 4;
+		std::fill(slots, slots + oldUsed*4, SVertex());
+
+		groundQuads -= oldUsed;
+		groundUsed[cell] = 0;
+		zquadCells[cell].clear();
+
+		if (x >= 0 && y >= 0 && x < mapData->xSize() && y < mapData->ySize())
+			for (int z = 0; z < mapData->zSize(); ++z)
+				handleTile(x, y, z, cell);
 
+		/* Cells that were and still are empty stay as they are */
+		if (oldUsed > 0 || groundUsed[cell] > 0)
+			markGroundDirty(x, y);
+	}
+
+	/* Assembles the zlayers of the current map viewport. Layer
+	 * indices are relative to the viewport's top row */
+	void assembleZLayers()
+	{
 		for (size_t i = 0; i < zlayersMax; ++i)
 			zlayerVert[i].clear();
+
+		for (int y = 0; y < ringH; ++y)
+			for (int x = 0; x < ringW; ++x)
+			{
+				const std::vector<ZQuad> &quads =
+					zquadCells[ringCell(viewpPos.x + x, viewpPos.y + y)];
+
+				for (size_t i = 0; i < quads.size(); ++i)
+				{
+					size_t layerInd = y + quads[i].prio;
+					if (layerInd >= zlayersMax)
+						continue;
+
+					zlayerVert[layerInd].insert(zlayerVert[layerInd].end(),
+					                            quads[i].v, quads[i].v + 4);
+				}
+			}
 	}
 
 	void buildQuadArray()
 	{
-		clearQuadArrays();
-
-		int ox = viewpPos.x;
-		int oy = viewpPos.y;
-		int mapW = mapData->xSize();
-		int mapH = mapData->ySize();
-
-		int minX = 0;
-		int minY = 0;
-		if (ox < 0)
-			minX = -ox;
-		if (oy < 0)
-			minY = -oy;
-
-		// There could be off-by-one issues in these couple sections.
-		int maxX = viewpW;
-		int maxY = viewpH;
-		if (ox + maxX >= mapW)
-			maxX = mapW - ox - 1;
-		if (oy + maxY >= mapH)
-			maxY = mapH - oy - 1;
-
-		if ((minX > maxX) || (minY > maxY))
-			return;
-		for (int x = minX; x <= maxX; ++x)
-			for (int y = minY; y <= maxY; ++y)
-				for (int z = 0; z < mapData->zSize(); ++z)
-					handleTile(x, y, z);
+		/* Up to 4 quads (autotile pieces) per map layer */
+		groundCellQuads = mapData->zSize() * 4;
+		groundVert.assign(ringW * ringH * groundCellQuads * 4, SVertex());
+
+		memset(groundUsed, 0, sizeof(groundUsed));
+		groundQuads = 0;
+
+		for (int i = 0; i < ringW*ringH; ++i)
+			zquadCells[i].clear();
+
+		for (int y = 0; y < ringH; ++y)
+			for (int x = 0; x < ringW; ++x)
+				buildCell(viewpPos.x + x, viewpPos.y + y);
+
+		buffersPos = viewpPos;
+		assembleZLayers();
+	}
+
+	/* Only rebuilds the tiles that scrolled into view; whatever
+	 * is still visible keeps its place in the ring buffer.
+	 * The zlayers have to be assembled afterwards */
+	void scrollQuadArray()
+	{
+		const IntRect old(buffersPos, Vec2i(ringW, ringH));
+
+		for (int y = 0; y < ringH; ++y)
+			for (int x = 0; x < ringW; ++x)
+			{
+				int mapX = viewpPos.x + x;
+				int mapY = viewpPos.y + y;
+
+				if (mapX >= old.x && mapX < old.x + old.w &&
+				    mapY >= old.y && mapY < old.y + old.h)
+					continue;
+
+				buildCell(mapX, mapY);
+			}
+
+		buffersPos = viewpPos;
+	}
+
+	/* Rebuilds the visible tiles inside 'mapDirtyArea'.
+	 * The zlayers have to be assembled afterwards */
+	void rebuildMapArea()
+	{
+		const IntRect &area = mapDirtyArea;
+
+		for (int y = 0; y < ringH; ++y)
+			for (int x = 0; x < ringW; ++x)
+			{
+				int mapX = buffersPos.x + x;
+				int mapY = buffersPos.y + y;
+
+				if (mapX >= area.x && mapX < area.x + area.w &&
+				    mapY >= area.y && mapY < area.y + area.h)
+					buildCell(mapX, mapY);
+			}
 	}
 
 	static size_t quadDataSize(size_t quadCount)
@@ -842,7 +1014,10 @@ struct TilemapPrivate
 		return zlayerBases[index+1] - zlayerBases[index];
 	}
 
-	void uploadBuffers()
+	/* Uploads the whole ground ring if 'full' is set,
+	 * otherwise only its dirty cells. The zlayers follow
+	 * the ground and are always uploaded */
+	void uploadBuffers(bool full)
 	{
 		/* Calculate total quad count */
 		size_t groundQuadCount = groundVert.size() / 4;
@@ -857,9 +1032,32 @@ struct TilemapPrivate
 		zlayerBases[zlayersMax] = quadCount;
 
 		VBO::bind(tiles.vbo);
-		VBO::allocEmpty(quadDataSize(quadCount));
 
-		VBO::uploadSubData(0, quadDataSize(groundQuadCount), dataPtr(groundVert));
+		if (full || quadCount > tiles.allocQuads)
+		{
+			/* Leave some room for the zlayers to grow
+			 * while scrolling before reallocating */
+			tiles.allocQuads = quadCount + (quadCount - groundQuadCount) / 2;
+			VBO::allocEmpty(quadDataSize(tiles.allocQuads), GL_DYNAMIC_DRAW);
+
+			VBO::uploadSubData(0, quadDataSize(groundQuadCount), dataPtr(groundVert));
+		}
+		else
+		{
+			for (int y = 0; y < ringH; ++y)
+			{
+				if (groundDirty[y].x1 >= groundDirty[y].x2)
+					continue;
+
+				size_t first = (y * ringW + groundDirty[y].x1) * groundCellQuads;
+				size_t count = (groundDirty[y].x2 - groundDirty[y].x1) * groundCellQuads;
+
+				VBO::uploadSubData(quadDataSize(first), quadDataSize(count),
+				                   &groundVert[first*4]);
+			}
+		}
+
+		clearGroundDirty();
 
 		for (size_t i = 0; i < zlayersMax; ++i)
 		{
@@ -955,15 +1153,8 @@ struct TilemapPrivate
 		for (size_t i = 0; i < elem.activeLayers; ++i)
 			elem.zlayers[i]->initUpdateZ();
 
-		ZLayer *prev = elem.zlayers[0];
-		prev->finiUpdateZ(0);
-
-		for (size_t i = 1; i < elem.activeLayers; ++i)
-		{
-			ZLayer *layer = elem.zlayers[i];
-			layer->finiUpdateZ(prev);
-			prev = layer;
-		}
+		for (size_t i = 0; i < elem.activeLayers; ++i)
+			elem.zlayers[i]->finiUpdateZ();
 	}
 
 	/* When there are two or more zlayers with no other
@@ -1007,6 +1198,12 @@ struct TilemapPrivate
 		}
 	}
 
+	/* Tiles are placed at their map position in the buffers */
+	Vec2i bufferTranslation() const
+	{
+		return dispPos - buffersPos * 32;
+	}
+
 	void updateMapViewport()
 	{
 		const Vec2i combOrigin = origin + elem.sceneGeo.orig;
@@ -1015,7 +1212,7 @@ struct TilemapPrivate
 		if (mvpPos != viewpPos)
 		{
 			viewpPos = mvpPos;
-			buffersDirty = true;
+			buffersScrolled = true;
 			updateFlashMapViewport();
 		}
 
@@ -1054,9 +1251,25 @@ struct TilemapPrivate
 		if (buffersDirty)
 		{
 			buildQuadArray();
-			uploadBuffers();
+			uploadBuffers(true);
 			updateSceneElements();
 			buffersDirty = false;
+			buffersScrolled = false;
+			mapAreaDirty = false;
+		}
+		else if (buffersScrolled || mapAreaDirty)
+		{
+			if (buffersScrolled)
+				scrollQuadArray();
+
+			if (mapAreaDirty)
+				rebuildMapArea();
+
+			assembleZLayers();
+			uploadBuffers(false);
+			updateSceneElements();
+			buffersScrolled = false;
+			mapAreaDirty = false;
 		}
 
 		flashMap.prepare();
@@ -1088,7 +1301,7 @@ void GroundLayer::updateVboCount()
 
 void GroundLayer::draw()
 {
-	if (p->groundVert.size() == 0)
+	if (p->groundQuads == 0)
 		return;
 
 	if (!p->opacity)
@@ -1103,7 +1316,7 @@ void GroundLayer::draw()
 
 	GLMeta::vaoBind(p->tiles.vao);
 
-	shader->setTranslation(p->dispPos);
+	shader->setTranslation(p->bufferTranslation());
 	drawInt();
 
 	GLMeta::vaoUnbind(p->tiles.vao);
@@ -1157,7 +1370,7 @@ void ZLayer::draw()
 
 	GLMeta::vaoBind(p->tiles.vao);
 
-	shader->setTranslation(p->dispPos);
+	shader->setTranslation(p->bufferTranslation());
 	drawInt();
 
 	GLMeta::vaoUnbind(p->tiles.vao);
@@ -1180,14 +1393,10 @@ void ZLayer::initUpdateZ()
 	unlink();
 }
 
-void ZLayer::finiUpdateZ(ZLayer *prev)
+void ZLayer::finiUpdateZ()
 {
 	z = calculateZ(p, index);
-
-	if (prev)
-		scene->insertAfter(*this, *prev);
-	else
-		scene->insert(*this);
+	scene->insert(*this);
 }
 
 void Tilemap::Autotiles::set(int i, Bitmap *bitmap)
@@ -1255,11 +1464,15 @@ void Tilemap::update()
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
 
+	if (p->flashMap.animating())
+		SharedState::damageScreen();
+
 	/* Animate autotiles */
 	if (!p->tiles.animated)
 		return;
 
-	++p->tiles.aniIdx;
+	if (++p->tiles.aniIdx % atFrameDur == 0)
+		SharedState::damageScreen();
 }
 
 Tilemap::Autotiles &Tilemap::getAutotiles()
@@ -1279,9 +1492,9 @@ DEF_ATTR_RD_SIMPLE(Tilemap, OX, int, p->origin.x)
 DEF_ATTR_RD_SIMPLE(Tilemap, OY, int, p->origin.y)
 
 DEF_ATTR_RD_SIMPLE(Tilemap, BlendType, int, p->blendType)
-DEF_ATTR_SIMPLE(Tilemap, Opacity,   int,     p->opacity)
-DEF_ATTR_SIMPLE(Tilemap, Color,     Color&, *p->color)
-DEF_ATTR_SIMPLE(Tilemap, Tone,      Tone&,  *p->tone)
+DEF_ATTR_SIMPLE_DAMAGE(Tilemap, Opacity,   int,     p->opacity)
+DEF_ATTR_SIMPLE_DAMAGE(Tilemap, Color,     Color&, *p->color)
+DEF_ATTR_SIMPLE_DAMAGE(Tilemap, Tone,      Tone&,  *p->tone)
 
 void Tilemap::setTileset(Bitmap *value)
 {
@@ -1291,6 +1504,7 @@ void Tilemap::setTileset(Bitmap *value)
 		return;
 
 	p->tileset = value;
+	SharedState::damageScreen();
 
 	p->tilesetDispCon.disconnect();
 	p->tilesetCon.disconnect();
@@ -1320,14 +1534,15 @@ void Tilemap::setMapData(Table *value)
 		return;
 
 	p->mapData = value;
+	SharedState::damageScreen();
 
 	if (!value)
 		return;
 
 	p->invalidateBuffers();
 	p->mapDataCon.disconnect();
-	p->mapDataCon = value->modified.connect
-	        (&TilemapPrivate::invalidateBuffers, p);
+	p->mapDataCon = value->modifiedArea.connect
+	        (&TilemapPrivate::invalidateMapArea, p);
 }
 
 void Tilemap::setFlashData(Table *value)
@@ -1345,6 +1560,7 @@ void Tilemap::setPriorities(Table *value)
 		return;
 
 	p->priorities = value;
+	SharedState::damageScreen();
 
 	if (!value)
 		return;
@@ -1363,6 +1579,7 @@ void Tilemap::setVisible(bool value)
 		return;
 
 	p->visible = value;
+	SharedState::damageScreen();
 
 	if (!p->tilemapReady)
 		return;
@@ -1381,6 +1598,7 @@ void Tilemap::setOX(int value)
 
 	p->origin.x = value;
 	p->mapViewportDirty = true;
+	SharedState::damageScreen();
 }
 
 void Tilemap::setOY(int value)
@@ -1393,12 +1611,16 @@ void Tilemap::setOY(int value)
 	p->origin.y = value;
 	p->zOrderDirty = true;
 	p->mapViewportDirty = true;
+	SharedState::damageScreen();
 }
 
 void Tilemap::setBlendType(int value)
 {
 	guardDisposed();
 
+	if (p->blendType != value)
+		SharedState::damageScreen();
+
 	switch (value)
 	{
 	default :
@@ -53,6 +53,19 @@ static const uint8_t flashAlpha[] =
 
 static elementsN(flashAlpha);
 
+/* Map layer read in each pass, in drawing order */
+enum
+{
+	PassLayer0,
+	PassLayer1,
+	PassShadow,
+	PassLayer2,
+
+	PassCount
+};
+
+static const int passLayers[PassCount] = { 0, 1, 3, 2 };
+
 struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 {
 	Bitmap *bitmaps[BM_COUNT];
@@ -67,6 +80,25 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	Vec2i dispPos;
 	Scene::Geometry sceneGeo;
 
+	/* Quads read from one map cell, per pass */
+	struct Cell
+	{
+		std::vector<SVertex> ground[PassCount];
+		std::vector<SVertex> above[PassCount];
+	};
+
+	/* Tiles of the map viewport, addressed by map position
+	 * modulo the viewport size. Tiles are placed at their map
+	 * position, so after a scroll only the cells that came into
+	 * view have to be read again */
+	std::vector<Cell> cells;
+	/* Map viewport the cells were read for */
+	IntRect cellsViewp;
+
+	/* Where TileAtlasVX::Reader output currently goes */
+	Cell *readTarget;
+	int readPass;
+
 	std::vector<SVertex> groundVert;
 	std::vector<SVertex> aboveVert;
 
@@ -89,6 +121,10 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 	bool atlasDirty;
 	bool buffersDirty;
+	bool buffersScrolled;
+	/* Parts of the map data changed, within 'mapDirtyArea' */
+	bool mapAreaDirty;
+	IntRect mapDirtyArea;
 	bool mapViewportDirty;
 
 	sigslot::connection mapDataCon;
@@ -122,6 +158,8 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	    : ViewportElement(viewport),
 	      mapData(0),
 	      flags(0),
+	      readTarget(0),
+	      readPass(0),
 	      allocQuads(0),
 	      groundQuads(0),
 	      aboveQuads(0),
@@ -129,6 +167,8 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	      flashAlphaIdx(0),
 	      atlasDirty(true),
 	      buffersDirty(false),
+	      buffersScrolled(false),
+	      mapAreaDirty(false),
 	      mapViewportDirty(false),
 	      above(this, viewport)
 	{
@@ -182,6 +222,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void invalidateAtlas()
 	{
 		atlasDirty = true;
+		SharedState::damageScreen();
 	}
 
 	void atlasDisposal(int i)
@@ -195,6 +236,14 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void invalidateBuffers()
 	{
 		buffersDirty = true;
+		SharedState::damageScreen();
+	}
+
+	void invalidateMapArea(const IntRect &area)
+	{
+		mapDirtyArea = mapAreaDirty ? uniteRects(mapDirtyArea, area) : area;
+		mapAreaDirty = true;
+		SharedState::damageScreen();
 	}
 
 	void rebuildAtlas()
@@ -240,7 +289,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		{
 			mapViewp = newMvp;
 			flashMap.setViewport(newMvp);
-			buffersDirty = true;
+			buffersScrolled = true;
 		}
 
 		dispPos = sceneGeo.rect.pos() - wrap(combOrigin, 32) - Vec2i(0, 32);
@@ -251,16 +300,109 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		return quads * 4 * sizeof(SVertex);
 	}
 
+	Cell &cellAt(int x, int y)
+	{
+		return cells[wrap(y, cellsViewp.h) * cellsViewp.w + wrap(x, cellsViewp.w)];
+	}
+
+	void readCell(int x, int y)
+	{
+		Cell &cell = cellAt(x, y);
+
+		for (int i = 0; i < PassCount; ++i)
+		{
+			cell.ground[i].clear();
+			cell.above[i].clear();
+		}
+
+		readTarget = &cell;
+
+		for (readPass = 0; readPass < PassCount; ++readPass)
+			TileAtlasVX::readCell(*this, *mapData, flags, x, y, passLayers[readPass]);
+	}
+
 	void rebuildBuffers()
 	{
 		if (!mapData)
 			return;
 
+		cells.assign(mapViewp.w * mapViewp.h, Cell());
+		cellsViewp = mapViewp;
+
+		for (int y = 0; y < mapViewp.h; ++y)
+			for (int x = 0; x < mapViewp.w; ++x)
+				readCell(mapViewp.x + x, mapViewp.y + y);
+
+		uploadBuffers();
+	}
+
+	/* Only reads the cells that scrolled into view,
+	 * and the ones covered by 'mapDirtyArea' if set */
+	void updateBuffers()
+	{
+		if (!mapData)
+			return;
+
+		if (mapViewp.size() != cellsViewp.size())
+		{
+			rebuildBuffers();
+			return;
+		}
+
+		const IntRect old = cellsViewp;
+		cellsViewp = mapViewp;
+
+		/* The map wraps around, so the dirty area
+		 * is checked against wrapped positions */
+		const IntRect &area = mapDirtyArea;
+		const int mapW = mapData->xSize();
+		const int mapH = mapData->ySize();
+
+		for (int y = 0; y < mapViewp.h; ++y)
+			for (int x = 0; x < mapViewp.w; ++x)
+			{
+				int mapX = mapViewp.x + x;
+				int mapY = mapViewp.y + y;
+
+				bool inView = mapX >= old.x && mapX < old.x + old.w &&
+				              mapY >= old.y && mapY < old.y + old.h;
+
+				if (inView && mapAreaDirty)
+				{
+					int wx = wrap(mapX, mapW);
+					int wy = wrap(mapY, mapH);
+
+					inView = !(wx >= area.x && wx < area.x + area.w &&
+					           wy >= area.y && wy < area.y + area.h);
+				}
+
+				if (!inView)
+					readCell(mapX, mapY);
+			}
+
+		uploadBuffers();
+	}
+
+	void uploadBuffers()
+	{
 		groundVert.clear();
 		aboveVert.clear();
 
-		TileAtlasVX::readTiles(*this, *mapData, flags,
-		                       mapViewp.x, mapViewp.y, mapViewp.w, mapViewp.h);
+		/* The table autotile pattern (A2) has two quads (table
+		 * legs, etc.) which extend over the tile below. Every pass
+		 * is assembled in rows from bottom to top so the table
+		 * extents are added after the tile below and drawn over it. */
+		for (int i = 0; i < PassCount; ++i)
+			for (int y = cellsViewp.h-1; y >= 0; --y)
+				for (int x = 0; x < cellsViewp.w; ++x)
+				{
+					const Cell &cell = cellAt(cellsViewp.x + x, cellsViewp.y + y);
+
+					groundVert.insert(groundVert.end(),
+					                  cell.ground[i].begin(), cell.ground[i].end());
+					aboveVert.insert(aboveVert.end(),
+					                 cell.above[i].begin(), cell.above[i].end());
+				}
 
 		groundQuads = groundVert.size() / 4;
 		aboveQuads = aboveVert.size() / 4;
@@ -282,6 +424,12 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		shState->ensureQuadIBO(totalQuads);
 	}
 
+	/* Tiles are placed at their map position in the buffers */
+	Vec2i bufferTranslation() const
+	{
+		return dispPos - cellsViewp.pos() * 32;
+	}
+
 	void prepare()
 	{
 		if (!mapData)
@@ -303,6 +451,14 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		{
 			rebuildBuffers();
 			buffersDirty = false;
+			buffersScrolled = false;
+			mapAreaDirty = false;
+		}
+		else if (buffersScrolled || mapAreaDirty)
+		{
+			updateBuffers();
+			buffersScrolled = false;
+			mapAreaDirty = false;
 		}
 
 		flashMap.prepare();
@@ -348,7 +504,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 
 		shader->setTexSize(Vec2i(atlas.width, atlas.height));
 		shader->applyViewportProj();
-		shader->setTranslation(dispPos);
+		shader->setTranslation(bufferTranslation());
 
 		if (atlas.selfHires != nullptr) {
 			TEX::bind(atlas.selfHires->tex);
@@ -372,7 +528,7 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 		shader.bind();
 		shader.setTexSize(Vec2i(atlas.width, atlas.height));
 		shader.applyViewportProj();
-		shader.setTranslation(dispPos);
+		shader.setTranslation(bufferTranslation());
 
 		if (atlas.selfHires != nullptr) {
 			TEX::bind(atlas.selfHires->tex);
@@ -400,7 +556,6 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	{
 		sceneGeo = geo;
 
-		buffersDirty = true;
 		mapViewportDirty = true;
 	}
 
@@ -410,7 +565,8 @@ struct TilemapVXPrivate : public ViewportElement, TileAtlasVX::Reader
 	void onQuads(const FloatRect *t, const FloatRect *p,
 	             size_t n, bool overPlayer)
 	{
-		SVertex *vert = allocVert(overPlayer ? aboveVert : groundVert, n*4);
+		SVertex *vert = allocVert(overPlayer ? readTarget->above[readPass]
+		                                     : readTarget->ground[readPass], n*4);
 
 		for (size_t i = 0; i < n; ++i)
 			Quad::setTexPosRect(&vert[i*4], t[i], p[i]);
@@ -429,7 +585,7 @@ void TilemapVX::BitmapArray::set(int i, Bitmap *bitmap)
 		return;
 
 	p->bitmaps[i] = bitmap;
-	p->atlasDirty = true;
+	p->invalidateAtlas();
 
 	p->bmChangedCons[i].disconnect();
 	p->bmDisposedCons[i].disconnect();
@@ -484,11 +640,19 @@ void TilemapVX::update()
 	uint8_t aniIdxA = aniIndicesA[p->frameIdx / 30];
 	uint8_t aniIdxC = aniIndicesC[p->frameIdx / 30];
 
-	p->aniOffset = Vec2(aniIdxA * 2 * 32, aniIdxC * 32);
+	const Vec2 aniOffset(aniIdxA * 2 * 32, aniIdxC * 32);
+
+	if (!(aniOffset == p->aniOffset))
+		SharedState::damageScreen();
+
+	p->aniOffset = aniOffset;
 
 	/* Animate flash */
 	if (++p->flashAlphaIdx >= flashAlphaN)
 		p->flashAlphaIdx = 0;
+
+	if (p->flashMap.animating())
+		SharedState::damageScreen();
 }
 
 TilemapVX::BitmapArray &TilemapVX::getBitmapArray()
@@ -534,11 +698,11 @@ void TilemapVX::setMapData(Table *value)
 		return;
 
 	p->mapData = value;
-	p->buffersDirty = true;
+	p->invalidateBuffers();
 
 	p->mapDataCon.disconnect();
-	p->mapDataCon = value->modified.connect
-		(&TilemapVXPrivate::invalidateBuffers, p);
+	p->mapDataCon = value->modifiedArea.connect
+		(&TilemapVXPrivate::invalidateMapArea, p);
 }
 
 void TilemapVX::setFlashData(Table *value)
@@ -556,7 +720,7 @@ void TilemapVX::setFlags(Table *value)
 		return;
 
 	p->flags = value;
-	p->buffersDirty = true;
+	p->invalidateBuffers();
 
 	p->flagsCon.disconnect();
 	p->flagsCon = value->modified.connect
@@ -580,6 +744,7 @@ void TilemapVX::setOX(int value)
 
 	p->origin.x = value;
 	p->mapViewportDirty = true;
+	SharedState::damageScreen();
 }
 
 void TilemapVX::setOY(int value)
@@ -591,6 +756,7 @@ void TilemapVX::setOY(int value)
 
 	p->origin.y = value;
 	p->mapViewportDirty = true;
+	SharedState::damageScreen();
 }
 
 void TilemapVX::releaseResources()
@@ -713,11 +713,15 @@ void Window::update()
 
 	p->updateControls();
 	p->stepAnimations();
+
+	/* The cursor blinks and the pause sign keeps cycling */
+	if ((p->active && !p->cursorRect->isEmpty()) || p->pause)
+		SharedState::damageScreen();
 }
 
-DEF_ATTR_SIMPLE(Window, X,          int,     p->position.x)
-DEF_ATTR_SIMPLE(Window, Y,          int,     p->position.y)
-DEF_ATTR_SIMPLE(Window, CursorRect, Rect&,  *p->cursorRect)
+DEF_ATTR_SIMPLE_DAMAGE(Window, X,          int,     p->position.x)
+DEF_ATTR_SIMPLE_DAMAGE(Window, Y,          int,     p->position.y)
+DEF_ATTR_SIMPLE_DAMAGE(Window, CursorRect, Rect&,  *p->cursorRect)
 
 DEF_ATTR_RD_SIMPLE(Window, Windowskin,      Bitmap*, p->windowskin)
 DEF_ATTR_RD_SIMPLE(Window, Contents,        Bitmap*, p->contents)
@@ -736,6 +740,9 @@ void Window::setWindowskin(Bitmap *value)
 {
 	guardDisposed();
 
+	if (p->windowskin != value)
+		SharedState::damageScreen();
+
 	p->windowskin = value;
 
 	p->windowskinDispCon.disconnect();
@@ -760,6 +767,7 @@ void Window::setContents(Bitmap *value)
 
 	p->contents = value;
 	p->controlsVertDirty = true;
+	SharedState::damageScreen();
 
 	p->contentsDispCon.disconnect();
 
@@ -785,6 +793,7 @@ void Window::setStretch(bool value)
 
 	p->bgStretch = value;
 	p->baseVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setActive(bool value)
@@ -796,6 +805,7 @@ void Window::setActive(bool value)
 
 	p->active = value;
 	p->cursorAniAlphaIdx = 0;
+	SharedState::damageScreen();
 }
 
 void Window::setPause(bool value)
@@ -809,6 +819,7 @@ void Window::setPause(bool value)
 	p->pauseAniAlphaIdx = 0;
 	p->pauseAniQuadIdx = 0;
 	p->controlsVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setWidth(int value)
@@ -820,6 +831,7 @@ void Window::setWidth(int value)
 
 	p->size.x = value;
 	p->baseVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setHeight(int value)
@@ -831,6 +843,7 @@ void Window::setHeight(int value)
 
 	p->size.y = value;
 	p->baseVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setOX(int value)
@@ -842,6 +855,7 @@ void Window::setOX(int value)
 
 	p->contentsOffset.x = value;
 	p->controlsVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setOY(int value)
@@ -853,6 +867,7 @@ void Window::setOY(int value)
 
 	p->contentsOffset.y = value;
 	p->controlsVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setOpacity(int value)
@@ -864,6 +879,7 @@ void Window::setOpacity(int value)
 
 	p->opacity = value;
 	p->opacityDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setBackOpacity(int value)
@@ -875,6 +891,7 @@ void Window::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->opacityDirty = true;
+	SharedState::damageScreen();
 }
 
 void Window::setContentsOpacity(int value)
@@ -886,6 +903,7 @@ void Window::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+	SharedState::damageScreen();
 }
 
 void Window::initDynAttribs()
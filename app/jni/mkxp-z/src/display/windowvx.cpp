@@ -859,6 +859,10 @@ void WindowVX::update()
 
 	p->updatePauseQuad();
 	p->updateCursorAlpha();
+
+	/* The cursor blinks and the pause sign keeps cycling */
+	if ((p->active && !p->cursorRect->isEmpty()) || p->pause)
+		SharedState::damageScreen();
 }
 
 void WindowVX::move(int x, int y, int width, int height)
@@ -880,6 +884,8 @@ void WindowVX::move(int x, int y, int width, int height)
 
 	p->geo = IntRect(Vec2i(x, y), size);
 	p->updateBaseQuad();
+
+	SharedState::damageScreen();
 }
 
 bool WindowVX::isOpen() const
@@ -896,10 +902,10 @@ bool WindowVX::isClosed() const
 	return p->openness == 0;
 }
 
-DEF_ATTR_SIMPLE(WindowVX, X,          int,     p->geo.x)
-DEF_ATTR_SIMPLE(WindowVX, Y,          int,     p->geo.y)
-DEF_ATTR_SIMPLE(WindowVX, CursorRect, Rect&,  *p->cursorRect)
-DEF_ATTR_SIMPLE(WindowVX, Tone,       Tone&,  *p->tone)
+DEF_ATTR_SIMPLE_DAMAGE(WindowVX, X,          int,     p->geo.x)
+DEF_ATTR_SIMPLE_DAMAGE(WindowVX, Y,          int,     p->geo.y)
+DEF_ATTR_SIMPLE_DAMAGE(WindowVX, CursorRect, Rect&,  *p->cursorRect)
+DEF_ATTR_SIMPLE_DAMAGE(WindowVX, Tone,       Tone&,  *p->tone)
 
 DEF_ATTR_RD_SIMPLE(WindowVX, Windowskin,      Bitmap*, p->windowskin)
 DEF_ATTR_RD_SIMPLE(WindowVX, Contents,        Bitmap*, p->contents)
@@ -926,6 +932,7 @@ void WindowVX::setWindowskin(Bitmap *value)
 
 	p->windowskin = value;
 	p->base.texDirty = true;
+	SharedState::damageScreen();
 
 	p->windowskinDispCon.disconnect();
 
@@ -946,6 +953,7 @@ void WindowVX::setContents(Bitmap *value)
 		return;
 
 	p->contents = value;
+	SharedState::damageScreen();
 
 	p->contentsDispCon.disconnect();
 
@@ -972,6 +980,7 @@ void WindowVX::setActive(bool value)
 	p->active = value;
 	p->cursorAlphaIdx = cursorAlphaResetIdx;
 	p->updateCursorAlpha();
+	SharedState::damageScreen();
 }
 
 void WindowVX::setArrowsVisible(bool value)
@@ -983,6 +992,7 @@ void WindowVX::setArrowsVisible(bool value)
 
 	p->arrowsVisible = value;
 	p->ctrlVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void WindowVX::setPause(bool value)
@@ -996,6 +1006,7 @@ void WindowVX::setPause(bool value)
 	p->pauseAlphaIdx = 0;
 	p->pauseQuadIdx = 0;
 	p->ctrlVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void WindowVX::setWidth(int value)
@@ -1012,6 +1023,7 @@ void WindowVX::setWidth(int value)
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
 	p->updateBaseQuad();
+	SharedState::damageScreen();
 }
 
 void WindowVX::setHeight(int value)
@@ -1028,6 +1040,7 @@ void WindowVX::setHeight(int value)
 	p->clipRectDirty = true;
 	p->ctrlVertDirty = true;
 	p->updateBaseQuad();
+	SharedState::damageScreen();
 }
 
 void WindowVX::setOX(int value)
@@ -1039,6 +1052,7 @@ void WindowVX::setOX(int value)
 
 	p->contentsOff.x = value;
 	p->ctrlVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void WindowVX::setOY(int value)
@@ -1050,6 +1064,7 @@ void WindowVX::setOY(int value)
 
 	p->contentsOff.y = value;
 	p->ctrlVertDirty = true;
+	SharedState::damageScreen();
 }
 
 void WindowVX::setPadding(int value)
@@ -1062,6 +1077,7 @@ void WindowVX::setPadding(int value)
 	p->padding = value;
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+	SharedState::damageScreen();
 }
 
 void WindowVX::setPaddingBottom(int value)
@@ -1073,6 +1089,7 @@ void WindowVX::setPaddingBottom(int value)
 
 	p->paddingBottom = value;
 	p->clipRectDirty = true;
+	SharedState::damageScreen();
 }
 
 void WindowVX::setOpacity(int value)
@@ -1084,6 +1101,7 @@ void WindowVX::setOpacity(int value)
 
 	p->opacity = value;
 	p->base.quad.setColor(Vec4(1, 1, 1, p->opacity.norm));
+	SharedState::damageScreen();
 }
 
 void WindowVX::setBackOpacity(int value)
@@ -1095,6 +1113,7 @@ void WindowVX::setBackOpacity(int value)
 
 	p->backOpacity = value;
 	p->base.texDirty = true;
+	SharedState::damageScreen();
 }
 
 void WindowVX::setContentsOpacity(int value)
@@ -1106,6 +1125,7 @@ void WindowVX::setContentsOpacity(int value)
 
 	p->contentsOpacity = value;
 	p->contentsQuad.setColor(Vec4(1, 1, 1, p->contentsOpacity.norm));
+	SharedState::damageScreen();
 }
 
 void WindowVX::setOpenness(int value)
@@ -1117,6 +1137,7 @@ void WindowVX::setOpenness(int value)
 
 	p->openness = value;
 	p->updateBaseQuad();
+	SharedState::damageScreen();
 }
 
 void WindowVX::initDynAttribs()
@@ -23,6 +23,7 @@
 
 #include "serial-util.h"
 #include "exception.h"
+#include "sharedstate.h"
 
 #include <SDL_types.h>
 #include <SDL_pixels.h>
@@ -54,6 +55,9 @@ bool Color::operator==(const Color &o) const
 
 const Color &Color::operator=(const Color &o)
 {
+	if (!(*this == o))
+		SharedState::damageScreen();
+
 	red   = o.red;
 	green = o.green;
 	blue  = o.blue;
@@ -65,6 +69,10 @@ const Color &Color::operator=(const Color &o)
 
 void Color::set(double red, double green, double blue, double alpha)
 {
+	if (this->red  != red  || this->green != green ||
+	    this->blue != blue || this->alpha != alpha)
+		SharedState::damageScreen();
+
 	this->red   = red;
 	this->green = green;
 	this->blue  = blue;
@@ -75,24 +83,36 @@ void Color::set(double red, double green, double blue, double alpha)
 
 void Color::setRed(double value)
 {
+	if (red != value)
+		SharedState::damageScreen();
+
 	red = value;
 	norm.x = clamp<double>(value, 0, 255) / 255;
 }
 
 void Color::setGreen(double value)
 {
+	if (green != value)
+		SharedState::damageScreen();
+
 	green = value;
 	norm.y = clamp<double>(value, 0, 255) / 255;
 }
 
 void Color::setBlue(double value)
 {
+	if (blue != value)
+		SharedState::damageScreen();
+
 	blue = value;
 	norm.z = clamp<double>(value, 0, 255) / 255;
 }
 
 void Color::setAlpha(double value)
 {
+	if (alpha != value)
+		SharedState::damageScreen();
+
 	alpha = value;
 	norm.w = clamp<double>(value, 0, 255) / 255;
 }
@@ -176,6 +196,10 @@ bool Tone::operator==(const Tone &o) const
 
 void Tone::set(double red, double green, double blue, double gray)
 {
+	if (this->red  != red  || this->green != green ||
+	    this->blue != blue || this->gray  != gray)
+		SharedState::damageScreen();
+
 	this->red   = red;
 	this->green = green;
 	this->blue  = blue;
@@ -187,6 +211,9 @@ void Tone::set(double red, double green, double blue, double gray)
 
 const Tone& Tone::operator=(const Tone &o)
 {
+	if (!(*this == o))
+		SharedState::damageScreen();
+
 	red   = o.red;
 	green = o.green;
 	blue  = o.blue;
@@ -200,6 +227,9 @@ const Tone& Tone::operator=(const Tone &o)
 
 void Tone::setRed(double value)
 {
+	if (red != value)
+		SharedState::damageScreen();
+
 	red = value;
 	norm.x = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -208,6 +238,9 @@ void Tone::setRed(double value)
 
 void Tone::setGreen(double value)
 {
+	if (green != value)
+		SharedState::damageScreen();
+
 	green = value;
 	norm.y = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -216,6 +249,9 @@ void Tone::setGreen(double value)
 
 void Tone::setBlue(double value)
 {
+	if (blue != value)
+		SharedState::damageScreen();
+
 	blue = value;
 	norm.z = (float) clamp<double>(value, -255, 255) / 255;
 
@@ -224,6 +260,9 @@ void Tone::setBlue(double value)
 
 void Tone::setGray(double value)
 {
+	if (gray != value)
+		SharedState::damageScreen();
+
 	gray = value;
 	norm.w = (float) clamp<double>(value, 0, 255) / 255;
 
@@ -313,10 +352,14 @@ void Rect::set(int x, int y, int w, int h)
 	width = w;
 	height = h;
 	valueChanged();
+	SharedState::damageScreen();
 }
 
 const Rect &Rect::operator=(const Rect &o)
 {
+	if (!(*this == o))
+		SharedState::damageScreen();
+
 	x      = o.x;
 	y      = o.y;
 	width  = o.width;
@@ -334,6 +377,7 @@ void Rect::empty()
 
 	x = y = width = height = 0;
 	valueChanged();
+	SharedState::damageScreen();
 }
 
 bool Rect::isEmpty() const
@@ -348,6 +392,7 @@ void Rect::setX(int value)
 
 	x = value;
 	valueChanged();
+	SharedState::damageScreen();
 }
 
 void Rect::setY(int value)
@@ -357,6 +402,7 @@ void Rect::setY(int value)
 
 	y = value;
 	valueChanged();
+	SharedState::damageScreen();
 }
 
 void Rect::setWidth(int value)
@@ -366,6 +412,7 @@ void Rect::setWidth(int value)
 
 	width = value;
 	valueChanged();
+	SharedState::damageScreen();
 }
 
 void Rect::setHeight(int value)
@@ -375,6 +422,7 @@ void Rect::setHeight(int value)
 
 	height = value;
 	valueChanged();
+	SharedState::damageScreen();
 }
 
 int Rect::serialSize() const
@@ -22,6 +22,7 @@
 #include "table.h"
 
 #include <string.h>
+#include <limits.h>
 #include <algorithm>
 
 #include "serial-util.h"
@@ -32,13 +33,21 @@
 /* Init normally */
 Table::Table(int x, int y /*= 1*/, int z /*= 1*/)
     : xs(x), ys(y), zs(z),
-      data(x*y*z)
-{}
+      data(x*y*z),
+      batchDepth(0)
+{
+	pending.x1 = pending.y1 = INT_MAX;
+	pending.x2 = pending.y2 = INT_MIN;
+}
 
 Table::Table(const Table &other)
     : xs(other.xs), ys(other.ys), zs(other.zs),
-      data(other.data)
-{}
+      data(other.data),
+      batchDepth(0)
+{
+	pending.x1 = pending.y1 = INT_MAX;
+	pending.x2 = pending.y2 = INT_MIN;
+}
 
 int16_t Table::get(int x, int y, int z) const
 {
@@ -56,6 +65,150 @@ void Table::set(int16_t value, int x, int y, int z)
 
 	data[xs*ys*z + xs*y + x] = value;
 
+	addModified(x, y, x+1, y+1);
+}
+
+/* Clips the box at x/y/z of size w/h/d to the table,
+ * and returns false if nothing is left */
+static bool clipBox(int &x, int &y, int &z, int &w, int &h, int &d,
+                    int xs, int ys, int zs)
+{
+	if (x < 0) { w += x; x = 0; }
+	if (y < 0) { h += y; y = 0; }
+	if (z < 0) { d += z; z = 0; }
+
+	w = std::min(w, xs - x);
+	h = std::min(h, ys - y);
+	d = std::min(d, zs - z);
+
+	return w > 0 && h > 0 && d > 0;
+}
+
+void Table::fill(int16_t value, int x, int y, int z, int w, int h, int d)
+{
+	if (!clipBox(x, y, z, w, h, d, xs, ys, zs))
+		return;
+
+	for (int k = z; k < z+d; ++k)
+		for (int j = y; j < y+h; ++j)
+			std::fill_n(&at(x, j, k), w, value);
+
+	addModified(x, y, x+w, y+h);
+}
+
+void Table::copyRect(const Table &src, int sx, int sy, int sz,
+                     int w, int h, int d, int dx, int dy, int dz)
+{
+	/* Clip against the source, then the destination */
+	int ox = sx, oy = sy, oz = sz;
+
+	if (!clipBox(sx, sy, sz, w, h, d, src.xs, src.ys, src.zs))
+		return;
+
+	dx += sx - ox;
+	dy += sy - oy;
+	dz += sz - oz;
+
+	ox = dx; oy = dy; oz = dz;
+
+	if (!clipBox(dx, dy, dz, w, h, d, xs, ys, zs))
+		return;
+
+	sx += dx - ox;
+	sy += dy - oy;
+	sz += dz - oz;
+
+	/* Copying within one table goes through a
+	 * temporary so overlapping boxes work */
+	std::vector<int16_t> tmp;
+
+	if (&src == this)
+	{
+		tmp.resize(w*h*d);
+
+		for (int k = 0; k < d; ++k)
+			for (int j = 0; j < h; ++j)
+				std::copy_n(&at(sx, sy+j, sz+k), w, &tmp[w*h*k + w*j]);
+	}
+
+	for (int k = 0; k < d; ++k)
+		for (int j = 0; j < h; ++j)
+		{
+			const int16_t *row = tmp.empty()
+				? &src.at(sx, sy+j, sz+k)
+				: &tmp[w*h*k + w*j];
+
+			std::copy_n(row, w, &at(dx, dy+j, dz+k));
+		}
+
+	addModified(dx, dy, dx+w, dy+h);
+}
+
+void Table::setMany(const int16_t *values, size_t count,
+                    int x, int y, int z, int w)
+{
+	if (count == 0 || w <= 0 || z < 0 || z >= zs)
+		return;
+
+	/* x, y and w come from scripts; don't let the bounds overflow */
+	int64_t h = (int64_t) ((count + w - 1) / w);
+	int x1 = std::max(x, 0), x2 = (int) std::min<int64_t>((int64_t) x+w, xs);
+	int y1 = std::max(y, 0), y2 = (int) std::min<int64_t>((int64_t) y+h, ys);
+
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	for (int j = y1; j < y2; ++j)
+	{
+		size_t first = (size_t) ((int64_t) j-y) * w + (size_t) ((int64_t) x1-x);
+
+		if (first >= count)
+			break;
+
+		size_t n = std::min((size_t) (x2-x1), count - first);
+		std::copy_n(&values[first], n, &at(x1, j, z));
+	}
+
+	addModified(x1, y1, x2, y2);
+}
+
+void Table::beginBatch()
+{
+	++batchDepth;
+}
+
+void Table::endBatch()
+{
+	if (batchDepth == 0)
+		return;
+
+	if (--batchDepth == 0)
+		emitModified();
+}
+
+void Table::addModified(int x1, int y1, int x2, int y2)
+{
+	pending.x1 = std::min(pending.x1, x1);
+	pending.y1 = std::min(pending.y1, y1);
+	pending.x2 = std::max(pending.x2, x2);
+	pending.y2 = std::max(pending.y2, y2);
+
+	if (batchDepth == 0)
+		emitModified();
+}
+
+void Table::emitModified()
+{
+	if (pending.x1 >= pending.x2)
+		return;
+
+	IntRect area(pending.x1, pending.y1,
+	             pending.x2 - pending.x1, pending.y2 - pending.y1);
+
+	pending.x1 = pending.y1 = INT_MAX;
+	pending.x2 = pending.y2 = INT_MIN;
+
+	modifiedArea(area);
 	modified();
 }
 
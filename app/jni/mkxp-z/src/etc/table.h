@@ -23,6 +23,7 @@
 #define TABLE_H
 
 #include "serializable.h"
+#include "etc-internal.h"
 
 #include <stdint.h>
 #include "sigslot/signal.hpp"
@@ -43,6 +44,22 @@ public:
 	int16_t get(int x, int y = 0, int z = 0) const;
 	void set(int16_t value, int x, int y = 0, int z = 0);
 
+	/* Bulk writes. Cells outside of the table are skipped,
+	 * and each call notifies about its changes only once */
+	void fill(int16_t value, int x, int y, int z, int w, int h, int d);
+	/* 'src' may be this table; overlapping boxes are fine */
+	void copyRect(const Table &src, int sx, int sy, int sz,
+	              int w, int h, int d, int dx, int dy, int dz);
+	/* Writes 'count' values to layer 'z' in rows of 'w'
+	 * cells, starting at x/y */
+	void setMany(const int16_t *values, size_t count,
+	             int x, int y, int z, int w);
+
+	/* Changes made until the matching endBatch() are
+	 * collected into one notification. Batches nest */
+	void beginBatch();
+	void endBatch();
+
 	void resize(int x, int y, int z);
 	void resize(int x, int y);
 	void resize(int x);
@@ -63,10 +80,23 @@ public:
 	}
 
     sigslot::signal<> modified;
+	/* Emitted right before 'modified', with the x/y bounding
+	 * box of the changed cells (across all layers) */
+	sigslot::signal<const IntRect&> modifiedArea;
 
 private:
+	void addModified(int x1, int y1, int x2, int y2);
+	void emitModified();
+
 	int xs, ys, zs;
 	std::vector<int16_t> data;
+
+	int batchDepth;
+	/* Bounding box of changes not notified yet, [x1, x2) x [y1, y2) */
+	struct
+	{
+		int x1, y1, x2, y2;
+	} pending;
 };
 
 #endif // TABLE_H
@@ -0,0 +1,432 @@
+/*
+** assetprefetch.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "assetprefetch.h"
+
+#include "filesystem.h"
+#include "al-util.h"
+#include "util/exception.h"
+
+#include <SDL_image.h>
+#include <SDL_sound.h>
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+static const size_t workerThreads = 2;
+static const size_t queueSize = 256;
+
+struct PrefetchImageHandler : FileSystem::OpenHandler {
+  SDL_Surface *surface;
+  bool gif;
+
+  PrefetchImageHandler() : surface(0), gif(false) {}
+
+  bool tryRead(SDL_RWops &ops, const char *ext) {
+    /* Animated bitmaps are built frame by frame
+     * on upload; leave those to Bitmap */
+    if (IMG_isGIF(&ops)) {
+      SDL_RWclose(&ops);
+      gif = true;
+      return true;
+    }
+
+    surface = IMG_LoadTyped_RW(&ops, 1, ext);
+    return surface != 0;
+  }
+};
+
+struct PrefetchSoundHandler : FileSystem::OpenHandler {
+  AssetPrefetch::Sound &sound;
+  bool ok;
+
+  PrefetchSoundHandler(AssetPrefetch::Sound &sound) : sound(sound), ok(false) {}
+
+  bool tryRead(SDL_RWops &ops, const char *ext) {
+    Sound_Sample *sample = Sound_NewSample(&ops, ext, 0, STREAM_BUF_SIZE);
+
+    if (!sample) {
+      SDL_RWclose(&ops);
+      return false;
+    }
+
+    /* Same as SoundEmitter, minus the upload */
+    uint32_t decBytes = Sound_DecodeAll(sample);
+    uint8_t sampleSize = formatSampleSize(sample->actual.format);
+    uint32_t sampleCount = decBytes / sampleSize;
+
+    sound.sampleSize = sampleSize;
+    sound.channels = sample->actual.channels;
+    sound.rate = sample->actual.rate;
+    sound.pcm.assign((const char *)sample->buffer, sampleSize * sampleCount);
+
+    Sound_FreeSample(sample);
+
+    ok = true;
+    return true;
+  }
+};
+
+AssetPrefetch::AssetPrefetch(FileSystem &fs, size_t budgetBytes)
+    : fs(fs), budget(budgetBytes), stagedBytes(0), orderCounter(0),
+      stats(), pool(0) {
+  stats.budgetBytes = budget;
+
+  if (budget > 0)
+    pool = new WorkerPool<Job>(workerThreads, queueSize,
+                               [this](Job &job) { run(job); });
+}
+
+AssetPrefetch::~AssetPrefetch() {
+  if (pool) {
+    pool->stop();
+    delete pool;
+  }
+
+  for (auto it = entries.begin(); it != entries.end(); ++it)
+    freeEntry(it->second);
+}
+
+std::string AssetPrefetch::keyFor(const char *path) {
+  std::string key(path);
+
+  for (size_t i = 0; i < key.size(); ++i) {
+    key[i] = tolower((unsigned char)key[i]);
+    if (key[i] == '\\')
+      key[i] = '/';
+  }
+
+  return key;
+}
+
+AssetPrefetch::Kind AssetPrefetch::kindFor(const std::string &key) {
+  static const char *dataExts[] = { ".rxdata", ".rvdata", ".rvdata2" };
+
+  for (size_t i = 0; i < sizeof(dataExts) / sizeof(dataExts[0]); ++i) {
+    size_t len = strlen(dataExts[i]);
+    if (key.size() > len && key.compare(key.size() - len, len, dataExts[i]) == 0)
+      return Data;
+  }
+
+  if (key.compare(0, 9, "audio/se/") == 0)
+    return SoundEffect;
+
+  return Image;
+}
+
+void AssetPrefetch::freeEntry(Entry &e) {
+  if (e.surface)
+    SDL_FreeSurface(e.surface);
+
+  e.surface = 0;
+}
+
+bool AssetPrefetch::request(const char *path) {
+  if (!pool)
+    return false;
+
+  Job job;
+  job.key = keyFor(path);
+  job.path = path;
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    if (entries.count(job.key)) {
+      stats.dropped++;
+      return false;
+    }
+
+    Entry &e = entries[job.key];
+    e.kind = kindFor(job.key);
+    e.state = Queued;
+    e.discard = false;
+    e.generation = fs.generation();
+    e.order = 0;
+    e.bytes = 0;
+    e.surface = 0;
+  }
+
+  std::string key = job.key;
+
+  if (!pool->push(std::move(job), 0)) {
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.erase(key);
+    stats.dropped++;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mtx);
+  stats.queued++;
+
+  return true;
+}
+
+AssetPrefetch::LoadResult AssetPrefetch::load(Kind kind, const std::string &path, Entry &out) {
+  try {
+    switch (kind) {
+    case Image: {
+      PrefetchImageHandler handler;
+      fs.openRead(handler, path.c_str());
+
+      if (handler.gif)
+        return Skipped;
+
+      if (!handler.surface)
+        return Failed;
+
+      /* Convert here so Bitmap doesn't have to */
+      if (handler.surface->format->format != SDL_PIXELFORMAT_ABGR8888) {
+        SDL_Surface *conv =
+            SDL_ConvertSurfaceFormat(handler.surface, SDL_PIXELFORMAT_ABGR8888, 0);
+        SDL_FreeSurface(handler.surface);
+        handler.surface = conv;
+
+        if (!conv)
+          return Failed;
+      }
+
+      out.surface = handler.surface;
+      out.bytes = (size_t)out.surface->pitch * out.surface->h;
+      return Loaded;
+    }
+
+    case SoundEffect: {
+      PrefetchSoundHandler handler(out.sound);
+      fs.openRead(handler, path.c_str());
+
+      out.bytes = out.sound.pcm.size();
+      return handler.ok ? Loaded : Failed;
+    }
+
+    case Data: {
+      SDL_RWops ops;
+      fs.openReadRaw(ops, path.c_str());
+
+      /* Seeking can fail on encrypted archives,
+       * so ask for the size directly */
+      Sint64 size = ops.size(&ops);
+
+      if (size >= 0) {
+        out.data.resize((size_t)size);
+        if (size > 0 && SDL_RWread(&ops, &out.data[0], 1, size) != (size_t)size)
+          size = -1;
+      }
+
+      SDL_RWclose(&ops);
+
+      out.bytes = out.data.size();
+      return size >= 0 ? Loaded : Failed;
+    }
+    }
+  } catch (const Exception &) {
+  }
+
+  return Failed;
+}
+
+void AssetPrefetch::makeRoom(size_t bytes) {
+  while (stagedBytes + bytes > budget) {
+    auto oldest = entries.end();
+
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+      if (it->second.state == Ready &&
+          (oldest == entries.end() || it->second.order < oldest->second.order))
+        oldest = it;
+
+    if (oldest == entries.end())
+      break;
+
+    stagedBytes -= oldest->second.bytes;
+    freeEntry(oldest->second);
+    entries.erase(oldest);
+    stats.evictions++;
+  }
+}
+
+void AssetPrefetch::run(Job &job) {
+  Kind kind;
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = entries.find(job.key);
+
+    /* Taken or cleared while queued */
+    if (it == entries.end() || it->second.state != Queued)
+      return;
+
+    it->second.state = Loading;
+    kind = it->second.kind;
+  }
+
+  Entry result = Entry();
+  LoadResult loadResult = load(kind, job.path, result);
+
+  std::lock_guard<std::mutex> lock(mtx);
+  auto it = entries.find(job.key);
+
+  if (loadResult != Loaded || it->second.discard || result.bytes > budget) {
+    if (loadResult == Failed)
+      stats.failed++;
+    else if (loadResult == Skipped)
+      stats.skipped++;
+    else if (!it->second.discard)
+      stats.evictions++;
+
+    freeEntry(result);
+    entries.erase(it);
+    loaded.notify_all();
+    return;
+  }
+
+  makeRoom(result.bytes);
+
+  Entry &e = it->second;
+  e.state = Ready;
+  e.order = ++orderCounter;
+  e.bytes = result.bytes;
+  e.surface = result.surface;
+  e.sound.pcm.swap(result.sound.pcm);
+  e.sound.sampleSize = result.sound.sampleSize;
+  e.sound.channels = result.sound.channels;
+  e.sound.rate = result.sound.rate;
+  e.data.swap(result.data);
+
+  stagedBytes += e.bytes;
+  loaded.notify_all();
+}
+
+bool AssetPrefetch::take(const char *path, Kind kind, Entry &out) {
+  if (!pool)
+    return false;
+
+  std::string key = keyFor(path);
+  std::unique_lock<std::mutex> lock(mtx);
+
+  auto it = entries.find(key);
+
+  if (it == entries.end())
+    return false;
+
+  if (it->second.state == Loading) {
+    stats.waits++;
+    loaded.wait(lock, [&]() {
+      it = entries.find(key);
+      return it == entries.end() || it->second.state != Loading;
+    });
+
+    if (it == entries.end())
+      return false;
+  }
+
+  Entry &e = it->second;
+
+  /* The worker skips entries that are gone */
+  if (e.state == Queued) {
+    entries.erase(it);
+    return false;
+  }
+
+  stagedBytes -= e.bytes;
+
+  bool usable = (e.kind == kind && e.generation == fs.generation());
+
+  if (usable) {
+    out = std::move(e);
+    stats.hits++;
+  } else {
+    freeEntry(e);
+  }
+
+  entries.erase(it);
+
+  return usable;
+}
+
+SDL_Surface *AssetPrefetch::takeImage(const char *path) {
+  Entry e;
+
+  if (!take(path, Image, e))
+    return 0;
+
+  return e.surface;
+}
+
+bool AssetPrefetch::takeSound(const char *path, Sound &out) {
+  Entry e;
+
+  if (!take(path, SoundEffect, e))
+    return false;
+
+  out.pcm.swap(e.sound.pcm);
+  out.sampleSize = e.sound.sampleSize;
+  out.channels = e.sound.channels;
+  out.rate = e.sound.rate;
+
+  return true;
+}
+
+bool AssetPrefetch::takeData(const char *path, std::string &out) {
+  Entry e;
+
+  if (!take(path, Data, e))
+    return false;
+
+  out.swap(e.data);
+
+  return true;
+}
+
+void AssetPrefetch::clear() {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (it->second.state == Loading) {
+      it->second.discard = true;
+      ++it;
+      continue;
+    }
+
+    if (it->second.state == Ready)
+      stagedBytes -= it->second.bytes;
+
+    freeEntry(it->second);
+    it = entries.erase(it);
+  }
+}
+
+AssetPrefetch::Stats AssetPrefetch::getStats() {
+  std::lock_guard<std::mutex> lock(mtx);
+  Stats s = stats;
+
+  s.pending = 0;
+  s.stagedCount = 0;
+
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->second.state == Ready)
+      s.stagedCount++;
+    else
+      s.pending++;
+  }
+
+  s.stagedBytes = stagedBytes;
+
+  return s;
+}
@@ -0,0 +1,142 @@
+/*
+** assetprefetch.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASSETPREFETCH_H
+#define ASSETPREFETCH_H
+
+#include "util/workerpool.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+class FileSystem;
+struct SDL_Surface;
+
+/* Reads and decodes files on worker threads ahead of the moment
+ * the game asks for them, so that the synchronous load on the
+ * Ruby thread only has to do what needs the GL / AL context.
+ *
+ * What is done with a file depends on its path: data files
+ * (.rxdata etc.) are only read, sound effects (Audio/SE/) are
+ * decoded to PCM, and everything else is decoded as an image.
+ * Results are staged within a byte budget, oldest dropped first,
+ * and handed over (and forgotten) by the matching take*() call */
+class AssetPrefetch
+{
+public:
+  struct Sound {
+    std::string pcm;
+    uint8_t sampleSize;
+    uint8_t channels;
+    uint32_t rate;
+  };
+
+  struct Stats {
+    /* Requests accepted / dropped because the
+     * queue was full or the file already staged */
+    uint64_t queued;
+    uint64_t dropped;
+    /* take*() calls served from the stage, and how
+     * many of those had to wait for a worker */
+    uint64_t hits;
+    uint64_t waits;
+    /* Files that failed to load, were left for the
+     * synchronous path (animated images), or were
+     * thrown away to stay within budget */
+    uint64_t failed;
+    uint64_t skipped;
+    uint64_t evictions;
+    size_t pending;
+    size_t stagedCount;
+    size_t stagedBytes;
+    size_t budgetBytes;
+  };
+
+  /* A budget of 0 disables prefetching */
+  AssetPrefetch(FileSystem &fs, size_t budgetBytes);
+  ~AssetPrefetch();
+
+  /* Returns false if the file wasn't queued */
+  bool request(const char *path);
+
+  /* If the file is still waiting in the queue, it is taken out
+   * and these return nothing; the caller loads it as usual. If a
+   * worker is busy with it, they wait for the result */
+  SDL_Surface *takeImage(const char *path);
+  bool takeSound(const char *path, Sound &out);
+  bool takeData(const char *path, std::string &out);
+
+  /* Drops everything that is queued or staged */
+  void clear();
+
+  Stats getStats();
+
+private:
+  enum Kind { Image, SoundEffect, Data };
+  enum State { Queued, Loading, Ready };
+  enum LoadResult { Loaded, Skipped, Failed };
+
+  struct Entry {
+    Kind kind;
+    State state;
+    /* Set by clear() while a worker holds the entry */
+    bool discard;
+    unsigned int generation;
+    uint64_t order;
+    size_t bytes;
+
+    SDL_Surface *surface;
+    Sound sound;
+    std::string data;
+  };
+
+  struct Job {
+    std::string key;
+    std::string path;
+  };
+
+  static std::string keyFor(const char *path);
+  static Kind kindFor(const std::string &key);
+  static void freeEntry(Entry &e);
+
+  void run(Job &job);
+  LoadResult load(Kind kind, const std::string &path, Entry &out);
+  void makeRoom(size_t bytes);
+
+  /* Waits out a worker and takes the entry out of the stage if
+   * it's ready and of the right kind. The caller owns 'out' */
+  bool take(const char *path, Kind kind, Entry &out);
+
+  FileSystem &fs;
+  size_t budget;
+
+  std::mutex mtx;
+  std::condition_variable loaded;
+  std::unordered_map<std::string, Entry> entries;
+  size_t stagedBytes;
+  uint64_t orderCounter;
+  Stats stats;
+
+  WorkerPool<Job> *pool;
+};
+
+#endif // ASSETPREFETCH_H
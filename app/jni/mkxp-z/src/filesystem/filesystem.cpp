@@ -27,6 +27,7 @@
 #include "util/util.h"
 #include "display/font.h"
 #include "crypto/rgssad.h"
+#include "pathcache.h"
 
 #include "eventthread.h"
 #include "sharedstate.h"
@@ -34,9 +35,13 @@
 #include <physfs.h>
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <stack>
 #include <stdio.h>
 #include <string.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -293,16 +298,48 @@ static void strTolower(std::string &str) {
 const Uint32 SDL_RWOPS_PHYSFS = SDL_RWOPS_UNKNOWN + 10;
 
 struct FileSystemPrivate {
-  /* Maps: lower case full filepath,
-   * To:   mixed case full filepath */
-  BoostHash<std::string, std::string> pathCache;
-  /* Maps: lower case directory path,
-   * To:   list of lower case filenames */
-  BoostHash<std::string, std::vector<std::string>> fileLists;
+  /* Accessed through std::atomic_load/store; replaced
+   * as a whole when rebuilt */
+  std::shared_ptr<PathCacheData> cache;
+  /* The cache replaced last is kept alive, as a string just
+   * handed out by desensitize() may still point into it. Older
+   * ones are dropped once no reader holds them any more */
+  std::vector<std::shared_ptr<PathCacheData>> retired;
+  std::mutex retiredMutex;
+
+  /* Revalidates / saves the on-disk path cache */
+  std::thread cacheThread;
 
   /* This is for compatibility with games that take Windows'
    * case insensitivity for granted */
   bool havePathCache;
+
+  /* See FileSystem::generation() */
+  std::atomic<unsigned int> generation;
+
+  void installCache(const std::shared_ptr<PathCacheData> &data) {
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    std::shared_ptr<PathCacheData> old = std::atomic_load(&cache);
+    if (old)
+      retired.push_back(old);
+
+    /* Readers pin the cache with atomic_load for
+     * the duration of a call */
+    for (size_t i = 0; i + 1 < retired.size();) {
+      if (retired[i].use_count() == 1)
+        retired.erase(retired.begin() + i);
+      else
+        ++i;
+    }
+
+    std::atomic_store(&cache, data);
+    generation++;
+  }
+
+  void joinCacheThread() {
+    if (cacheThread.joinable())
+      cacheThread.join();
+  }
 };
 
 static void throwPhysfsError(const char *desc) {
@@ -349,6 +386,7 @@ FileSystem::FileSystem(const char *argv0, bool allowSymlinks)
 
 	p = new FileSystemPrivate;
 	p->havePathCache = false;
+	p->generation = 0;
 
 	if (allowSymlinks)
 		PHYSFS_permitSymbolicLinks(1);
@@ -356,6 +394,7 @@ FileSystem::FileSystem(const char *argv0, bool allowSymlinks)
 
 FileSystem::~FileSystem()
 {
+	p->joinCacheThread();
 	delete p;
 
 	if (PHYSFS_deinit() == 0)
@@ -378,6 +417,8 @@ void FileSystem::addPath(const char *path, const char *mountpoint, bool reload)
         throw Exception(Exception::PHYSFSError, "Failed to mount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    p->generation++;
+    
     if (reload) reloadPathCache();
 }
 
@@ -388,6 +429,8 @@ void FileSystem::removePath(const char *path, bool reload) {
         throw Exception(Exception::PHYSFSError, "Failed to unmount %s (%s)", path, PHYSFS_getErrorByCode(err));
     }
     
+    p->generation++;
+    
     if (reload) reloadPathCache();
 }
 
@@ -414,7 +457,7 @@ void FileSystem::mountAPKAssets()
 #endif
 
 struct CacheEnumData {
-  FileSystemPrivate *p;
+  PathCacheData *p;
   std::stack<std::vector<std::string> *> fileLists;
 
 #ifdef __APPLE__
@@ -422,7 +465,7 @@ struct CacheEnumData {
   char buf[512];
 #endif
 
-  CacheEnumData(FileSystemPrivate *p) : p(p) {
+  CacheEnumData(PathCacheData *p) : p(p) {
 #ifdef __APPLE__
     nfd2nfc = iconv_open("utf-8", "utf-8-mac");
 #endif
@@ -502,14 +545,71 @@ static PHYSFS_EnumerateCallbackResult cacheEnumCB(void *d, const char *origdir,
   return PHYSFS_ENUM_OK;
 }
 
-void FileSystem::createPathCache() {
-  Debug() << "Loading path cache...";
+static std::shared_ptr<PathCacheData> enumeratePathCache() {
+  std::shared_ptr<PathCacheData> cache(new PathCacheData);
 
-  CacheEnumData data(p);
-  data.fileLists.push(&p->fileLists[""]);
+  CacheEnumData data(cache.get());
+  data.fileLists.push(&cache->fileLists[""]);
   PHYSFS_enumerate("", cacheEnumCB, &data);
 
-  p->havePathCache = true;
+  cache->pathIndex.build(cache->fileLists, cache->pathCache);
+
+  return cache;
+}
+
+/* Runs on p->cacheThread. With a cache loaded from disk, makes sure
+ * no directory changed since it was written, rebuilding it if one
+ * did. Either way, brings the file up to date */
+static void refreshDiskCache(FileSystemPrivate *p, std::string file,
+                             PathCacheFile::Stamps mounts,
+                             PathCacheFile::Stamps dirs, bool loaded) {
+  try {
+    if (loaded) {
+      if (PathCacheFile::stampsValid(dirs))
+        return;
+
+      Debug() << "Path cache is out of date, rebuilding...";
+      p->installCache(enumeratePathCache());
+    }
+
+    std::shared_ptr<PathCacheData> cache = std::atomic_load(&p->cache);
+    dirs.clear();
+    PathCacheFile::stampDirectories(mounts, dirs);
+
+    if (!PathCacheFile::save(file, *cache, mounts, dirs))
+      Debug() << "Failed to write path cache" << file;
+  } catch (const Exception &e) {
+    Debug() << "Path cache refresh aborted:" << e.msg;
+  }
+}
+
+void FileSystem::createPathCache(const char *diskCache) {
+  Debug() << "Loading path cache...";
+
+  p->joinCacheThread();
+
+  if (diskCache) {
+    PathCacheFile::Stamps mounts, dirs;
+    PathCacheFile::stampMounts(mounts);
+
+    std::shared_ptr<PathCacheData> cache(new PathCacheData);
+    bool loaded = PathCacheFile::load(diskCache, mounts, *cache, dirs);
+
+    if (loaded) {
+      cache->pathIndex.build(cache->fileLists, cache->pathCache);
+      p->installCache(cache);
+      Debug() << "Path cache read from" << diskCache;
+    } else {
+      p->installCache(enumeratePathCache());
+    }
+
+    p->havePathCache = true;
+    p->cacheThread = std::thread(refreshDiskCache, p, std::string(diskCache),
+                                 mounts, dirs, loaded);
+  } else {
+    p->installCache(enumeratePathCache());
+    p->havePathCache = true;
+  }
 
   Debug() << "Path cache completed.";
 }
@@ -517,9 +617,10 @@ void FileSystem::createPathCache() {
 void FileSystem::reloadPathCache() {
     if (!p->havePathCache) return;
     
-    p->fileLists.clear();
-    p->pathCache.clear();
-    createPathCache();
+    /* Runtime mounts aren't persisted; the next launch
+     * starts from the configured search path again */
+    p->joinCacheThread();
+    p->installCache(enumeratePathCache());
 }
 
 struct FontSetsCBData {
@@ -618,6 +719,10 @@ struct OpenReadEnumData {
         physfsError(0) {}
 };
 
+static PHYSFS_EnumerateCallbackResult
+openReadCandidate(OpenReadEnumData &data, const char *fullPath,
+                  const char *filename);
+
 static PHYSFS_EnumerateCallbackResult
 openReadEnumCB(void *d, const char *dirpath, const char *filename) {
   OpenReadEnumData &data = *static_cast<OpenReadEnumData *>(d);
@@ -650,6 +755,12 @@ openReadEnumCB(void *d, const char *dirpath, const char *filename) {
   if (data.pathTrans)
     fullPath = (*data.pathTrans)[fullPath].c_str();
 
+  return openReadCandidate(data, fullPath, filename);
+}
+
+static PHYSFS_EnumerateCallbackResult
+openReadCandidate(OpenReadEnumData &data, const char *fullPath,
+                  const char *filename) {
   PHYSFS_File *phys = PHYSFS_openRead(fullPath);
 
   if (!phys) {
@@ -682,6 +793,19 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename) {
     for (size_t i = 0; i < len; ++i)
       buffer[i] = tolower(buffer[i]);
 
+  /* Hold on to this cache for the whole call in case
+   * a rebuild replaces it meanwhile */
+  std::shared_ptr<PathCacheData> cache;
+  if (p->havePathCache)
+    cache = std::atomic_load(&p->cache);
+
+  /* Look up the index before the buffer gets split in two */
+  size_t indexCount = 0;
+  const uint32_t *indexIds = 0;
+
+  if (cache)
+    indexIds = cache->pathIndex.find(buffer, len, indexCount);
+
   /* Find the deliminator separating directory and file name */
   for (delim = buffer + len; delim > buffer; --delim)
     if (*delim == '/')
@@ -700,15 +824,14 @@ void FileSystem::openRead(OpenHandler &handler, const char *filename) {
     dir = buffer;
   }
   OpenReadEnumData data(handler, file, len + buffer - delim - !root,
-                        p->havePathCache ? &p->pathCache : 0);
-
-  if (p->havePathCache) {
-    /* Get the list of files contained in this directory
-     * and manually iterate over them */
-    const std::vector<std::string> &fileList = p->fileLists[dir];
-
-    for (size_t i = 0; i < fileList.size(); ++i) {
-        openReadEnumCB(&data, dir, fileList[i].c_str());
+                        cache ? &cache->pathCache : 0);
+
+  if (cache) {
+    /* Look up every file in this directory whose name matches
+     * up to its extension, without scanning the directory */
+    for (size_t i = 0; i < indexCount && !data.stopSearching; ++i) {
+      const PathIndex::Entry &e = cache->pathIndex.entries[indexIds[i]];
+      openReadCandidate(data, e.mixed->c_str(), e.name->c_str());
     }
     if (data.matchCount == 0 && !data.physfsError) {
       PHYSFS_File *handle = PHYSFS_openRead(normalize(filename_nm.c_str(), 0, 0).c_str());
@@ -756,14 +879,34 @@ bool FileSystem::exists(const char *filename) {
   return PHYSFS_exists(normalize(filename, false, false).c_str());
 }
 
+bool FileSystem::stat(const char *filename, int64_t &size, int64_t &mtime) {
+  PHYSFS_Stat st;
+
+  if (!PHYSFS_stat(normalize(filename, false, false).c_str(), &st))
+    return false;
+
+  size = st.filesize;
+  mtime = st.modtime;
+
+  return true;
+}
+
+unsigned int FileSystem::generation() const {
+  return p->generation;
+}
+
 const char *FileSystem::desensitize(const char *filename) {
   std::string fn_lower(filename);
     
   std::transform(fn_lower.begin(), fn_lower.end(), fn_lower.begin(), [](unsigned char c){
       return std::tolower(c);
   });
-  if (p->havePathCache && p->pathCache.contains(fn_lower))
-    return p->pathCache[fn_lower].c_str();
+  if (!p->havePathCache)
+    return filename;
+
+  std::shared_ptr<PathCacheData> cache = std::atomic_load(&p->cache);
+  if (cache->pathCache.contains(fn_lower))
+    return cache->pathCache[fn_lower].c_str();
   return filename;
 }
 
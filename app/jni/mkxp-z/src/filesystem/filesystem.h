@@ -23,6 +23,7 @@
 #define FILESYSTEM_H
 
 #include <SDL_rwops.h>
+#include <stdint.h>
 #include <string>
 
 #include "filesystemImpl.h"
@@ -46,8 +47,11 @@ public:
     void mountAPKAssets();
 #endif
 
-	/* Call these after the last 'addPath()' */
-	void createPathCache();
+	/* Call these after the last 'addPath()'.
+	 * If diskCache is given, the cache is read from that file when
+	 * the search path hasn't changed since it was written, and the
+	 * file is revalidated / rewritten in the background */
+	void createPathCache(const char *diskCache = 0);
     
     void reloadPathCache();
 
@@ -81,6 +85,15 @@ public:
 	/* Does not perform extension supplementing */
 	bool exists(const char *filename);
 
+	/* Size and modification time (in seconds) as reported
+	 * by PhysFS. Returns false if the file doesn't exist */
+	bool stat(const char *filename, int64_t &size, int64_t &mtime);
+
+	/* Changes whenever a path is mounted or unmounted, or the
+	 * path cache is rebuilt, so anything derived from the files
+	 * that were visible before can be dropped */
+	unsigned int generation() const;
+
 	const char *desensitize(const char *filename);
 
 private:
@@ -0,0 +1,347 @@
+/*
+** pathcache.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pathcache.h"
+
+#include "util/debugwriter.h"
+
+#include <physfs.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* File layout (host byte order, strings are u32 length + bytes):
+ *   "MKPC" u32 version
+ *   u32 count, count * (str path, i64 size, i64 mtime)   mount stamps
+ *   u32 count, count * (str path, i64 size, i64 mtime)   directory stamps
+ *   u32 count, count * (str lowerDir, u32 files,
+ *                       files * (str lowerName, str mixedPath)) */
+static const char cacheMagic[4] = { 'M', 'K', 'P', 'C' };
+static const uint32_t cacheVersion = 1;
+
+static bool statStamp(const char *path, PathCacheFile::Stamp &stamp) {
+  struct stat st;
+
+  if (stat(path, &st) != 0)
+    return false;
+
+#ifdef __linux__
+  stamp.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+  stamp.mtime = (int64_t)st.st_mtime * 1000000000;
+#endif
+  /* Directory sizes say nothing useful */
+  stamp.size = S_ISDIR(st.st_mode) ? -1 : (int64_t)st.st_size;
+
+  return true;
+}
+
+void PathCacheFile::stampMounts(Stamps &out) {
+  char **list = PHYSFS_getSearchPath();
+
+  if (!list)
+    return;
+
+  for (char **i = list; *i; ++i) {
+    Stamp stamp;
+    stamp.path = *i;
+
+    /* Mounts that aren't plain files (e.g. wrapped SDL_RWops)
+     * can't be checked; record them as such */
+    if (!statStamp(*i, stamp)) {
+      stamp.size = -2;
+      stamp.mtime = 0;
+    }
+
+    out.push_back(stamp);
+  }
+
+  PHYSFS_freeList(list);
+}
+
+static void stampDirectory(const std::string &path, PathCacheFile::Stamps &out) {
+  DIR *dir = opendir(path.c_str());
+
+  if (!dir)
+    return;
+
+  while (struct dirent *ent = readdir(dir)) {
+    if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+      continue;
+
+    std::string child = path + "/" + ent->d_name;
+    bool isDir = (ent->d_type == DT_DIR);
+
+    if (ent->d_type == DT_UNKNOWN) {
+      struct stat st;
+      isDir = (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+    }
+
+    if (!isDir)
+      continue;
+
+    PathCacheFile::Stamp stamp;
+    stamp.path = child;
+
+    if (statStamp(child.c_str(), stamp))
+      out.push_back(stamp);
+
+    stampDirectory(child, out);
+  }
+
+  closedir(dir);
+}
+
+void PathCacheFile::stampDirectories(const Stamps &mounts, Stamps &out) {
+  for (size_t i = 0; i < mounts.size(); ++i)
+    if (mounts[i].size == -1)
+      stampDirectory(mounts[i].path, out);
+}
+
+bool PathCacheFile::stampsValid(const Stamps &stamps) {
+  for (size_t i = 0; i < stamps.size(); ++i) {
+    Stamp now;
+
+    if (!statStamp(stamps[i].path.c_str(), now))
+      return false;
+
+    if (now.size != stamps[i].size || now.mtime != stamps[i].mtime)
+      return false;
+  }
+
+  return true;
+}
+
+struct CacheWriter {
+  std::string buf;
+
+  void u32(uint32_t v) { buf.append((const char *)&v, sizeof(v)); }
+  void i64(int64_t v) { buf.append((const char *)&v, sizeof(v)); }
+
+  void str(const std::string &s) {
+    u32((uint32_t)s.size());
+    buf += s;
+  }
+
+  void stamps(const PathCacheFile::Stamps &s) {
+    u32((uint32_t)s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+      str(s[i].path);
+      i64(s[i].size);
+      i64(s[i].mtime);
+    }
+  }
+};
+
+struct CacheReader {
+  const char *pos;
+  const char *end;
+  bool ok;
+
+  CacheReader(const char *data, size_t size)
+      : pos(data), end(data + size), ok(true) {}
+
+  bool take(void *out, size_t n) {
+    if (!ok || (size_t)(end - pos) < n)
+      return ok = false;
+
+    memcpy(out, pos, n);
+    pos += n;
+    return true;
+  }
+
+  uint32_t u32() {
+    uint32_t v = 0;
+    take(&v, sizeof(v));
+    return v;
+  }
+
+  int64_t i64() {
+    int64_t v = 0;
+    take(&v, sizeof(v));
+    return v;
+  }
+
+  /* Points into the mapping; nothing is copied until the
+   * caller builds a string from it */
+  const char *str(uint32_t &len) {
+    len = u32();
+    if (!ok || (size_t)(end - pos) < len) {
+      ok = false;
+      return 0;
+    }
+
+    const char *s = pos;
+    pos += len;
+    return s;
+  }
+
+  void stamps(PathCacheFile::Stamps &out) {
+    uint32_t count = u32();
+    for (uint32_t i = 0; i < count && ok; ++i) {
+      PathCacheFile::Stamp stamp;
+      uint32_t len;
+      const char *path = str(len);
+      stamp.size = i64();
+      stamp.mtime = i64();
+      if (ok) {
+        stamp.path.assign(path, len);
+        out.push_back(stamp);
+      }
+    }
+  }
+};
+
+static bool sameStamps(const PathCacheFile::Stamps &a, const PathCacheFile::Stamps &b) {
+  if (a.size() != b.size())
+    return false;
+
+  for (size_t i = 0; i < a.size(); ++i)
+    if (a[i].path != b[i].path || a[i].size != b[i].size || a[i].mtime != b[i].mtime)
+      return false;
+
+  return true;
+}
+
+bool PathCacheFile::save(const std::string &file, const PathCacheData &data,
+                         const Stamps &mounts, const Stamps &dirs) {
+  CacheWriter w;
+  w.buf.append(cacheMagic, sizeof(cacheMagic));
+  w.u32(cacheVersion);
+  w.stamps(mounts);
+  w.stamps(dirs);
+
+  uint32_t dirCount = 0;
+  for (auto it = data.fileLists.cbegin(); it != data.fileLists.cend(); ++it)
+    ++dirCount;
+  w.u32(dirCount);
+
+  for (auto it = data.fileLists.cbegin(); it != data.fileLists.cend(); ++it) {
+    const std::string &dir = it->first;
+    const std::vector<std::string> &files = it->second;
+
+    w.str(dir);
+    w.u32((uint32_t)files.size());
+
+    for (size_t i = 0; i < files.size(); ++i) {
+      std::string lower = dir.empty() ? files[i] : dir + "/" + files[i];
+      w.str(files[i]);
+      w.str(data.pathCache.value(lower, lower));
+    }
+  }
+
+  /* Write to a temporary file first so a crash can't
+   * leave a truncated cache behind */
+  std::string tmp = file + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+
+  if (!f)
+    return false;
+
+  bool ok = (fwrite(w.buf.data(), 1, w.buf.size(), f) == w.buf.size());
+  ok = (fclose(f) == 0) && ok;
+
+  if (!ok || rename(tmp.c_str(), file.c_str()) != 0) {
+    remove(tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool PathCacheFile::load(const std::string &file, const Stamps &mounts,
+                         PathCacheData &data, Stamps &dirs) {
+  int fd = open(file.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(cacheMagic)) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED)
+    return false;
+
+  CacheReader r(static_cast<const char *>(map), size);
+  bool ok = false;
+
+  char magic[sizeof(cacheMagic)];
+  r.take(magic, sizeof(magic));
+
+  Stamps fileMounts;
+  if (r.ok && !memcmp(magic, cacheMagic, sizeof(magic)) && r.u32() == cacheVersion) {
+    r.stamps(fileMounts);
+    ok = r.ok && sameStamps(fileMounts, mounts);
+  }
+
+  if (ok) {
+    r.stamps(dirs);
+
+    uint32_t dirCount = r.u32();
+    for (uint32_t d = 0; d < dirCount && r.ok; ++d) {
+      uint32_t dirLen;
+      const char *dirStr = r.str(dirLen);
+      uint32_t fileCount = r.u32();
+
+      if (!r.ok)
+        break;
+
+      std::string dir(dirStr, dirLen);
+      std::vector<std::string> &files = data.fileLists[dir];
+      files.reserve(fileCount);
+
+      for (uint32_t i = 0; i < fileCount && r.ok; ++i) {
+        uint32_t nameLen, mixedLen;
+        const char *name = r.str(nameLen);
+        const char *mixed = r.str(mixedLen);
+
+        if (!r.ok)
+          break;
+
+        files.push_back(std::string(name, nameLen));
+
+        std::string lower = dir.empty() ? files.back() : dir + "/" + files.back();
+        data.pathCache.insert(lower, std::string(mixed, mixedLen));
+      }
+    }
+
+    ok = r.ok;
+  }
+
+  munmap(map, size);
+
+  if (!ok) {
+    data.fileLists.clear();
+    data.pathCache.clear();
+    dirs.clear();
+  }
+
+  return ok;
+}
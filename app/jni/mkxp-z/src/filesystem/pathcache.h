@@ -0,0 +1,217 @@
+/*
+** pathcache.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include "util/boost-hash.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+/* Index over the path cache used by openRead. Every cached file
+ * is reachable through each lower case "dir/name" prefix that ends
+ * right before a '.' of its filename, as well as through its full
+ * path, so "graphics/characters/foo" finds "Foo.png" and "Foo.jpg"
+ * with a single probe. Candidates keep directory enumeration order,
+ * which is the order the handler used to see them in */
+struct PathIndex {
+  struct Entry {
+    /* Lower case filename in fileLists, mixed case
+     * full path in pathCache */
+    const std::string *name;
+    const std::string *mixed;
+  };
+
+  struct Key {
+    uint64_t hash;
+    /* Offset and length in keyPool */
+    uint32_t keyOff;
+    uint32_t keyLen;
+    /* Range in candidates */
+    uint32_t first;
+    uint32_t count;
+  };
+
+  std::vector<Entry> entries;
+  std::vector<uint32_t> candidates;
+  std::vector<Key> keys;
+  std::string keyPool;
+  /* Open addressing table of indices into keys (+1, 0 = empty) */
+  std::vector<uint32_t> table;
+
+  static uint64_t hash(const char *str, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i) {
+      h ^= (unsigned char)str[i];
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  void clear() {
+    entries.clear();
+    candidates.clear();
+    keys.clear();
+    keyPool.clear();
+    table.clear();
+  }
+
+  void build(const BoostHash<std::string, std::vector<std::string>> &fileLists,
+             BoostHash<std::string, std::string> &pathCache) {
+    clear();
+
+    struct Pending {
+      std::string key;
+      uint32_t entry;
+    };
+    std::vector<Pending> pending;
+
+    for (auto it = fileLists.cbegin(); it != fileLists.cend(); ++it) {
+      const std::string &dir = it->first;
+      const std::vector<std::string> &files = it->second;
+
+      for (size_t i = 0; i < files.size(); ++i) {
+        std::string lower = dir.empty() ? files[i] : dir + "/" + files[i];
+
+        if (!pathCache.contains(lower))
+          continue;
+
+        const std::string &mixed = pathCache[lower];
+        uint32_t id = (uint32_t)entries.size();
+        Entry e = { &files[i], &mixed };
+        entries.push_back(e);
+
+        size_t nameStart = lower.size() - files[i].size();
+        for (size_t j = nameStart; j < lower.size(); ++j)
+          if (lower[j] == '.')
+            pending.push_back({ lower.substr(0, j), id });
+        pending.push_back({ lower, id });
+      }
+    }
+
+    /* Entries were added in enumeration order, and the stable sort
+     * keeps that order among candidates sharing a key */
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const Pending &a, const Pending &b) { return a.key < b.key; });
+
+    candidates.reserve(pending.size());
+    for (size_t i = 0; i < pending.size(); ++i) {
+      if (i == 0 || pending[i].key != pending[i - 1].key) {
+        Key k;
+        k.hash = hash(pending[i].key.data(), pending[i].key.size());
+        k.keyOff = (uint32_t)keyPool.size();
+        k.keyLen = (uint32_t)pending[i].key.size();
+        k.first = (uint32_t)candidates.size();
+        k.count = 0;
+        keyPool += pending[i].key;
+        keys.push_back(k);
+      }
+      candidates.push_back(pending[i].entry);
+      keys.back().count++;
+    }
+
+    size_t tableSize = 16;
+    while (tableSize < keys.size() * 2)
+      tableSize <<= 1;
+    table.assign(tableSize, 0);
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+      size_t slot = keys[i].hash & (tableSize - 1);
+      while (table[slot])
+        slot = (slot + 1) & (tableSize - 1);
+      table[slot] = (uint32_t)i + 1;
+    }
+  }
+
+  /* Returns the candidate entry ids for a lower case path */
+  const uint32_t *find(const char *key, size_t len, size_t &count) const {
+    count = 0;
+    if (table.empty())
+      return 0;
+
+    uint64_t h = hash(key, len);
+    size_t mask = table.size() - 1;
+
+    for (size_t slot = h & mask; table[slot]; slot = (slot + 1) & mask) {
+      const Key &k = keys[table[slot] - 1];
+      if (k.hash == h && k.keyLen == len &&
+          memcmp(keyPool.data() + k.keyOff, key, len) == 0) {
+        count = k.count;
+        return &candidates[k.first];
+      }
+    }
+
+    return 0;
+  }
+};
+
+/* Everything createPathCache builds. Held through a shared
+ * pointer so a rebuild on another thread can swap it in while
+ * openRead calls still use the previous one */
+struct PathCacheData {
+  /* Maps: lower case full filepath,
+   * To:   mixed case full filepath */
+  BoostHash<std::string, std::string> pathCache;
+  /* Maps: lower case directory path,
+   * To:   list of lower case filenames */
+  BoostHash<std::string, std::vector<std::string>> fileLists;
+  /* Lookup structure for openRead, built from the two above */
+  PathIndex pathIndex;
+};
+
+/* On-disk copy of PathCacheData, so a launch with an unchanged
+ * search path can skip enumerating every mounted file */
+namespace PathCacheFile {
+
+struct Stamp {
+  std::string path;
+  int64_t size;
+  int64_t mtime;
+};
+
+typedef std::vector<Stamp> Stamps;
+
+/* Stats every PhysFS search path entry. Cheap enough to run
+ * before trusting a cache file */
+void stampMounts(Stamps &out);
+
+/* Records every directory below the directory mounts. Adding,
+ * removing or renaming a file changes its directory's mtime, so
+ * these catch changes without looking at the files themselves */
+void stampDirectories(const Stamps &mounts, Stamps &out);
+
+/* Re-stats each stamp; false if anything changed or vanished */
+bool stampsValid(const Stamps &stamps);
+
+bool save(const std::string &file, const PathCacheData &data,
+          const Stamps &mounts, const Stamps &dirs);
+
+/* Maps the file and reads it into data if it was written for
+ * the given mount stamps. dirs receives the directory stamps
+ * stored alongside, for revalidation */
+bool load(const std::string &file, const Stamps &mounts,
+          PathCacheData &data, Stamps &dirs);
+
+}
+
+#endif // PATHCACHE_H
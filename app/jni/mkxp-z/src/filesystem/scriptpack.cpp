@@ -0,0 +1,457 @@
+/*
+** scriptpack.cpp
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scriptpack.h"
+
+#include "util/workerpool.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* File layout (host byte order, strings are u32 length + bytes):
+ *   "MKSC" u32 version
+ *   u32 count, u32 crc, u64 bytes                        pack key
+ *   count * str text */
+static const char cacheMagic[4] = { 'M', 'K', 'S', 'C' };
+static const uint32_t cacheVersion = 1;
+
+static const size_t maxThreads = 8;
+
+/* Streams into a buffer that grows as needed, so a section is
+ * never inflated twice and ends up exactly as long as its text */
+static bool inflateSection(const ScriptPack::Section &in, std::string &out) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+
+  if (inflateInit(&zs) != Z_OK)
+    return false;
+
+  /* Script text usually shrinks to a quarter or less */
+  out.resize(std::max<size_t>(in.size * 4, 0x1000));
+
+  zs.next_in = (Bytef *)in.data;
+  zs.avail_in = (uInt)in.size;
+
+  int result = Z_OK;
+
+  while (result == Z_OK) {
+    if (zs.total_out == out.size())
+      out.resize(out.size() * 2);
+
+    zs.next_out = (Bytef *)&out[zs.total_out];
+    zs.avail_out = (uInt)(out.size() - zs.total_out);
+
+    result = inflate(&zs, Z_NO_FLUSH);
+
+    /* Input ran out before the stream ended */
+    if (result == Z_BUF_ERROR && zs.avail_out != 0)
+      break;
+    if (result == Z_BUF_ERROR)
+      result = Z_OK;
+  }
+
+  out.resize(zs.total_out);
+  inflateEnd(&zs);
+
+  return result == Z_STREAM_END;
+}
+
+long ScriptPack::inflateAll(const std::vector<Section> &in, std::vector<std::string> &out) {
+  out.clear();
+  out.resize(in.size());
+
+  std::vector<size_t> order(in.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+
+  /* Largest first, so one big section doesn't
+   * end up running alone at the very end */
+  std::sort(order.begin(), order.end(),
+            [&in](size_t a, size_t b) { return in[a].size > in[b].size; });
+
+  std::atomic<long> firstError(-1);
+
+  auto decode = [&](size_t &i) {
+    if (inflateSection(in[i], out[i]))
+      return;
+
+    long cur = firstError.load();
+    while ((cur < 0 || (long)i < cur) &&
+           !firstError.compare_exchange_weak(cur, (long)i))
+      ;
+  };
+
+  size_t threads = std::min<size_t>(std::thread::hardware_concurrency(), maxThreads);
+  threads = std::min(threads, in.size());
+
+  if (threads <= 1) {
+    for (size_t i = 0; i < order.size(); ++i)
+      decode(order[i]);
+  } else {
+    WorkerPool<size_t> pool(threads, order.size(), decode);
+
+    for (size_t i = 0; i < order.size(); ++i)
+      pool.push(std::move(order[i]));
+
+    pool.waitIdle();
+  }
+
+  return firstError.load();
+}
+
+ScriptPack::Key ScriptPack::keyOf(const std::vector<Section> &in) {
+  Key key;
+  key.count = (uint32_t)in.size();
+  key.crc = crc32(0, Z_NULL, 0);
+  key.bytes = 0;
+
+  for (size_t i = 0; i < in.size(); ++i) {
+    /* Fold in each size too, so moving bytes from one
+     * section to the next changes the key */
+    uint32_t size = (uint32_t)in[i].size;
+    key.crc = crc32(key.crc, (const Bytef *)&size, sizeof(size));
+    key.crc = crc32(key.crc, (const Bytef *)in[i].data, (uInt)in[i].size);
+    key.bytes += in[i].size;
+  }
+
+  return key;
+}
+
+ScriptPack::CacheView::~CacheView() {
+  if (map)
+    munmap(map, size);
+}
+
+bool ScriptPack::save(const std::string &file, const Key &key,
+                      const std::vector<std::string> &texts) {
+  std::string buf;
+
+  auto u32 = [&buf](uint32_t v) { buf.append((const char *)&v, sizeof(v)); };
+
+  size_t total = 0;
+  for (size_t i = 0; i < texts.size(); ++i)
+    total += texts[i].size() + sizeof(uint32_t);
+  buf.reserve(total + 32);
+
+  buf.append(cacheMagic, sizeof(cacheMagic));
+  u32(cacheVersion);
+  u32(key.count);
+  u32(key.crc);
+  buf.append((const char *)&key.bytes, sizeof(key.bytes));
+
+  for (size_t i = 0; i < texts.size(); ++i) {
+    u32((uint32_t)texts[i].size());
+    buf += texts[i];
+  }
+
+  /* Write to a temporary file first so a crash can't
+   * leave a truncated cache behind */
+  std::string tmp = file + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+
+  if (!f)
+    return false;
+
+  bool ok = (fwrite(buf.data(), 1, buf.size(), f) == buf.size());
+  ok = (fclose(f) == 0) && ok;
+
+  if (!ok || rename(tmp.c_str(), file.c_str()) != 0) {
+    remove(tmp.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool ScriptPack::load(const std::string &file, const Key &key, CacheView &out) {
+  int fd = open(file.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(cacheMagic)) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *map = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED)
+    return false;
+
+  const char *pos = static_cast<const char *>(map);
+  const char *end = pos + size;
+
+  auto take = [&](void *dst, size_t n) {
+    if ((size_t)(end - pos) < n)
+      return false;
+    memcpy(dst, pos, n);
+    pos += n;
+    return true;
+  };
+
+  char magic[sizeof(cacheMagic)];
+  uint32_t version = 0;
+  Key fileKey;
+
+  bool ok = take(magic, sizeof(magic)) && !memcmp(magic, cacheMagic, sizeof(magic)) &&
+            take(&version, sizeof(version)) && version == cacheVersion &&
+            take(&fileKey.count, sizeof(fileKey.count)) &&
+            take(&fileKey.crc, sizeof(fileKey.crc)) &&
+            take(&fileKey.bytes, sizeof(fileKey.bytes)) &&
+            fileKey.count == key.count && fileKey.crc == key.crc &&
+            fileKey.bytes == key.bytes;
+
+  std::vector<Section> texts;
+
+  if (ok) {
+    texts.reserve(key.count);
+
+    for (uint32_t i = 0; i < key.count && ok; ++i) {
+      uint32_t len = 0;
+      ok = take(&len, sizeof(len)) && (size_t)(end - pos) >= len;
+
+      if (ok) {
+        Section text = { pos, len };
+        texts.push_back(text);
+        pos += len;
+      }
+    }
+  }
+
+  if (!ok) {
+    munmap(map, size);
+    return false;
+  }
+
+  if (out.map)
+    munmap(out.map, out.size);
+
+  out.texts.swap(texts);
+  out.map = map;
+  out.size = size;
+
+  return true;
+}
+
+/* File layout (host byte order, strings are u32 length + bytes):
+ *   "MKBC" u32 version
+ *   str tag
+ *   u32 count, count * (u64 hash, str blob) */
+static const char bytecodeMagic[4] = { 'M', 'K', 'B', 'C' };
+static const uint32_t bytecodeVersion = 1;
+
+ScriptPack::BytecodeCache::BytecodeCache()
+    : map(0), mapSize(0), changed(false) {}
+
+ScriptPack::BytecodeCache::~BytecodeCache() {
+  if (map)
+    munmap(map, mapSize);
+}
+
+uint64_t ScriptPack::BytecodeCache::hash(const char *name, size_t nameLen,
+                                         const char *source, size_t sourceLen) {
+  uint64_t h = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < nameLen; ++i) {
+    h ^= (unsigned char)name[i];
+    h *= 1099511628211ULL;
+  }
+
+  /* Keep "ab" + "c" apart from "a" + "bc" */
+  h ^= 0xff;
+  h *= 1099511628211ULL;
+
+  for (size_t i = 0; i < sourceLen; ++i) {
+    h ^= (unsigned char)source[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+bool ScriptPack::BytecodeCache::load(const std::string &file, const std::string &tag) {
+  int fd = open(file.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(bytecodeMagic)) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *newMap = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (newMap == MAP_FAILED)
+    return false;
+
+  const char *pos = static_cast<const char *>(newMap);
+  const char *end = pos + size;
+
+  auto take = [&](void *dst, size_t n) {
+    if ((size_t)(end - pos) < n)
+      return false;
+    memcpy(dst, pos, n);
+    pos += n;
+    return true;
+  };
+
+  char magic[sizeof(bytecodeMagic)];
+  uint32_t version = 0;
+  uint32_t tagLen = 0;
+
+  bool ok = take(magic, sizeof(magic)) && !memcmp(magic, bytecodeMagic, sizeof(magic)) &&
+            take(&version, sizeof(version)) && version == bytecodeVersion &&
+            take(&tagLen, sizeof(tagLen)) && tagLen == tag.size() &&
+            (size_t)(end - pos) >= tagLen && !memcmp(pos, tag.data(), tagLen);
+
+  std::unordered_map<uint64_t, Entry> loaded;
+
+  if (ok) {
+    pos += tagLen;
+
+    uint32_t count = 0;
+    ok = take(&count, sizeof(count));
+
+    for (uint32_t i = 0; i < count && ok; ++i) {
+      uint64_t h = 0;
+      uint32_t len = 0;
+      ok = take(&h, sizeof(h)) && take(&len, sizeof(len)) && (size_t)(end - pos) >= len;
+
+      if (ok) {
+        Entry &e = loaded[h];
+        e.blob.data = pos;
+        e.blob.size = len;
+        e.used = false;
+        pos += len;
+      }
+    }
+  }
+
+  if (!ok) {
+    munmap(newMap, size);
+    return false;
+  }
+
+  if (map)
+    munmap(map, mapSize);
+
+  entries.swap(loaded);
+  map = newMap;
+  mapSize = size;
+  changed = false;
+
+  return true;
+}
+
+bool ScriptPack::BytecodeCache::save(const std::string &file, const std::string &tag) {
+  std::string buf;
+
+  auto u32 = [&buf](uint32_t v) { buf.append((const char *)&v, sizeof(v)); };
+
+  uint32_t count = 0;
+  size_t total = 0;
+  for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+    if (!it->second.used)
+      continue;
+    ++count;
+    total += it->second.blob.size + sizeof(uint64_t) + sizeof(uint32_t);
+  }
+  buf.reserve(total + tag.size() + 32);
+
+  buf.append(bytecodeMagic, sizeof(bytecodeMagic));
+  u32(bytecodeVersion);
+  u32((uint32_t)tag.size());
+  buf += tag;
+  u32(count);
+
+  for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+    if (!it->second.used)
+      continue;
+    buf.append((const char *)&it->first, sizeof(it->first));
+    u32((uint32_t)it->second.blob.size);
+    buf.append(it->second.blob.data, it->second.blob.size);
+  }
+
+  /* Write to a temporary file first so a crash can't
+   * leave a truncated cache behind */
+  std::string tmp = file + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+
+  if (!f)
+    return false;
+
+  bool ok = (fwrite(buf.data(), 1, buf.size(), f) == buf.size());
+  ok = (fclose(f) == 0) && ok;
+
+  if (!ok || rename(tmp.c_str(), file.c_str()) != 0) {
+    remove(tmp.c_str());
+    return false;
+  }
+
+  changed = false;
+
+  return true;
+}
+
+const ScriptPack::Section *ScriptPack::BytecodeCache::find(uint64_t hash) {
+  auto it = entries.find(hash);
+
+  if (it == entries.end())
+    return 0;
+
+  it->second.used = true;
+
+  return &it->second.blob;
+}
+
+void ScriptPack::BytecodeCache::insert(uint64_t hash, const char *data, size_t size) {
+  Entry &e = entries[hash];
+  e.owned.assign(data, size);
+  e.blob.data = e.owned.data();
+  e.blob.size = size;
+  e.used = true;
+  changed = true;
+}
+
+bool ScriptPack::BytecodeCache::dirty() const {
+  if (changed)
+    return true;
+
+  for (auto it = entries.cbegin(); it != entries.cend(); ++it)
+    if (!it->second.used)
+      return true;
+
+  return false;
+}
@@ -0,0 +1,126 @@
+/*
+** scriptpack.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCRIPTPACK_H
+#define SCRIPTPACK_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Decoding of the zlib compressed sections of an RGSS script
+ * pack, and on-disk copies of the decoded text and compiled
+ * scripts so a launch with an unchanged pack can skip both */
+namespace ScriptPack {
+
+struct Section {
+  const char *data;
+  size_t size;
+};
+
+/* Inflates every section on a pool of worker threads. The
+ * section data must stay untouched until this returns.
+ * Returns the index of the first section that failed to
+ * decode, or -1 if all of them did */
+long inflateAll(const std::vector<Section> &in, std::vector<std::string> &out);
+
+/* Identifies a pack by the contents of its compressed sections,
+ * which is all the decoded text depends on */
+struct Key {
+  uint32_t count;
+  uint32_t crc;
+  uint64_t bytes;
+};
+
+Key keyOf(const std::vector<Section> &in);
+
+/* Decoded sections mapped from a cache file. The texts point
+ * into the mapping and are valid while the view is alive */
+class CacheView {
+public:
+  CacheView() : map(0), size(0) {}
+  ~CacheView();
+
+  std::vector<Section> texts;
+
+private:
+  CacheView(const CacheView &);
+  CacheView &operator=(const CacheView &);
+
+  friend bool load(const std::string &, const Key &, CacheView &);
+
+  void *map;
+  size_t size;
+};
+
+bool save(const std::string &file, const Key &key,
+          const std::vector<std::string> &texts);
+
+/* Fails if the file is missing, damaged or was
+ * written for a different pack */
+bool load(const std::string &file, const Key &key, CacheView &out);
+
+/* Compiled scripts in whatever binary form the interpreter
+ * produces, stored by a hash over each script's filename and
+ * source. Entries that weren't looked up or added since load()
+ * are left out when saving, so the file doesn't collect stale
+ * copies of edited scripts */
+class BytecodeCache {
+public:
+  BytecodeCache();
+  ~BytecodeCache();
+
+  static uint64_t hash(const char *name, size_t nameLen,
+                       const char *source, size_t sourceLen);
+
+  /* 'tag' names the interpreter build; files written
+   * by any other build are ignored */
+  bool load(const std::string &file, const std::string &tag);
+  bool save(const std::string &file, const std::string &tag);
+
+  /* Returns null if nothing is stored for 'hash' */
+  const Section *find(uint64_t hash);
+  void insert(uint64_t hash, const char *data, size_t size);
+
+  /* Whether save() would write anything different */
+  bool dirty() const;
+
+private:
+  BytecodeCache(const BytecodeCache &);
+  BytecodeCache &operator=(const BytecodeCache &);
+
+  struct Entry {
+    /* Points into the mapping or at 'owned' */
+    Section blob;
+    std::string owned;
+    bool used;
+  };
+
+  std::unordered_map<uint64_t, Entry> entries;
+
+  void *map;
+  size_t mapSize;
+  bool changed;
+};
+
+} // namespace ScriptPack
+
+#endif // SCRIPTPACK_H
@@ -24,12 +24,15 @@
 #include "src/util/util.h"
 
 #include "filesystem.h"
+#include "assetprefetch.h"
 #include "graphics.h"
 #include "input.h"
 #include "audio.h"
 #include "glstate.h"
 #include "shader.h"
 #include "texpool.h"
+#include "spritebatch.h"
+#include "textatlas.h"
 #include "font.h"
 #include "eventthread.h"
 #include "gl-util.h"
@@ -47,6 +50,7 @@
 
 SharedState *SharedState::instance = 0;
 int SharedState::rgssVersion = 0;
+bool SharedState::screenDamaged = true;
 static GlobalIBO *_globalIBO = 0;
 
 static const char *gameArchExt()
@@ -74,6 +78,8 @@ struct SharedStatePrivate
 	RGSSThreadData &rtData;
 	Config &config;
 
+	AssetPrefetch assetPrefetch;
+
 	SharedMidiState midiState;
 
 	Graphics graphics;
@@ -86,6 +92,10 @@ struct SharedStatePrivate
 
 	TexPool texPool;
 
+	SpriteBatch spriteBatch;
+
+	TextAtlas textAtlas;
+
 	SharedFontState fontState;
 	Font *defaultFont;
 
@@ -110,11 +120,13 @@ struct SharedStatePrivate
 	      eThread(*threadData->ethread),
 	      rtData(*threadData),
 	      config(threadData->config),
+	      assetPrefetch(fileSystem, (size_t) threadData->config.prefetchCacheSize * 1000000),
 	      midiState(threadData->config),
 	      graphics(threadData),
 	      input(*threadData),
 	      audio(*threadData),
 	      _glState(threadData->config),
+	      texPool((uint64_t) threadData->config.texturePoolSize * 1000000),
 	      fontState(threadData->config),
 	      stampCounter(0)
     {}
@@ -155,8 +167,15 @@ struct SharedStatePrivate
         MtoolProc::notifyLoadingStatus(6);
 #endif
 
-		if (config.pathCache)
+		if (config.pathCache && config.pathCacheFile)
+		{
+			std::string cacheFile = config.customDataPath + "/pathcache.bin";
+			fileSystem.createPathCache(cacheFile.c_str());
+		}
+		else if (config.pathCache)
+		{
 			fileSystem.createPathCache();
+		}
 
 		fileSystem.initFontSets(fontState);
 
@@ -246,6 +265,7 @@ GSATT(void*, bindingData)
 GSATT(SDL_Window*, sdlWindow)
 GSATT(Scene*, screen)
 GSATT(FileSystem&, fileSystem)
+GSATT(AssetPrefetch&, assetPrefetch)
 GSATT(EventThread&, eThread)
 GSATT(RGSSThreadData&, rtData)
 GSATT(Config&, config)
@@ -255,6 +275,8 @@ GSATT(Audio&, audio)
 GSATT(GLState&, _glState)
 GSATT(ShaderSet&, shaders)
 GSATT(TexPool&, texPool)
+GSATT(SpriteBatch&, spriteBatch)
+GSATT(TextAtlas&, textAtlas)
 GSATT(Quad&, gpQuad)
 GSATT(SharedFontState&, fontState)
 GSATT(SharedMidiState&, midiState)
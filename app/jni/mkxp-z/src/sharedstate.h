@@ -38,12 +38,15 @@ struct ShaderSet;
 
 class Scene;
 class FileSystem;
+class AssetPrefetch;
 class EventThread;
 class Graphics;
 class Input;
 class Audio;
 class GLState;
 class TexPool;
+class SpriteBatch;
+class TextAtlas;
 class Font;
 class SharedFontState;
 struct GlobalIBO;
@@ -62,6 +65,7 @@ struct SharedState
 	void setScreen(Scene &screen);
 
 	FileSystem &fileSystem() const;
+	AssetPrefetch &assetPrefetch() const;
 
 	EventThread &eThread() const;
 	RGSSThreadData &rtData() const;
@@ -77,6 +81,9 @@ struct SharedState
 
 	TexPool &texPool() const;
 
+	SpriteBatch &spriteBatch() const;
+	TextAtlas &textAtlas() const;
+
 	SharedFontState &fontState() const;
 	Font &defaultFont() const;
 	SharedMidiState &midiState() const;
@@ -113,8 +120,15 @@ struct SharedState
 
 	void checkReset();
 
+	/* Called by everything that changes what the next composited
+	 * frame would look like. Graphics clears the flag when it
+	 * composites, and reuses the previous frame while it stays
+	 * unset */
+	static void damageScreen() { screenDamaged = true; }
+
 	static SharedState *instance;
 	static int rgssVersion;
+	static bool screenDamaged;
 
 	/* This function will throw an Exception instance
 	 * on initialization error */
@@ -0,0 +1,239 @@
+/*
+** workerpool.h
+**
+** This file is part of mkxp.
+**
+** mkxp is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 2 of the License, or
+** (at your option) any later version.
+**
+** mkxp is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with mkxp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+/* Fixed number of threads servicing a bounded FIFO of jobs.
+ * Job slots live in a preallocated ring and are reused, so
+ * pushing a job never allocates on its own. When the ring is
+ * full, push() blocks for up to the given timeout, providing
+ * backpressure to the producer */
+template<typename Job>
+class WorkerPool
+{
+public:
+	typedef std::function<void(Job &)> Handler;
+	typedef std::chrono::steady_clock Clock;
+
+	struct Stats
+	{
+		size_t threads;
+		size_t capacity;
+		size_t queueDepth;
+		size_t maxQueueDepth;
+		size_t busy;
+		uint64_t completed;
+		uint64_t rejected;
+		/* Microseconds spent waiting in the queue / being handled */
+		uint64_t totalWaitUs;
+		uint64_t maxWaitUs;
+		uint64_t totalRunUs;
+		uint64_t maxRunUs;
+	};
+
+	WorkerPool(size_t threadCount, size_t capacity, Handler handler)
+	    : handler(handler),
+	      slots(capacity ? capacity : 1),
+	      head(0), count(0), running(true)
+	{
+		resetStatsLocked();
+		stats.busy = 0;
+		stats.queueDepth = 0;
+		stats.threads = threadCount ? threadCount : 1;
+		stats.capacity = slots.size();
+
+		for (size_t i = 0; i < stats.threads; ++i)
+			threads.emplace_back(&WorkerPool::workerLoop, this);
+	}
+
+	~WorkerPool()
+	{
+		stop();
+	}
+
+	/* timeoutMs < 0: wait until there is room.
+	 * Returns false if the job was rejected */
+	bool push(Job &&job, int timeoutMs = -1)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+
+		auto hasRoom = [this]() { return !running || count < slots.size(); };
+
+		if (timeoutMs < 0)
+			notFull.wait(lock, hasRoom);
+		else if (!notFull.wait_for(lock, std::chrono::milliseconds(timeoutMs), hasRoom))
+		{
+			stats.rejected++;
+			return false;
+		}
+
+		if (!running)
+		{
+			stats.rejected++;
+			return false;
+		}
+
+		Slot &slot = slots[(head + count) % slots.size()];
+		slot.job = std::move(job);
+		slot.queued = Clock::now();
+		count++;
+
+		if (count > stats.maxQueueDepth)
+			stats.maxQueueDepth = count;
+
+		lock.unlock();
+		notEmpty.notify_one();
+
+		return true;
+	}
+
+	/* Blocks until every queued and running job has finished */
+	void waitIdle()
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		idle.wait(lock, [this]() { return count == 0 && stats.busy == 0; });
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (!running)
+				return;
+			running = false;
+		}
+
+		notEmpty.notify_all();
+		notFull.notify_all();
+
+		for (std::thread &t : threads)
+			if (t.joinable())
+				t.join();
+
+		threads.clear();
+	}
+
+	Stats getStats()
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		Stats s = stats;
+		s.queueDepth = count;
+
+		return s;
+	}
+
+	void resetStats()
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		resetStatsLocked();
+	}
+
+private:
+	struct Slot
+	{
+		Job job;
+		Clock::time_point queued;
+	};
+
+	void resetStatsLocked()
+	{
+		stats.maxQueueDepth = count;
+		stats.completed = 0;
+		stats.rejected = 0;
+		stats.totalWaitUs = stats.maxWaitUs = 0;
+		stats.totalRunUs = stats.maxRunUs = 0;
+	}
+
+	static uint64_t usSince(Clock::time_point t, Clock::time_point now)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(now - t).count();
+	}
+
+	void workerLoop()
+	{
+		Job job;
+
+		std::unique_lock<std::mutex> lock(mtx);
+
+		while (true)
+		{
+			notEmpty.wait(lock, [this]() { return !running || count > 0; });
+
+			if (count == 0)
+				break;
+
+			Slot &slot = slots[head];
+			job = std::move(slot.job);
+			Clock::time_point start = Clock::now();
+			uint64_t waitUs = usSince(slot.queued, start);
+
+			head = (head + 1) % slots.size();
+			count--;
+			stats.busy++;
+			stats.totalWaitUs += waitUs;
+			if (waitUs > stats.maxWaitUs)
+				stats.maxWaitUs = waitUs;
+
+			lock.unlock();
+			notFull.notify_one();
+
+			handler(job);
+			job = Job();
+
+			uint64_t runUs = usSince(start, Clock::now());
+
+			lock.lock();
+			stats.busy--;
+			stats.completed++;
+			stats.totalRunUs += runUs;
+			if (runUs > stats.maxRunUs)
+				stats.maxRunUs = runUs;
+
+			if (count == 0 && stats.busy == 0)
+				idle.notify_all();
+		}
+	}
+
+	Handler handler;
+
+	std::vector<Slot> slots;
+	size_t head;
+	size_t count;
+	bool running;
+
+	Stats stats;
+
+	std::mutex mtx;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	std::condition_variable idle;
+
+	std::vector<std::thread> threads;
+};
+
+#endif // WORKERPOOL_H